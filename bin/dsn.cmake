@@ -225,7 +225,7 @@ function(dsn_setup_packages)
         chrono
         date_time
         )
-    ms_setup_boost(1 "${BOOST_PACKAGES}")
+    ms_setup_boost(0 "${BOOST_PACKAGES}")
     
     if(UNIX)
         set(CMAKE_THREAD_PREFER_PTHREAD TRUE)
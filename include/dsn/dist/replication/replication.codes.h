@@ -61,7 +61,10 @@ MAKE_EVENT_CODE_RPC(RPC_CM_QUERY_PARTITION_CONFIG_BY_INDEX, dsn::TASK_PRIORITY_C
 MAKE_EVENT_CODE_RPC(RPC_CM_QUERY_NODE_PARTITIONS, dsn::TASK_PRIORITY_COMMON)
 MAKE_EVENT_CODE_RPC(RPC_CM_UPDATE_PARTITION_CONFIGURATION, dsn::TASK_PRIORITY_COMMON)
 MAKE_EVENT_CODE_AIO(LPC_CM_LOG_UPDATE, dsn::TASK_PRIORITY_HIGH)
+MAKE_EVENT_CODE(LPC_CM_LOG_BATCH, dsn::TASK_PRIORITY_HIGH)
 MAKE_EVENT_CODE(LPC_LBM_RUN, dsn::TASK_PRIORITY_COMMON)
+MAKE_EVENT_CODE(LPC_CM_CHECKPOINT, dsn::TASK_PRIORITY_COMMON)
+MAKE_EVENT_CODE_AIO(LPC_CM_CHECKPOINT_WRITE, dsn::TASK_PRIORITY_COMMON)
 MAKE_EVENT_CODE(LPC_QUERY_PN_DECREE, dsn::TASK_PRIORITY_COMMON)
 #undef CURRENT_THREAD_POOL
 
@@ -69,6 +72,7 @@ MAKE_EVENT_CODE(LPC_QUERY_PN_DECREE, dsn::TASK_PRIORITY_COMMON)
 #define CURRENT_THREAD_POOL THREAD_POOL_REPLICATION
 MAKE_EVENT_CODE(RPC_REPLICATION_WRITE_EMPTY, dsn::TASK_PRIORITY_COMMON)
 MAKE_EVENT_CODE(LPC_MUTATION_PENDING_TIMER, dsn::TASK_PRIORITY_HIGH)
+MAKE_EVENT_CODE(LPC_REPLAY_MUTATIONS, dsn::TASK_PRIORITY_COMMON)
 MAKE_EVENT_CODE(LPC_GROUP_CHECK, dsn::TASK_PRIORITY_COMMON)
 MAKE_EVENT_CODE(LPC_CM_DISCONNECTED_SCATTER, dsn::TASK_PRIORITY_HIGH)
 MAKE_EVENT_CODE(LPC_QUERY_NODE_CONFIGURATION_SCATTER, dsn::TASK_PRIORITY_HIGH)
@@ -78,6 +82,7 @@ MAKE_EVENT_CODE_AIO(LPC_WRITE_REPLICATION_LOG, dsn::TASK_PRIORITY_HIGH)
 MAKE_EVENT_CODE_AIO(LPC_LERARN_REMOTE_DISK_STATE, dsn::TASK_PRIORITY_HIGH)
 MAKE_EVENT_CODE(LPC_QUERY_CONFIGURATION_ALL, dsn::TASK_PRIORITY_HIGH)
 MAKE_EVENT_CODE_RPC(RPC_REPLICATION_CLIENT_WRITE, dsn::TASK_PRIORITY_COMMON)
+MAKE_EVENT_CODE_RPC(RPC_REPLICATION_CLIENT_BATCH_WRITE, dsn::TASK_PRIORITY_COMMON)
 MAKE_EVENT_CODE_RPC(RPC_CONFIG_PROPOSAL, dsn::TASK_PRIORITY_HIGH)
 MAKE_EVENT_CODE_RPC(RPC_QUERY_PN_DECREE, dsn::TASK_PRIORITY_HIGH)
 MAKE_EVENT_CODE_RPC(RPC_PREPARE, dsn::TASK_PRIORITY_HIGH)
@@ -92,6 +97,7 @@ MAKE_EVENT_CODE_RPC(RPC_REMOVE_REPLICA, dsn::TASK_PRIORITY_COMMON)
 #define CURRENT_THREAD_POOL THREAD_POOL_LOCAL_APP
 MAKE_EVENT_CODE(LPC_WRITE, dsn::TASK_PRIORITY_COMMON)
 MAKE_EVENT_CODE_RPC(RPC_REPLICATION_CLIENT_READ, dsn::TASK_PRIORITY_COMMON)
+MAKE_EVENT_CODE_RPC(RPC_REPLICATION_CLIENT_BATCH_READ, dsn::TASK_PRIORITY_COMMON)
 #undef CURRENT_THREAD_POOL
 
 // THREAD_POOL_REPLICATION_LONG
@@ -101,4 +107,6 @@ MAKE_EVENT_CODE_AIO(LPC_COPY_REMOTE_DELTA_FILES, dsn::TASK_PRIORITY_COMMON)
 MAKE_EVENT_CODE(LPC_GARBAGE_COLLECT_LOGS_AND_REPLICAS, dsn::TASK_PRIORITY_COMMON)
 MAKE_EVENT_CODE(LPC_OPEN_REPLICA, dsn::TASK_PRIORITY_COMMON)
 MAKE_EVENT_CODE(LPC_CLOSE_REPLICA, dsn::TASK_PRIORITY_COMMON)
+MAKE_EVENT_CODE(LPC_LOAD_REPLICA, dsn::TASK_PRIORITY_COMMON)
+MAKE_EVENT_CODE(LPC_DECODE_LOG_FILE, dsn::TASK_PRIORITY_COMMON)
 #undef CURRENT_THREAD_POOL
@@ -771,6 +771,7 @@ namespace dsn { namespace replication {
         int64_t prepare_start_decree;
         learn_state state;
         std::string base_local_dir;
+        std::vector< ::dsn::blob> mutations;
     };
 
     inline void marshall(::dsn::binary_writer& writer, const learn_response& val, uint16_t pos = 0xffff)
@@ -781,6 +782,7 @@ namespace dsn { namespace replication {
         marshall(writer, val.prepare_start_decree, pos);
         marshall(writer, val.state, pos);
         marshall(writer, val.base_local_dir, pos);
+        marshall(writer, val.mutations, pos);
     };
 
     inline void unmarshall(::dsn::binary_reader& reader, __out_param learn_response& val)
@@ -791,6 +793,7 @@ namespace dsn { namespace replication {
         unmarshall(reader, val.prepare_start_decree);
         unmarshall(reader, val.state);
         unmarshall(reader, val.base_local_dir);
+        unmarshall(reader, val.mutations);
     };
 
     // ---------- group_check_request -------------
@@ -963,16 +966,22 @@ namespace dsn { namespace replication {
     struct configuration_query_by_node_request
     {
         ::dsn::end_point node;
+        int64_t known_epoch;
+        int64_t known_version;
     };
 
     inline void marshall(::dsn::binary_writer& writer, const configuration_query_by_node_request& val, uint16_t pos = 0xffff)
     {
         marshall(writer, val.node, pos);
+        marshall(writer, val.known_epoch, pos);
+        marshall(writer, val.known_version, pos);
     };
 
     inline void unmarshall(::dsn::binary_reader& reader, __out_param configuration_query_by_node_request& val)
     {
         unmarshall(reader, val.node);
+        unmarshall(reader, val.known_epoch);
+        unmarshall(reader, val.known_version);
     };
 
     // ---------- configuration_query_by_node_response -------------
@@ -980,18 +989,30 @@ namespace dsn { namespace replication {
     {
         ::dsn::error_code err;
         std::vector< partition_configuration> partitions;
+        int64_t epoch;
+        int64_t version;
+        bool is_delta;
+        std::vector< global_partition_id> removed_partitions;
     };
 
     inline void marshall(::dsn::binary_writer& writer, const configuration_query_by_node_response& val, uint16_t pos = 0xffff)
     {
         marshall(writer, val.err, pos);
         marshall(writer, val.partitions, pos);
+        marshall(writer, val.epoch, pos);
+        marshall(writer, val.version, pos);
+        marshall(writer, val.is_delta, pos);
+        marshall(writer, val.removed_partitions, pos);
     };
 
     inline void unmarshall(::dsn::binary_reader& reader, __out_param configuration_query_by_node_response& val)
     {
         unmarshall(reader, val.err);
         unmarshall(reader, val.partitions);
+        unmarshall(reader, val.epoch);
+        unmarshall(reader, val.version);
+        unmarshall(reader, val.is_delta);
+        unmarshall(reader, val.removed_partitions);
     };
 
     // ---------- configuration_query_by_index_request -------------
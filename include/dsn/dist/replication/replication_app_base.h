@@ -62,8 +62,11 @@ public:
     virtual int  flush(bool force) = 0;  // must be thread-safe
     
     // replicatoin framework may emit empty write request to this app 
-    // to increase the decree(version)
-    virtual void on_empty_write() { _last_committed_decree++; }
+    // to increase the decree(version); note _last_committed_decree is
+    // advanced by the framework once all updates of a mutation are applied
+    // so apps must not advance it on writes; apps still doing so are detected
+    // on their first write and never get batched mutations (see write_internal)
+    virtual void on_empty_write() { }
 
     //
     // helper routines to accelerate learning
@@ -85,6 +88,17 @@ public:
     //
     virtual ::dsn::replication::decree last_committed_decree() const { return _last_committed_decree.load(); }
     virtual ::dsn::replication::decree last_durable_decree() const { return _last_durable_decree.load(); }
+
+    //
+    // snapshot reads (read_semantic_t::ReadSnapshot) at decree d are served only when
+    // min_readable_decree() <= d <= last_committed_decree(), so apps keeping the 
+    // states of recent decrees (e.g., multi-version stores) override this to
+    // expose them, while others serve snapshot reads at the latest decree only
+    //
+    virtual ::dsn::replication::decree min_readable_decree() const { return last_committed_decree(); }
+
+    // whether multiple updates can be batched into one mutation for this app
+    bool is_write_batch_allowed() const { return _write_batch_allowed; }
             
 public:
     //
@@ -96,6 +110,16 @@ public:
     // set physical error (e.g., disk error) so that the app is dropped by replication later
     //
     void set_physical_error(int err) { _physical_error = err; }
+    //
+    // decree the read being handled is served at, or invalid_decree when it reads the
+    // latest state (only valid inside read handlers, as reads are dispatched inline)
+    //
+    static ::dsn::replication::decree read_decree();
+    //
+    // reject the read being handled with err (e.g., ERR_VERSION_OUTDATED when the
+    // versions at read_decree() are gone) instead of replying to it
+    //
+    static void reject_read(error_code err);
 
 protected:
     template<typename T, typename TRequest, typename TResponse> 
@@ -120,6 +144,7 @@ private:
     friend class replica;
     error_code write_internal(mutation_ptr& mu, bool ack_client);
     void       dispatch_rpc_call(int code, message_ptr& request, bool ack_client);
+    void       dispatch_read(int code, message_ptr& request, decree d);
     
 private:
     std::string _dir_data;
@@ -127,6 +152,8 @@ private:
     replica*    _replica;
     std::unordered_map<int, std::function<void(message_ptr&, message_ptr&)> > _handlers;
     int         _physical_error; // physical error (e.g., io error) indicates the app needs to be dropped
+    bool        _write_contract_checked;
+    bool        _write_batch_allowed;
 
 protected:
     std::atomic<decree> _last_committed_decree;
@@ -34,6 +34,7 @@
 # include <dsn/dist/replication/replication.types.h>
 # include <dsn/dist/replication/replication_other_types.h>
 # include <dsn/dist/replication/replication.codes.h>
+# include <atomic>
 
 namespace dsn { namespace replication {
 
@@ -53,6 +54,23 @@ namespace dsn { namespace replication {
 
         ~replication_app_client_base();
 
+        //
+        // spread ReadLastUpdate reads across the replica group, where secondaries
+        // holding a read lease (see read_lease_ms) serve them and the others make
+        // the client fall back to the primary
+        //
+        void set_lease_reads(bool enabled) { _lease_reads_enabled = enabled; }
+
+        //
+        // coalesce the concurrent requests bound for the same partition and replica into
+        // one RPC_REPLICATION_CLIENT_BATCH_WRITE/READ, sent once it has max_request_count 
+        // requests or max_size_bytes bytes, or linger_us after its first request (rounded
+        // up to milliseconds, and 0 sends it after the tasks already queued have run);
+        // max_request_count <= 1 disables batching, and it is capped to the most that the
+        // replicas accept (CLIENT_BATCH_MAX_COUNT)
+        //
+        void set_request_batching(int max_request_count, int max_size_bytes, int linger_us);
+
         template<typename T, typename TRequest, typename TResponse>
         rpc_response_task_ptr write(
             int partition_index,
@@ -348,6 +366,8 @@ namespace dsn { namespace replication {
             read_request_header   read_header;
             write_request_header  write_header;
             bool                  is_read;
+            bool                  primary_only; // lease reads go to the primary once refused by a secondary
+            int                   version_retry_count; // retries on replicas behind the snapshot decree
             uint16_t              header_pos; // write header after body is written
             uint64_t              timeout_ts_us; // timeout at this timing point
 
@@ -372,6 +392,42 @@ namespace dsn { namespace replication {
         mutable zlock     _requests_lock;
         pending_requests  _pending_requests;        
 
+        struct batch_key
+        {
+            int      partition_index;
+            uint32_t ip;
+            uint16_t port;
+            bool     is_read;
+
+            bool operator < (const batch_key& r) const
+            {
+                if (partition_index != r.partition_index) return partition_index < r.partition_index;
+                if (ip != r.ip) return ip < r.ip;
+                if (port != r.port) return port < r.port;
+                return is_read < r.is_read;
+            }
+        };
+
+        struct batch_context
+        {
+            uint64_t                         id;
+            end_point                        target;
+            bool                             is_read;
+            int                              hash;
+            int                              size;
+            std::vector<request_context_ptr> requests;
+            task_ptr                         linger_timer;
+        };
+
+        typedef std::shared_ptr<batch_context> batch_context_ptr;
+
+        int               _batch_max_request_count;
+        int               _batch_max_size_bytes;
+        int               _batch_linger_ms;
+        zlock             _batches_lock;
+        std::map<batch_key, batch_context_ptr> _batches;
+        uint64_t          _batch_id;
+
     private:
         request_context* create_write_context(
             int partition_index,
@@ -393,20 +449,42 @@ namespace dsn { namespace replication {
         std::string                             _app_name;
         std::vector<end_point>                  _meta_servers;
         
-        mutable zrwlock_nr                      _config_lock;
-        std::unordered_map<int, partition_configuration> _config_cache;
+        //
+        // immutable routing snapshot so that routing a request is a pointer load and
+        // an index, replaced as a whole under _config_lock on configuration updates
+        // and invalidations; requests being routed hold a reference on the snapshot
+        // they read, so a replaced one is freed by its last reader
+        //
+        struct routing_table
+        {
+            uint64_t                             version;
+            std::vector<partition_configuration> partitions; // indexed by pidx, ballot is invalid_ballot when unknown
+        };
+
+        typedef std::shared_ptr<const routing_table> routing_table_ptr;
+
+        zlock                                   _config_lock;
+        routing_table_ptr                       _routing_table; // accessed with std::atomic_load/store
         int                                     _app_id;
         int                                     _app_partition_count;
         end_point                               _last_contact_point;
+        bool                                    _lease_reads_enabled;
 
     private:
+        friend class replication_tester; // unit tests (src/tests)
         void call(request_context_ptr request, bool no_delay = true);
-        error_code get_address(int pidx, bool is_write, __out_param end_point& addr, __out_param int& app_id, read_semantic_t semantic = read_semantic_t::ReadLastUpdate);
+        error_code get_address(int pidx, bool to_primary, __out_param end_point& addr, __out_param int& app_id, read_semantic_t semantic = read_semantic_t::ReadLastUpdate);
+        void publish_routing_table(routing_table* tbl); // under _config_lock
+        void invalidate_partition_configuration(int pidx);
         void query_partition_configuration_reply(error_code err, message_ptr& request, message_ptr& response, int pidx);
         void replica_rw_reply(error_code err, message_ptr& request, message_ptr& response, request_context_ptr& rc);
         void end_request(request_context_ptr& request, error_code err, message_ptr& resp);
         void on_user_request_timeout(request_context_ptr& rc);
         void clear_all_pending_tasks();
+        void batch_request(request_context_ptr& request, const end_point& addr);
+        void flush_batch(batch_key key, uint64_t id);
+        void send_batch(batch_context_ptr& b);
+        void on_batch_reply(error_code err, message_ptr& request, message_ptr& response, batch_context_ptr b);
     };
 
     DEFINE_REF_OBJECT(replication_app_client_base::request_context);
@@ -156,8 +156,19 @@ public:
         clock_gettime(CLOCK_REALTIME, &ts);
         ts.tv_sec += timeout_milliseconds / 1000;
         ts.tv_nsec += timeout_milliseconds % 1000 * 1000000;
+        if (ts.tv_nsec >= 1000000000)
+        {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
         
-        return sem_timedwait(&m_sema, &ts) == 0;
+        int rc;
+        do
+        {
+            rc = sem_timedwait(&m_sema, &ts);
+        }
+        while (rc == -1 && errno == EINTR);
+        return rc == 0;
     }
 
     void signal()
@@ -241,8 +252,20 @@ public:
             return true;
         if (m_sema.wait(timeout_milliseconds))
             return true;
-        signal(); // restore the substracted count
-        return false;
+
+        // restore the substracted count, unless a signal has been released to
+        // the underlying semaphore for us meanwhile, which must be consumed
+        while (true)
+        {
+            oldCount = m_count.load(std::memory_order_relaxed);
+            if (oldCount < 0 && m_count.compare_exchange_strong(oldCount, oldCount + 1, std::memory_order_relaxed))
+                return false;
+            if (oldCount >= 0)
+            {
+                m_sema.wait();
+                return true;
+            }
+        }
     }
 
     void signal(int count = 1)
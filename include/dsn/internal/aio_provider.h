@@ -49,9 +49,19 @@ public:
     virtual void    aio(aio_task_ptr& aio) = 0;
     virtual disk_aio_ptr prepare_aio_context(aio_task*) = 0;
 
+    // whether a write with disk_aio::sync_after_write is issued together with its
+    // sync (e.g., as linked requests), otherwise the disk engine issues the sync
+    // as another AIO_Sync after the write completes
+    virtual bool    links_sync_to_write() const { return false; }
+
 protected:
     void complete_io(aio_task_ptr& aio, error_code err, uint32_t bytes, int delay_milliseconds = 0);
 
+    // vectored io for providers without native scatter/gather support: the
+    // buffers are copied into a bounce buffer which becomes aio->buffer, and
+    // copied back into the buffers by complete_io for reads
+    static void gather_buffers(disk_aio* aio);
+
 private:
     disk_engine *_engine;
 };
@@ -123,6 +123,7 @@ struct service_spec
     std::string                  logging_factory_name;
     std::string                  memory_factory_name; // for upper applications
     std::string                  tools_memory_factory_name; // for rDSN itself and lower tools
+    int                          timer_wheel_tick_milliseconds; // granularity of delayed tasks
 
     std::list<std::string>       network_aspects; // toollets compatible to the above network main providers in network configs
     std::list<std::string>       aio_aspects; // toollets compatible to main aio provider
@@ -136,7 +137,7 @@ struct service_spec
     std::vector<threadpool_spec>  threadpool_specs;
     std::vector<service_app_spec> app_specs;
 
-    service_spec() {}
+    service_spec() : timer_wheel_tick_milliseconds(1) {}
     bool init(configuration_ptr config);
     bool init_app_specs(configuration_ptr c);
 };
@@ -155,6 +156,7 @@ CONFIG_BEGIN(service_spec)
     CONFIG_FLD(std::string, logging_factory_name, "")
     CONFIG_FLD(std::string, memory_factory_name, "")
     CONFIG_FLD(std::string, tools_memory_factory_name, "")
+    CONFIG_FLD(int, timer_wheel_tick_milliseconds, 1)
 
     CONFIG_FLD_STRING_LIST(network_aspects)
     CONFIG_FLD_STRING_LIST(aio_aspects)
@@ -45,11 +45,16 @@ namespace dsn
         void* read_buffer_ptr(int read_next);
         int read_buffer_capacity() const;
 
-        // afer read, see if we can compose a message
+        // afer read, see if we can compose a message;
+        // read_next is set to -1 when the stream is malformed and the session must be closed
         virtual message_ptr get_message_on_receive(int read_length, __out_param int& read_next) = 0;
 
-        // before write
+        // before write; buffers of several messages may be written together, so
+        // they must stay valid after the next call
         virtual void prepare_buffers_for_send(message_ptr& msg, __out_param std::vector<blob>& buffers) = 0;
+
+        // larger body lengths from the peer are rejected
+        static const int MAX_BODY_LENGTH = 256 * 1024 * 1024;
         
     protected:
         void create_new_buffer(int sz);
@@ -72,5 +77,40 @@ namespace dsn
         {
             return msg->writer().get_buffers(buffers);
         }
+
+    protected:
+        // parse from the already read buffer
+        message_ptr get_message(__out_param int& read_next);
+    };
+
+    //
+    // NET_HDR_COMPACT - the header is varint encoded and carries rpc_wire_code instead of 
+    // the rpc name (resolved by the rpc engine, so rpcs whose wire codes collide are not
+    // reachable in this format), and no header crc:
+    //    magic (4 bytes) | header length (1 byte) | flags (1 byte) | body_length | rpc_wire_code 
+    //    | id | rpc_id | timeout_ms/error | hash | port | [body_crc32 (4 bytes)] | body
+    //
+    // messages in NET_HDR_DSN are still accepted, and replies to such a peer are sent 
+    // in NET_HDR_DSN as well, so that old peers keep working with a compact server port.
+    //
+    class compact_message_parser : public dsn_message_parser
+    {
+    public:
+        compact_message_parser(int buffer_block_size);
+
+        virtual message_ptr get_message_on_receive(int read_length, __out_param int& read_next);
+        virtual void prepare_buffers_for_send(message_ptr& msg, __out_param std::vector<blob>& buffers);
+
+        static const uint32_t MAGIC = 0x63534e44; // "DNSc" in little endian
+        static const int MAX_HEADER_LENGTH = 64;
+
+        // header field codec, read_varint returns nullptr on truncated input
+        static char* write_varint(char* ptr, uint64_t v);
+        static const char* read_varint(const char* ptr, const char* end, __out_param uint64_t& v);
+        static uint32_t zigzag_encode(int32_t v);
+        static int32_t zigzag_decode(uint64_t v);
+
+    private:
+        bool _peer_compact; // whether the remote peer speaks NET_HDR_COMPACT
     };
 }
\ No newline at end of file
@@ -82,6 +82,7 @@ namespace dsn {
         // utilities
         //
         service_node* node() const;
+        rpc_engine* engine() const { return _engine; }
 
         //
         // called when network received a complete message
@@ -140,6 +141,7 @@ namespace dsn {
     private:
         friend class rpc_timeout_task;
         void on_rpc_timeout(uint64_t key);
+        void reuse_timeout_task(task_ptr& timeout_task);
 
     private:
         struct match_entry
@@ -149,6 +151,7 @@ namespace dsn {
         };
         typedef std::unordered_map<uint64_t, match_entry> rpc_requests;
         rpc_requests                  _requests;
+        std::vector<task_ptr>         _free_timeout_tasks; // cancelled when the replies arrived in time
         ::dsn::utils::ex_lock_nr_spin _requests_lock;
     };
 
@@ -226,6 +229,7 @@ namespace dsn {
         void on_recv_request(message_ptr& msg, int delay_ms);
         void on_disconnected();
         const end_point& remote_address() const { return _remote_addr; }
+        connection_oriented_network& net() const { return _net; }
 
         virtual void send(message_ptr& reply_msg) = 0;
 
@@ -26,6 +26,7 @@
 #pragma once
 
 #include <queue>
+#include <vector>
 #include <cassert>
 #include <dsn/internal/logging.h>
 #include <dsn/internal/synchronize.h>
@@ -40,7 +41,6 @@ public:
     {
         _name = name;
         _count = 0;
-        _peeked_item = nullptr;
     }
 
     virtual long enqueue(T obj, uint32_t priority)
@@ -59,29 +59,74 @@ public:
         auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
 
         // already peeked
-        if (nullptr != _peeked_item)
+        if (_peeked_items.size() > 0)
             return nullptr;
 
         else
         {
             long ct = 0;
-            _peeked_item = dequeue_impl(ct);
-            return _peeked_item;
+            auto c = dequeue_impl(ct);
+            if (nullptr != c)
+                _peeked_items.push_back(c);
+            return c;
         }
     }
 
+    //
+    // peek at most max_count items in priority order so they can be consumed
+    // together (e.g., one batched write), stopping before the accumulated
+    // item_size(item) exceeds max_bytes; the first item is always taken
+    // regardless of its size. returns 0 when empty or when the last peek
+    // is not yet released by dequeue_peeked_batch.
+    //
+    template<typename TSizer>
+    int peek_batch(__out_param std::vector<T>& items, int max_count, size_t max_bytes, TSizer item_size)
+    {
+        auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
+
+        if (_peeked_items.size() > 0)
+            return 0;
+
+        size_t bytes = 0;
+        while (_count > 0 && static_cast<int>(_peeked_items.size()) < max_count)
+        {
+            T& c = front_impl();
+            size_t sz = item_size(c);
+            if (_peeked_items.size() > 0 && bytes + sz > max_bytes)
+                break;
+
+            long ct = 0;
+            bytes += sz;
+            _peeked_items.push_back(dequeue_impl(ct));
+        }
+
+        items = _peeked_items;
+        return static_cast<int>(items.size());
+    }
+
     virtual T dequeue_peeked()
     {
         auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
-        auto c = _peeked_item;
-        _peeked_item = nullptr;
+        if (_peeked_items.size() == 0)
+            return nullptr;
+
+        auto c = _peeked_items[0];
+        _peeked_items.clear();
+        return c;
+    }
+
+    int dequeue_peeked_batch()
+    {
+        auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
+        int c = static_cast<int>(_peeked_items.size());
+        _peeked_items.clear();
         return c;
     }
 
     bool is_peeked()
     {
         auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
-        return _peeked_item != nullptr;
+        return _peeked_items.size() > 0;
     }
 
     virtual T dequeue()
@@ -102,6 +147,21 @@ public:
     long count() const { auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock); return _count; }
 
 protected:
+    T& front_impl()
+    {
+        int index = priority_count - 1;
+        for (; index >= 0; index--)
+        {
+            if (_items[index].size() > 0)
+            {
+                break;
+            }
+        }
+
+        dassert (index >= 0, "must find something");
+        return _items[index].front();
+    }
+
     T dequeue_impl(__out_param long& ct, bool pop = true)
     {
         if (_count == 0)
@@ -128,7 +188,7 @@ protected:
 
 protected:
     std::string   _name;
-    T             _peeked_item;
+    std::vector<T> _peeked_items;
     TQueue        _items[priority_count];
     long          _count;
     mutable utils::ex_lock_nr_spin _lock;
@@ -61,6 +61,13 @@ struct message_header
         } server;
     };
 
+    // see task_spec::rpc_wire_code, 0 for peers which only set rpc_name;
+    // on 64-bit builds it occupies what used to be the tail padding before
+    // from_address (zeroed by message's constructors), so the serialized size,
+    // the offsets of all other fields and the header crc coverage are unchanged
+    // and older peers interoperate in both directions
+    uint32_t      rpc_wire_code;
+
     // local fields - no need to be transmitted
     end_point     from_address;
     end_point     to_address;
@@ -83,14 +90,14 @@ class rpc_server_session;
 class message : public ref_object, public extensible_object<message, 4>, public ::dsn::tools::memory::tallocator_object
 {
 public:
-    message(); // write             
+    message(int reserved_buffer_size = 0); // write, with the size of each buffer in the writer's chain
     message(blob bb, bool parse_hdr = true); // read 
     virtual ~message();
 
     //
     // routines for request and response
     //
-    static message_ptr create_request(task_code rpc_code, int timeout_milliseconds = 0, int hash = 0);
+    static message_ptr create_request(task_code rpc_code, int timeout_milliseconds = 0, int hash = 0, int reserved_buffer_size = 0);
     message_ptr create_response();
 
     //
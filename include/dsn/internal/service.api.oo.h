@@ -233,6 +233,47 @@ namespace dsn {
                 int hash = 0
                 );
 
+            aio_task_ptr read_vector(
+                handle_t hFile,
+                const file_buffer* buffers,
+                int buffer_count,
+                uint64_t offset,
+                task_code callback_code,
+                servicelet* owner,
+                aio_handler callback,
+                int hash = 0
+                );
+
+            aio_task_ptr write_vector(
+                handle_t hFile,
+                const file_buffer* buffers,
+                int buffer_count,
+                uint64_t offset,
+                task_code callback_code,
+                servicelet* owner,
+                aio_handler callback,
+                int hash = 0
+                );
+
+            aio_task_ptr write_vector_and_sync(
+                handle_t hFile,
+                const file_buffer* buffers,
+                int buffer_count,
+                uint64_t offset,
+                task_code callback_code,
+                servicelet* owner,
+                aio_handler callback,
+                int hash = 0
+                );
+
+            aio_task_ptr sync(
+                handle_t hFile,
+                task_code callback_code,
+                servicelet* owner,
+                aio_handler callback,
+                int hash = 0
+                );
+
             template<typename T>
             inline aio_task_ptr read(
                 handle_t hFile,
@@ -265,6 +306,19 @@ namespace dsn {
                 return write(hFile, buffer, count, offset, callback_code, owner, h, hash);
             }
 
+            template<typename T>
+            inline aio_task_ptr sync(
+                handle_t hFile,
+                task_code callback_code,
+                T* owner,
+                void(T::*callback)(error_code, uint32_t),
+                int hash = 0
+                )
+            {
+                aio_handler h = std::bind(callback, owner, std::placeholders::_1, std::placeholders::_2);
+                return sync(hFile, callback_code, owner, h, hash);
+            }
+
             aio_task_ptr copy_remote_files(
                 const end_point& remote,
                 const std::string& source_dir,
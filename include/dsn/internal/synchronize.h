@@ -185,6 +185,12 @@ namespace dsn {
                 return true;
             }
 
+            // take one count without blocking, return false when there is none
+            inline bool try_wait()
+            {
+                return _sema.tryWait();
+            }
+
         private:
             LightweightSemaphore _sema;
         };
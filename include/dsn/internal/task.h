@@ -41,6 +41,7 @@ class task_worker;
 class task_worker_pool;
 class service_node;
 class task;
+class timer_wheel;
 
 struct __tls_task_info__
 {
@@ -90,6 +91,11 @@ protected:
     void                    enqueue(task_worker_pool* pool);
     void                    set_task_id(uint64_t tid) { _task_id = tid;  }
 
+    // make a cancelled task ready to be enqueued again, so that it can be reused
+    // instead of allocating a new one; fails when the task is referenced
+    // elsewhere (e.g., still held by a task queue) or has been waited on
+    bool                    reset_cancelled();
+
     mutable std::atomic<task_state> _state;
     bool                   _is_null;
 
@@ -108,6 +114,8 @@ private:
 public:
     // used by task queue only
     dlink                  _task_queue_dl;
+    timer_wheel            *_task_queue_wheel; // non-null when delayed in a timer wheel
+    uint64_t               _task_queue_wheel_tick; // expiration tick in the timer wheel
 };
 
 DEFINE_REF_OBJECT(task)
@@ -202,7 +210,14 @@ enum aio_type
 {
     AIO_Invalid,
     AIO_Read,
-    AIO_Write
+    AIO_Write,
+    AIO_Sync    // durable barrier (fdatasync) on the file, buffer is unused
+};
+
+struct file_buffer
+{
+    void*        buffer;
+    uint32_t     size;
 };
 
 class disk_engine;
@@ -212,14 +227,20 @@ public:
     // filled by apps
     handle_t     file;
     void*        buffer;
-    uint32_t     buffer_size;    
+    uint32_t     buffer_size;    // total size of buffers for vectored io
     uint64_t     file_offset;
+    std::vector<file_buffer> buffers; // vectored io when not empty, buffer is then unused
 
     // filled by frameworks
     aio_type     type;
     disk_engine *engine;
+    bool         sync_after_write; // AIO_Write completes only after a fdatasync of the file
+    uint32_t     written_bytes;    // of the write when sync_after_write, reported upon the sync
+
+    // for providers without scatter/gather support, see aio_provider::gather_buffers
+    std::unique_ptr<char[]> bounce_buffer;
 
-    disk_aio() : type(aio_type::AIO_Invalid) {}
+    disk_aio() : type(aio_type::AIO_Invalid), sync_after_write(false), written_bytes(0) {}
     virtual ~disk_aio(){}
 };
 
@@ -93,6 +93,7 @@ ENUM_END(task_state)
 // define network header format for RPC
 DEFINE_CUSTOMIZED_ID_TYPE(network_header_format);
 DEFINE_CUSTOMIZED_ID(network_header_format, NET_HDR_DSN);
+DEFINE_CUSTOMIZED_ID(network_header_format, NET_HDR_COMPACT);
 
 // define network channel types for RPC
 DEFINE_CUSTOMIZED_ID_TYPE(rpc_channel)
@@ -160,10 +161,12 @@ public:
     task_type              type;
     const char*            name;    
     task_code              rpc_paired_code;
+    uint32_t               rpc_wire_code; // deterministic code for RPC dispatch across processes, see get_rpc_wire_code
     task_priority          priority;
     threadpool_code        pool_code; 
     bool                   allow_inline; // allow task executed in other thread pools or tasks
     bool                   fast_execution_in_network_thread;
+    bool                   allow_work_stealing; // hash-free tasks may run on any worker of a partitioned pool
     network_header_format  rpc_call_header_format;
 
     task_rejection_handler rejection_handler;
@@ -202,11 +205,18 @@ public:
 public:
     static bool init(configuration_ptr config);
     void init_profiling(bool profile);
+
+    //
+    // wire-level rpc code, derived from the rpc name only so that every process
+    // computes the same value without negotiation (0 is reserved for 'absent')
+    //
+    static uint32_t get_rpc_wire_code(const char* rpc_name);
 };
 
 CONFIG_BEGIN(task_spec)
     CONFIG_FLD(bool, allow_inline, false)
     CONFIG_FLD(bool, fast_execution_in_network_thread, false)
+    CONFIG_FLD(bool, allow_work_stealing, false)
     CONFIG_FLD_ID(network_header_format, rpc_call_header_format, NET_HDR_DSN)
     CONFIG_FLD_ID(rpc_channel, rpc_call_channel, RPC_CHANNEL_TCP)
     CONFIG_FLD(int32_t, rpc_timeout_milliseconds, 5000)
@@ -42,7 +42,7 @@ public:
 
 public:
     task_queue(task_worker_pool* pool, int index, task_queue* inner_provider); 
-    ~task_queue() {}
+    virtual ~task_queue() {}
     
     // before enqueue, the caller calls task::add_ref to ensure a reference is kept
     virtual void     enqueue(task* task) = 0;
@@ -50,6 +50,9 @@ public:
     // after dequeue, the caller calles task::release_ref to release the reference
     virtual task* dequeue() = 0;
 
+    // dequeue up to max_count tasks at once, blocking until there is at least one
+    // unless the queue returns nullptr from dequeue; return the number of tasks
+    virtual int      dequeue_batch(task** tasks, int max_count);
 
     virtual int      count() const = 0;
 
@@ -58,6 +61,11 @@ public:
     admission_controller* controller() const { return _controller; }
     void set_controller(admission_controller* controller) { _controller = controller; }
 
+protected:
+    // park a delayed task in the timer wheel of the node, and the task is
+    // re-enqueued with zero delay on expiration
+    void enqueue_delayed(task* task);
+
 private:
     task_worker_pool*      _pool;
     std::string            _name;
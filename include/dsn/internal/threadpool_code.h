@@ -68,6 +68,7 @@ struct threadpool_spec
     uint64_t                worker_affinity_mask;
     unsigned int            max_input_queue_length; // 0xFFFFFFFFUL by default
     bool                    partitioned;         // false by default
+    int                     dequeue_batch_size;  // max tasks a worker takes from its queue at a time, 1 by default
     std::string             queue_factory_name;
     std::string             worker_factory_name;
     std::list<std::string>  queue_aspects;
@@ -92,6 +93,7 @@ CONFIG_BEGIN(threadpool_spec)
     CONFIG_FLD(uint64_t, worker_affinity_mask, 0)
     CONFIG_FLD(unsigned int, max_input_queue_length, 0xFFFFFFFFUL)
     CONFIG_FLD(bool, partitioned, false)
+    CONFIG_FLD(int, dequeue_batch_size, 1)
     CONFIG_FLD(std::string, queue_factory_name, std::string(""))
     CONFIG_FLD(std::string, worker_factory_name, std::string(""))
     CONFIG_FLD_STRING_LIST(queue_aspects)
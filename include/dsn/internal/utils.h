@@ -168,6 +168,11 @@ namespace dsn {
         void write(const blob& val, uint16_t pos = 0xffff);
         void write_empty(int sz, uint16_t pos = 0xffff);
 
+        // append the raw bytes of val (no length prefix) by referencing val in the
+        // buffer chain instead of copying it, so val must not be changed afterwards;
+        // small blobs are still copied as an extra buffer costs more than the copy
+        void write_shared(const blob& val);
+
         bool next(void** data, int* size);
         bool backup(int count);
 
@@ -262,6 +267,13 @@ namespace dsn {
         extern int get_current_tid();
 
         inline int get_invalid_tid() { return -1; }
+
+        // lz4 block format, without the frame
+        // compress returns the compressed size, or 0 when capacity < lz4_compress_bound(size)
+        // decompress returns the decompressed size, or -1 for corrupted input or a too small capacity
+        extern int lz4_compress_bound(int size);
+        extern int lz4_compress(const char* src, int size, char* dst, int capacity);
+        extern int lz4_decompress(const char* src, int size, char* dst, int capacity);
     }
 } // end namespace dsn::utils
 
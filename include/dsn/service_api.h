@@ -127,6 +127,26 @@ namespace file
     //
     extern void write(handle_t hFile, const char* buffer, int count, uint64_t offset, aio_task_ptr& callback); 
 
+    //
+    // asynchronous vectored read/write, where the buffers are filled or written
+    // in order starting from the offset, similar to preadv/pwritev;
+    // the buffer array itself is copied, while the data must stay valid until completion
+    //
+    extern void read_vector(handle_t hFile, const file_buffer* buffers, int buffer_count, uint64_t offset, aio_task_ptr& callback);
+    extern void write_vector(handle_t hFile, const file_buffer* buffers, int buffer_count, uint64_t offset, aio_task_ptr& callback);
+
+    //
+    // write_vector followed by a sync, the callback is invoked with the written size 
+    // when the sync is done; providers may submit both at once (e.g., linked in io_uring)
+    //
+    extern void write_vector_and_sync(handle_t hFile, const file_buffer* buffers, int buffer_count, uint64_t offset, aio_task_ptr& callback);
+
+    //
+    // asynchronous durable barrier (i.e., fdatasync) on the file, the callback is
+    // invoked when all the writes completed before this call are persisted
+    //
+    extern void sync(handle_t hFile, aio_task_ptr& callback);
+
     //
     // close the file handle
     //
@@ -256,10 +256,6 @@ namespace dsn {
             ::dsn::tools::register_component_provider<thrift_binary_message_parser>("thrift");
         }
 
-    private:
-        // only one concurrent write message for each parser, so
-        char _write_buffer_for_header[512];
-
     public:
         thrift_binary_message_parser(int buffer_block_size)
             : message_parser(buffer_block_size)
@@ -268,8 +264,10 @@ namespace dsn {
 
         virtual void prepare_buffers_for_send(message_ptr& msg, __out_param std::vector<blob>& buffers)
         {
-            // prepare head
-            blob bb(_write_buffer_for_header, 0, 512);
+            // prepare head, in its own buffer as net_io sends several messages
+            // prepared by this parser with one write
+            std::shared_ptr<char> buffer((char*)::malloc(512));
+            blob bb(buffer, 0, 512);
             binary_writer writer(bb);
             boost::shared_ptr<::dsn::binary_writer_transport> transport(new ::dsn::binary_writer_transport(writer));
             ::apache::thrift::protocol::TBinaryProtocol proto(transport);
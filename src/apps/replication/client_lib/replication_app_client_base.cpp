@@ -63,6 +63,15 @@ replication_app_client_base::replication_app_client_base(
     _app_id = -1;
     _app_partition_count = -1;
     _last_contact_point = end_point::INVALID;
+    _lease_reads_enabled = false;
+    _batch_max_request_count = 0;
+    _batch_max_size_bytes = 0;
+    _batch_linger_ms = 0;
+    _batch_id = 0;
+
+    auto tbl = new routing_table;
+    tbl->version = 0;
+    _routing_table = routing_table_ptr(tbl);
 }
 
 replication_app_client_base::~replication_app_client_base()
@@ -74,6 +83,23 @@ void replication_app_client_base::clear_all_pending_tasks()
 {
     message_ptr nil(nullptr);
 
+    std::map<batch_key, batch_context_ptr> batches;
+    {
+        service::zauto_lock l(_batches_lock);
+        batches.swap(_batches);
+    }
+
+    for (auto& kv : batches)
+    {
+        if (kv.second->linger_timer != nullptr)
+            kv.second->linger_timer->cancel(true);
+
+        for (auto& rc : kv.second->requests)
+        {
+            end_request(rc, ERR_TIMEOUT, nil);
+        }
+    }
+
     service::zauto_lock l(_requests_lock);
     for (auto& pc : _pending_requests)
     {
@@ -91,6 +117,19 @@ void replication_app_client_base::clear_all_pending_tasks()
 
 DEFINE_TASK_CODE(LPC_REPLICATION_CLIENT_REQUEST_TIMEOUT, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
 DEFINE_TASK_CODE(LPC_REPLICATION_DELAY_QUERY_CONFIG, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+DEFINE_TASK_CODE(LPC_REPLICATION_CLIENT_BATCH_LINGER, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+DEFINE_TASK_CODE(LPC_REPLICATION_DELAY_RETRY, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+// snapshot reads refused by replicas behind the snapshot decree are retried
+// with a delay doubling from 10 ms up to 1 second, at most this many times
+static const int max_version_retry_count = 10;
+
+void replication_app_client_base::set_request_batching(int max_request_count, int max_size_bytes, int linger_us)
+{
+    _batch_max_size_bytes = max_size_bytes;
+    _batch_linger_ms = (linger_us + 999) / 1000;
+    _batch_max_request_count = std::min(max_request_count, CLIENT_BATCH_MAX_COUNT);
+}
 
 replication_app_client_base::request_context* replication_app_client_base::create_write_context(
     int partition_index,
@@ -102,10 +141,12 @@ replication_app_client_base::request_context* replication_app_client_base::creat
     auto rc = new request_context;
     rc->callback_task = callback;    
     rc->is_read = false;
+    rc->primary_only = true;
     rc->partition_index = partition_index;    
     rc->write_header.gpid.app_id = _app_id;
     rc->write_header.gpid.pidx = partition_index;
     rc->write_header.code = code;
+    rc->version_retry_count = 0;
     rc->timeout_timer = nullptr;
     rc->timeout_ts_us = now_us() + callback->get_request()->header().client.timeout_ms * 1000;
     rc->completed = false;
@@ -137,12 +178,14 @@ replication_app_client_base::request_context* replication_app_client_base::creat
     auto rc = new request_context;
     rc->callback_task = callback;    
     rc->is_read = true;
+    rc->primary_only = false;
     rc->partition_index = partition_index;
     rc->read_header.gpid.app_id = _app_id;
     rc->read_header.gpid.pidx = partition_index;
     rc->read_header.code = code;
     rc->read_header.semantic = read_semantic;
     rc->read_header.version_decree = snapshot_decree;
+    rc->version_retry_count = 0;
     rc->timeout_timer = nullptr;
     rc->timeout_ts_us = now_us() + callback->get_request()->header().client.timeout_ms * 1000;
     rc->completed = false;
@@ -214,7 +257,7 @@ void replication_app_client_base::call(request_context_ptr request, bool no_dela
 
     error_code err = get_address(
         request->partition_index,
-        !request->is_read,
+        request->primary_only,
         addr,
         app_id,
         request->read_header.semantic
@@ -244,6 +287,11 @@ void replication_app_client_base::call(request_context_ptr request, bool no_dela
             request->header_pos = 0xffff;
         }
 
+        if (_batch_max_request_count > 1)
+        {
+            batch_request(request, addr);
+        }
+        else
         {
             zauto_lock l(request->lock);
             request->rw_task = rpc::call(
@@ -352,7 +400,32 @@ void replication_app_client_base::replica_rw_reply(
     response->reader().read(err2);
     err.set(err2);
     
-    if (err != ERR_OK && err != ERR_HANDLER_NOT_FOUND)
+    if (err == ERR_INVALID_STATE && rc->is_read && !rc->primary_only 
+        && rc->read_header.semantic == read_semantic_t::ReadLastUpdate && _lease_reads_enabled)
+    {
+        // the secondary has no valid read lease, or has not applied the primary's commit point yet
+        rc->primary_only = true;
+        call(rc.get(), false);
+        return;
+    }
+    else if (err == ERR_INVALID_VERSION)
+    {
+        // the replica is behind the snapshot, and the configuration is still valid
+        if (++rc->version_retry_count > max_version_retry_count)
+        {
+            end_request(rc, err, response);
+        }
+        else
+        {
+            tasking::enqueue(LPC_REPLICATION_DELAY_RETRY, this,
+                std::bind(&replication_app_client_base::call, this, rc, false),
+                0,
+                std::min(10 << (rc->version_retry_count - 1), 1000)
+                );
+        }
+        return;
+    }
+    else if (err != ERR_OK && err != ERR_HANDLER_NOT_FOUND && err != ERR_VERSION_OUTDATED)
     {
         goto Retry;
     }
@@ -364,52 +437,52 @@ void replication_app_client_base::replica_rw_reply(
 
 Retry:
     // clear partition configuration as it could be wrong
-    {
-        zauto_write_lock l(_config_lock);
-        _config_cache.erase(rc->is_read ? rc->read_header.gpid.pidx : rc->write_header.gpid.pidx);
-    }
+    invalidate_partition_configuration(rc->is_read ? rc->read_header.gpid.pidx : rc->write_header.gpid.pidx);
 
     // then retry
     call(rc.get(), false);
 }
 
-error_code replication_app_client_base::get_address(int pidx, bool is_write, __out_param end_point& addr, __out_param int& app_id, read_semantic_t semantic)
+error_code replication_app_client_base::get_address(int pidx, bool to_primary, __out_param end_point& addr, __out_param int& app_id, read_semantic_t semantic)
 {
-    error_code err;
-    partition_configuration config;
-     
-    {
-    zauto_read_lock l(_config_lock);
-    auto it = _config_cache.find(pidx);
-    if (it != _config_cache.end())
+    auto tbl = std::atomic_load(&_routing_table);
+    if (pidx < 0 || pidx >= static_cast<int>(tbl->partitions.size()))
+        return ERR_IO_PENDING;
+
+    auto& config = tbl->partitions[pidx];
+    if (config.ballot == invalid_ballot)
+        return ERR_IO_PENDING;
+
+    app_id = config.gpid.app_id;
+    if (to_primary)
     {
-        err = ERR_OK;
-        config = it->second;
+        addr = config.primary;
     }
     else
     {
-        err = ERR_IO_PENDING;
-    }
+        addr = get_read_address(semantic, config);
     }
 
-    if (err == ERR_OK)
-    {
-        app_id = _app_id;
-        if (is_write)
-        {
-            addr = config.primary;
-        }
-        else
-        {
-            addr = get_read_address(semantic, config);
-        }
+    return (dsn::end_point::INVALID == addr) ? ERR_IO_PENDING : ERR_OK;
+}
 
-        if (dsn::end_point::INVALID == addr)
-        {
-            err = ERR_IO_PENDING;
-        }
-    } 
-    return err;
+void replication_app_client_base::publish_routing_table(routing_table* tbl)
+{
+    tbl->version = _routing_table->version + 1;
+    std::atomic_store(&_routing_table, routing_table_ptr(tbl));
+}
+
+void replication_app_client_base::invalidate_partition_configuration(int pidx)
+{
+    zauto_lock l(_config_lock);
+    auto& old = _routing_table;
+    if (pidx < 0 || pidx >= static_cast<int>(old->partitions.size()) 
+        || old->partitions[pidx].ballot == invalid_ballot)
+        return;
+
+    auto tbl = new routing_table(*old);
+    tbl->partitions[pidx].ballot = invalid_ballot;
+    publish_routing_table(tbl);
 }
 
 void replication_app_client_base::query_partition_configuration_reply(error_code err, message_ptr& request, message_ptr& response, int pidx)
@@ -420,7 +493,7 @@ void replication_app_client_base::query_partition_configuration_reply(error_code
         unmarshall(response->reader(), resp);
         if (resp.err == ERR_OK)
         {
-            zauto_write_lock l(_config_lock);
+            zauto_lock l(_config_lock);
             _last_contact_point = response->header().from_address;
 
             if (resp.partitions.size() > 0)
@@ -435,19 +508,38 @@ void replication_app_client_base::query_partition_configuration_reply(error_code
                 _app_partition_count = resp.partition_count;
             }
 
+            std::unique_ptr<routing_table> tbl;
             for (auto it = resp.partitions.begin(); it != resp.partitions.end(); it++)
             {
                 partition_configuration& new_config = *it;
-                auto it2 = _config_cache.find(new_config.gpid.pidx);
-                if (it2 == _config_cache.end())
+                int index = new_config.gpid.pidx;
+                if (tbl == nullptr)
+                {
+                    // copied on first change only
+                    auto& old = _routing_table;
+                    if (index < static_cast<int>(old->partitions.size()) 
+                        && old->partitions[index].ballot >= new_config.ballot)
+                        continue;
+                    tbl.reset(new routing_table(*old));
+                }
+
+                if (index >= static_cast<int>(tbl->partitions.size()))
                 {
-                    _config_cache[new_config.gpid.pidx] = new_config;
+                    partition_configuration unknown;
+                    unknown.ballot = invalid_ballot;
+                    tbl->partitions.resize(std::max(index + 1, _app_partition_count), unknown);
                 }
-                else if (it2->second.ballot < new_config.ballot)
+
+                if (tbl->partitions[index].ballot < new_config.ballot)
                 {
-                    it2->second = new_config;
+                    tbl->partitions[index] = std::move(new_config);
                 }
             }
+
+            if (tbl != nullptr)
+            {
+                publish_routing_table(tbl.release());
+            }
         }
     }
         
@@ -474,12 +566,174 @@ void replication_app_client_base::query_partition_configuration_reply(error_code
     }
 }
 
+void replication_app_client_base::batch_request(request_context_ptr& request, const end_point& addr)
+{
+    auto& msg = request->callback_task->get_request();
+    msg->seal(false);
+
+    batch_key key;
+    key.partition_index = request->partition_index;
+    key.ip = addr.ip;
+    key.port = addr.port;
+    key.is_read = request->is_read;
+
+    batch_context_ptr full;
+    {
+        zauto_lock l(_batches_lock);
+        auto& b = _batches[key];
+        if (b == nullptr)
+        {
+            b.reset(new batch_context);
+            b->id = ++_batch_id;
+            b->target = addr;
+            b->is_read = request->is_read;
+            b->hash = msg->header().client.hash;
+            b->size = 0;
+        }
+
+        b->requests.push_back(request);
+        b->size += msg->total_size();
+
+        if (static_cast<int>(b->requests.size()) >= _batch_max_request_count
+            || b->size >= _batch_max_size_bytes)
+        {
+            if (b->linger_timer != nullptr)
+                b->linger_timer->cancel(false);
+            full = b;
+            _batches.erase(key);
+        }
+        else if (b->requests.size() == 1)
+        {
+            b->linger_timer = tasking::enqueue(
+                LPC_REPLICATION_CLIENT_BATCH_LINGER,
+                this,
+                std::bind(&replication_app_client_base::flush_batch, this, key, b->id),
+                0,
+                _batch_linger_ms
+                );
+        }
+    }
+
+    if (full != nullptr)
+    {
+        send_batch(full);
+    }
+}
+
+void replication_app_client_base::flush_batch(batch_key key, uint64_t id)
+{
+    batch_context_ptr b;
+    {
+        zauto_lock l(_batches_lock);
+        auto it = _batches.find(key);
+
+        // already sent when full
+        if (it == _batches.end() || it->second->id != id)
+            return;
+
+        b = it->second;
+        _batches.erase(it);
+    }
+
+    send_batch(b);
+}
+
+void replication_app_client_base::send_batch(batch_context_ptr& b)
+{
+    // the batch times out with its most urgent request, and the others are then retried
+    uint64_t timeout_ts_us = b->requests[0]->timeout_ts_us;
+    for (auto& rc : b->requests)
+    {
+        if (rc->timeout_ts_us < timeout_ts_us)
+            timeout_ts_us = rc->timeout_ts_us;
+    }
+
+    auto nts = now_us();
+    int timeout_ms = (nts + 1000 > timeout_ts_us) ? 1 : static_cast<int>(timeout_ts_us - nts) / 1000;
+
+    message_ptr msg = message::create_request(
+        b->is_read ? RPC_REPLICATION_CLIENT_BATCH_READ : RPC_REPLICATION_CLIENT_BATCH_WRITE,
+        timeout_ms,
+        b->hash
+        );
+
+    std::vector<blob> bbs;
+    for (auto& rc : b->requests)
+    {
+        bbs.push_back(rc->callback_task->get_request()->writer().get_buffer());
+    }
+    client_batch_helper::write(msg->writer(), bbs);
+
+    rpc::call(
+        b->target,
+        msg,
+        this,
+        std::bind(
+            &replication_app_client_base::on_batch_reply,
+            this,
+            std::placeholders::_1,
+            std::placeholders::_2,
+            std::placeholders::_3,
+            b
+            )
+        );
+}
+
+void replication_app_client_base::on_batch_reply(error_code err, message_ptr& request, message_ptr& response, batch_context_ptr b)
+{
+    // a batch rejected by the replica is replied with its error and no replies,
+    // and all its requests are then retried
+    std::vector<blob> bbs;
+    if (err == ERR_OK)
+    {
+        if (!client_batch_helper::read_reply(response->reader(), err, bbs))
+        {
+            derror("invalid batch reply for %d requests", static_cast<int>(b->requests.size()));
+            err = ERR_INVALID_DATA;
+        }
+        else if (err != ERR_OK)
+        {
+            dwarn("batch of %d requests is rejected by the replica, err = %s", static_cast<int>(b->requests.size()), err.to_string());
+        }
+        else if (bbs.size() != b->requests.size())
+        {
+            derror("batch reply has %d replies for %d requests", static_cast<int>(bbs.size()), static_cast<int>(b->requests.size()));
+            err = ERR_INVALID_DATA;
+        }
+    }
+
+    message_ptr nil(nullptr);
+    for (size_t i = 0; i < b->requests.size(); i++)
+    {
+        auto& rc = b->requests[i];
+        auto& req = rc->callback_task->get_request();
+        if (err != ERR_OK)
+        {
+            replica_rw_reply(err, req, nil, rc);
+            continue;
+        }
+
+        auto& bb = bbs[i];
+
+        // no reply as the request was dropped by the replica
+        if (bb.length() == 0)
+        {
+            replica_rw_reply(ERR_TIMEOUT, req, nil, rc);
+        }
+        else
+        {
+            message_ptr resp(new message(bb, false));
+            replica_rw_reply(ERR_OK, req, resp, rc);
+        }
+    }
+}
+
 end_point replication_app_client_base::get_read_address(read_semantic_t semantic, const partition_configuration& config)
 {
-    if (semantic == read_semantic_t::ReadLastUpdate)
+    if (semantic == read_semantic_t::ReadLastUpdate && !_lease_reads_enabled)
         return config.primary;
 
-    // readsnapshot or readoutdated, using random
+    // readsnapshot, readoutdated or lease reads, using random
     else
     {
         bool has_primary = false;
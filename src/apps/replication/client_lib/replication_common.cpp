@@ -38,14 +38,26 @@ replication_options::replication_options()
     preapre_list_max_size_mb = 250;
     prepare_ack_on_secondary_before_logging_allowed = false;
 
+    request_batch_disabled = false;
+    mutation_max_request_count = 64;
+    mutation_max_size_mb = 15;
+    mutation_max_pending_time_ms = 0;
+
+    learn_log_streaming_disabled = false;
+    learn_mutation_max_size_mb = 4;
+
     group_check_internal_ms = 100000;
     group_check_disabled = false;
+    read_lease_ms = 0;
     gc_interval_ms = 30 * 1000; // 30000 milliseconds
     gc_disabled = false;
     gc_memory_replica_interval_ms = 5 * 60 * 1000; // 5 minutes
     gc_disk_error_replica_interval_seconds = 48 * 3600 * 1000; // 48 hrs
     log_batch_write = true;
     log_max_concurrent_writes = 4;
+    log_durable_write = true;
+    log_shard_count = 1;
+    log_compression = "none";
     fd_disabled = false;
     //_options.meta_servers = ...;
     fd_check_interval_seconds = 5;
@@ -58,7 +70,12 @@ replication_options::replication_options()
     log_pending_max_ms = 100;
     log_file_size_mb = 32;
     
+    meta_checkpoint_interval_ms = 300000;
+    meta_log_batch_window_ms = 0;
+    meta_log_durable_write = true;
+
     config_sync_interval_ms = 30000;
+    config_sync_full_interval_ms = 300000;
     config_sync_disabled = false;
 }
 
@@ -94,6 +111,15 @@ void replication_options::initialize(configuration_ptr config)
     prepare_ack_on_secondary_before_logging_allowed =
         config->get_value<bool>("replication", "prepare_ack_on_secondary_before_logging_allowed", prepare_ack_on_secondary_before_logging_allowed);
 
+    request_batch_disabled =
+        config->get_value<bool>("replication", "request_batch_disabled", request_batch_disabled);
+    mutation_max_request_count =
+        config->get_value<uint32_t>("replication", "mutation_max_request_count", mutation_max_request_count);
+    mutation_max_size_mb =
+        config->get_value<uint32_t>("replication", "mutation_max_size_mb", mutation_max_size_mb);
+    mutation_max_pending_time_ms =
+        config->get_value<uint32_t>("replication", "mutation_max_pending_time_ms", mutation_max_pending_time_ms);
+
     staleness_for_commit =
         config->get_value<uint32_t>("replication", "staleness_for_commit", staleness_for_commit);
     staleness_for_start_prepare_for_potential_secondary =
@@ -102,10 +128,16 @@ void replication_options::initialize(configuration_ptr config)
         config->get_value<uint32_t>("replication", "mutation_2pc_min_replica_count", mutation_2pc_min_replica_count);
     preapre_list_max_size_mb =
         config->get_value<uint32_t>("replication", "preapre_list_max_size_mb", preapre_list_max_size_mb);
+    learn_log_streaming_disabled =
+        config->get_value<bool>("replication", "learn_log_streaming_disabled", learn_log_streaming_disabled);
+    learn_mutation_max_size_mb =
+        config->get_value<uint32_t>("replication", "learn_mutation_max_size_mb", learn_mutation_max_size_mb);
     group_check_internal_ms =
         config->get_value<uint32_t>("replication", "group_check_internal_ms", group_check_internal_ms);
     group_check_disabled =
         config->get_value<bool>("replication", "group_check_disabled", group_check_disabled);
+    read_lease_ms =
+        config->get_value<uint32_t>("replication", "read_lease_ms", read_lease_ms);
     gc_interval_ms =
         config->get_value<uint32_t>("replication", "gc_interval_ms", gc_interval_ms);
     gc_memory_replica_interval_ms =
@@ -138,12 +170,27 @@ void replication_options::initialize(configuration_ptr config)
         config->get_value<bool>("replication", "log_batch_write", log_batch_write);
     log_max_concurrent_writes =
         config->get_value<uint32_t>("replication", "log_max_concurrent_writes", log_max_concurrent_writes);
+    log_durable_write =
+        config->get_value<bool>("replication", "log_durable_write", log_durable_write);
+    log_shard_count =
+        config->get_value<uint32_t>("replication", "log_shard_count", log_shard_count);
+    log_compression =
+        config->get_string_value("replication", "log_compression", log_compression.c_str());
 
      config_sync_disabled =
         config->get_value<bool>("replication", "config_sync_disabled", config_sync_disabled);
     //_options.meta_servers = ...;
     config_sync_interval_ms =
         config->get_value<uint32_t>("replication", "config_sync_interval_ms", config_sync_interval_ms);
+    meta_checkpoint_interval_ms =
+        config->get_value<uint32_t>("replication", "meta_checkpoint_interval_ms", meta_checkpoint_interval_ms);
+    meta_log_batch_window_ms =
+        config->get_value<uint32_t>("replication", "meta_log_batch_window_ms", meta_log_batch_window_ms);
+    meta_log_durable_write =
+        config->get_value<bool>("replication", "meta_log_durable_write", meta_log_durable_write);
+
+    config_sync_full_interval_ms =
+        config->get_value<uint32_t>("replication", "config_sync_full_interval_ms", config_sync_full_interval_ms);
         
     read_meta_servers(config);
 
@@ -153,6 +200,7 @@ void replication_options::initialize(configuration_ptr config)
 void replication_options::sanity_check()
 {
     dassert (staleness_for_start_prepare_for_potential_secondary >= staleness_for_commit, "");
+    dassert (log_compression == "none" || log_compression == "lz4", "unknown log_compression %s", log_compression.c_str());
 }
    
 /*static*/ bool replica_helper::remove_node(const end_point& node, __inout_param std::vector<end_point>& nodeList)
@@ -169,6 +217,62 @@ void replication_options::sanity_check()
     }
 }
 
+/*static*/ void client_batch_helper::write(binary_writer& writer, const std::vector<blob>& msgs)
+{
+    writer.write(static_cast<int>(msgs.size()));
+    for (auto& bb : msgs)
+    {
+        writer.write(bb);
+    }
+}
+
+/*static*/ bool client_batch_helper::read(binary_reader& reader, __out_param std::vector<blob>& msgs)
+{
+    int count = 0;
+    if (0 == reader.read(count))
+        return false;
+
+    // each message takes at least its length
+    if (count <= 0 || count > CLIENT_BATCH_MAX_COUNT
+        || count > reader.get_remaining_size() / static_cast<int>(sizeof(int)))
+    {
+        dwarn("invalid client batch count %d with %d bytes left", count, reader.get_remaining_size());
+        return false;
+    }
+
+    msgs.resize(count);
+    for (auto& bb : msgs)
+    {
+        if (0 == reader.read(bb))
+            return false;
+    }
+    return true;
+}
+
+/*static*/ void client_batch_helper::write_reply(binary_writer& writer, error_code err, const std::vector<blob>& replies)
+{
+    writer.write(err.get());
+    if (err == ERR_OK)
+    {
+        write(writer, replies);
+    }
+}
+
+/*static*/ bool client_batch_helper::read_reply(binary_reader& reader, __out_param error_code& err, __out_param std::vector<blob>& replies)
+{
+    int err2;
+    if (0 == reader.read(err2))
+        return false;
+
+    err.set(err2);
+    if (err != ERR_OK)
+    {
+        replies.clear();
+        return true;
+    }
+    return read(reader, replies);
+}
+
 /*static*/ bool replica_helper::get_replica_config(const partition_configuration& partition_config, const end_point& node, __out_param replica_configuration& replica_config)
 {
     replica_config.gpid = partition_config.gpid;
@@ -51,14 +51,24 @@ public:
     int32_t prepare_timeout_ms_for_potential_secondaries;
     int32_t preapre_list_max_size_mb;
     bool    prepare_ack_on_secondary_before_logging_allowed;
+
+    bool    request_batch_disabled;
+    int32_t mutation_max_request_count;
+    int32_t mutation_max_size_mb;
+    int32_t mutation_max_pending_time_ms;
         
     int32_t staleness_for_commit;
     int32_t staleness_for_start_prepare_for_potential_secondary;
     int32_t mutation_2pc_min_replica_count;
+
+    bool    learn_log_streaming_disabled;
+    int32_t learn_mutation_max_size_mb;
     
     bool    group_check_disabled;
     int32_t group_check_internal_ms;
 
+    int32_t read_lease_ms; // secondaries serve ReadLastUpdate reads within this long after hearing from the primary, 0 to disable
+
     int32_t gc_interval_ms;
     bool    gc_disabled;
     int32_t gc_memory_replica_interval_ms;
@@ -70,13 +80,21 @@ public:
     int32_t fd_lease_seconds;
     int32_t fd_grace_seconds;
 
+    int32_t meta_checkpoint_interval_ms; // 0 to checkpoint the meta server state on start only
+    int32_t meta_log_batch_window_ms; // 0 to only batch the updates arriving while the last log write is in flight
+    bool    meta_log_durable_write;
+
     int32_t log_file_size_mb;
     int32_t log_buffer_size_mb;
     int32_t log_pending_max_ms;
     bool    log_batch_write;
     int32_t log_max_concurrent_writes;
+    bool    log_durable_write;
+    int32_t log_shard_count;
+    std::string log_compression; // none, lz4
 
     int32_t config_sync_interval_ms;
+    int32_t config_sync_full_interval_ms; // 0 for full sync always
     bool    config_sync_disabled;
 
 public:
@@ -89,6 +107,26 @@ private:
     void sanity_check();
 };
 
+// a client batch is the request count followed by the request messages, and its reply
+// is an error code followed, when ERR_OK, by the same count and the replies without their
+// message headers, where an empty reply is for a request dropped by the replica so that
+// the client retries it
+#define CLIENT_BATCH_MAX_COUNT (4096)
+
+class client_batch_helper
+{
+public:
+    static void write(binary_writer& writer, const std::vector<blob>& msgs);
+    // false when the count is not in [1, CLIENT_BATCH_MAX_COUNT] or the body is short of it,
+    // as the batch comes from the network
+    static bool read(binary_reader& reader, __out_param std::vector<blob>& msgs);
+
+    // replies are only written when err is ERR_OK, i.e., when the batch is not rejected
+    static void write_reply(binary_writer& writer, error_code err, const std::vector<blob>& replies);
+    // false when the reply is malformed; replies is left empty when err is not ERR_OK
+    static bool read_reply(binary_reader& reader, __out_param error_code& err, __out_param std::vector<blob>& replies);
+};
+
 class replica_helper
 {
 public:
@@ -26,6 +26,7 @@
 #include "simple_kv.server.impl.h"
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 #include <boost/filesystem.hpp>
 
 # ifdef __TITLE__
@@ -41,22 +42,89 @@ namespace dsn {
                 : simple_kv_service(replica, cf)
             {
                 _test_file_learning = false;
+                _version_retention = cf->get_value<int>("simple_kv", "version_retention_decrees", 1000);
+                _base_decree = 0;
+                _pruned_decree = 0;
+            }
+
+            decree simple_kv_service_impl::min_readable_decree() const
+            {
+                decree d = last_committed_decree() - _version_retention;
+                d = std::max(d, _pruned_decree.load());
+                return std::max(d, _base_decree.load());
+            }
+
+            // under _lock, and d == invalid_decree for the latest version
+            const std::string* simple_kv_service_impl::get_version(const std::string& key, decree d) const
+            {
+                auto it = _store.find(key);
+                if (it == _store.end())
+                    return nullptr;
+
+                auto& versions = it->second;
+                for (auto vit = versions.rbegin(); vit != versions.rend(); ++vit)
+                {
+                    if (d == invalid_decree || vit->d <= d)
+                        return &vit->value;
+                }
+                return nullptr;
+            }
+
+            // under _lock, called by the updates of the mutation being committed
+            void simple_kv_service_impl::put_version(const std::string& key, const std::string& value)
+            {
+                decree d = last_committed_decree() + 1;
+                auto& versions = _store[key];
+
+                // several updates of a key in one (batched) mutation make one version
+                if (!versions.empty() && versions.back().d == d)
+                {
+                    versions.back().value = value;
+                    return;
+                }
+
+                kv_version v;
+                v.d = d;
+                v.value = value;
+                versions.push_back(std::move(v));
+
+                decree lower = d - _version_retention;
+                if (lower > _pruned_decree.load())
+                {
+                    _pruned_decree = lower;
+                }
+
+                size_t n = 0;
+                while (n + 1 < versions.size() && versions[n + 1].d <= lower)
+                    n++;
+                if (n > 0)
+                {
+                    versions.erase(versions.begin(), versions.begin() + n);
+                }
             }
 
             // RPC_SIMPLE_KV_READ
             void simple_kv_service_impl::on_read(const std::string& key, ::dsn::service::rpc_replier<std::string>& reply)
             {
                 zauto_lock l(_lock);
-                
-                auto it = _store.find(key);
-                if (it == _store.end())
+
+                // checked again under _lock as versions may be dropped by the commits
+                // since the replica checked the snapshot decree
+                if (read_decree() != invalid_decree && read_decree() < min_readable_decree())
+                {
+                    reject_read(ERR_VERSION_OUTDATED);
+                    return;
+                }
+
+                auto value = get_version(key, read_decree());
+                if (value == nullptr)
                 {
                     reply("");
                 }
                 else
                 {
-                    dinfo("read %s, decree = %lld\n", it->second.c_str(), last_committed_decree());
-                    reply(it->second);
+                    dinfo("read %s, decree = %lld\n", value->c_str(), read_decree() == invalid_decree ? last_committed_decree() : read_decree());
+                    reply(*value);
                 }
             }
 
@@ -64,8 +132,7 @@ namespace dsn {
             void simple_kv_service_impl::on_write(const kv_pair& pr, ::dsn::service::rpc_replier<int32_t>& reply)
             {
                 zauto_lock l(_lock);
-                _store[pr.key] = pr.value;
-                ++_last_committed_decree;
+                put_version(pr.key, pr.value);
 
                 dinfo("write %s, decree = %lld\n", pr.value.c_str(), last_committed_decree());
                 reply(0);
@@ -75,12 +142,11 @@ namespace dsn {
             void simple_kv_service_impl::on_append(const kv_pair& pr, ::dsn::service::rpc_replier<int32_t>& reply)
             {
                 zauto_lock l(_lock);
-                auto it = _store.find(pr.key);
-                if (it != _store.end())
-                    it->second.append(pr.value);
+                auto value = get_version(pr.key, invalid_decree);
+                if (value != nullptr)
+                    put_version(pr.key, *value + pr.value);
                 else
-                    _store[pr.key] = pr.value;
-                ++_last_committed_decree;
+                    put_version(pr.key, pr.value);
 
                 dinfo("append %s, decree = %lld\n", pr.value.c_str(), last_committed_decree());
                 reply(0);
@@ -93,6 +159,8 @@ namespace dsn {
                 {
                     boost::filesystem::remove_all(data_dir());
                     boost::filesystem::create_directory(data_dir());
+                    _base_decree = 0;
+                    _pruned_decree = 0;
                 }
                 else
                 {
@@ -173,10 +241,15 @@ namespace dsn {
 
                     is.read((char*)&value[0], sz);
 
-                    _store[key] = value;
+                    kv_version v;
+                    v.d = version;
+                    v.value = std::move(value);
+                    _store[key].push_back(std::move(v));
                 }
 
                 _last_durable_decree = _last_committed_decree = version;
+                _base_decree = version;
+                _pruned_decree = 0;
             }
 
             int simple_kv_service_impl::flush(bool force)
@@ -205,7 +278,7 @@ namespace dsn {
                     os.write((const char*)&sz, (uint32_t)sizeof(sz));
                     os.write((const char*)&k[0], sz);
 
-                    const std::string& v = it->second;
+                    const std::string& v = it->second.back().value;
                     sz = (uint32_t)v.length();
 
                     os.write((const char*)&sz, (uint32_t)sizeof(sz));
@@ -236,7 +309,7 @@ namespace dsn {
                 for (auto it = _store.begin(); it != _store.end(); it++)
                 {
                     writer.write(it->first);
-                    writer.write(it->second);
+                    writer.write(it->second.back().value);
                 }
 
                 auto bb = writer.get_buffer();
@@ -289,10 +362,16 @@ namespace dsn {
                     std::string key, value;
                     reader.read(key);
                     reader.read(value);
-                    _store[key] = value;
+
+                    kv_version v;
+                    v.d = decree;
+                    v.value = std::move(value);
+                    _store[key].push_back(std::move(v));
                 }
 
                 _last_committed_decree = decree;
+                _base_decree = decree;
+                _pruned_decree = 0;
                 _last_durable_decree = 0;
 
                 flush(true);
@@ -50,15 +50,31 @@ namespace dsn {
                 virtual int get_learn_state(decree start, const blob& learn_req, __out_param learn_state& state);
                 virtual int apply_learn_state(learn_state& state);
 
+                // snapshot reads
+                virtual decree min_readable_decree() const;
+
             private:
                 void recover();
                 void recover(const std::string& name, decree version);
+                void put_version(const std::string& key, const std::string& value);
+                const std::string* get_version(const std::string& key, decree d) const;
 
             private:
-                typedef std::map<std::string, std::string> simple_kv;
+                // versions of a key in decree order, where the ones out of the retention 
+                // window are dropped on the next update of the key, except the newest of
+                // them which still holds the value at the lower bound of the window
+                struct kv_version
+                {
+                    decree      d;
+                    std::string value;
+                };
+                typedef std::map<std::string, std::vector<kv_version> > simple_kv;
                 simple_kv _store;
                 zlock     _lock;
                 bool      _test_file_learning;
+                decree    _version_retention;         // how many recent decrees are readable
+                std::atomic<decree> _base_decree;     // decree of the recovered or learned state, no versions below
+                std::atomic<decree> _pruned_decree;   // versions needed by reads below it may have been dropped
             };
 
         }
@@ -30,7 +30,7 @@ namespace dsn { namespace replication {
 
 mutation::mutation()
 {
-    rpc_code = 0;
+    _update_bytes = 0;
     _private0 = 0; 
     _not_logged = 1;
 }
@@ -40,34 +40,49 @@ mutation::~mutation()
     clear_log_task();
 }
 
-void mutation::set_client_request(task_code code, message_ptr& request)
+void mutation::add_client_request(task_code code, message_ptr& request)
 {
-    dassert(client_request == nullptr, "batch is not supported now");
-    client_request = request;
-    rpc_code = code;
+    dassert(_encoded_body.length() == 0, "mutation cannot be changed once it is encoded");
+    client_requests.push_back(request);
+    rpc_codes.push_back(code);
     data.updates.push_back(request->reader().get_remaining_buffer());
+    _update_bytes += data.updates.back().length();
 }
 
 /*static*/ mutation_ptr mutation::read_from(message_ptr& reader)
 {
     mutation_ptr mu(new mutation());
-    unmarshall(reader, mu->data);
-    unmarshall(reader, mu->rpc_code);
+    unmarshall(reader, mu->data.header);
+
+    // keep the received body so logging this mutation does not encode it again
+    blob body = reader->reader().get_remaining_buffer();
+    unmarshall(reader, mu->data.updates);
 
     // it is possible this is an emtpy mutation due to new primaries inserts empty mutations for holes
-    dassert(mu->data.updates.size() == 1 || mu->rpc_code == RPC_REPLICATION_WRITE_EMPTY, "batch is not supported now");
-    message_ptr msg;
-    if (mu->rpc_code != RPC_REPLICATION_WRITE_EMPTY)
+    int rpc_code;
+    unmarshall(reader, rpc_code);
+    if (rpc_code != RPC_REPLICATION_WRITE_EMPTY)
     {
-        msg.reset(new message(mu->data.updates[0], false));
+        dassert(mu->data.updates.size() > 0, "non-empty mutation must have updates");
+        mu->rpc_codes.resize(mu->data.updates.size());
+        mu->rpc_codes[0] = rpc_code;
+        for (size_t i = 1; i < mu->data.updates.size(); i++)
+        {
+            unmarshall(reader, mu->rpc_codes[i]);
+        }
     }
     else
     {
-        blob bb;
-        msg.reset(new message(bb, false));
+        dassert(mu->data.updates.size() == 0, "empty mutation must have no updates");
+    }
+
+    for (auto& update : mu->data.updates)
+    {
+        mu->client_requests.push_back(message_ptr(new message(update, false)));
+        mu->_update_bytes += update.length();
     }
 
-    mu->client_request = msg;
+    mu->_encoded_body = body.range(0, body.length() - reader->reader().get_remaining_size());
     mu->_from_message = reader;
     
     sprintf(mu->_name, "%lld.%lld",
@@ -79,8 +94,36 @@ void mutation::set_client_request(task_code code, message_ptr& request)
 
 void mutation::write_to(message_ptr& writer)
 {
-    marshall(writer, data);
-    marshall(writer, rpc_code);
+    write_to(writer->writer());
+}
+
+void mutation::write_to(binary_writer& writer)
+{
+    // the header differs among the prepare messages and the log (e.g., log_offset),
+    // while the body is encoded once and shared by all of them
+    marshall(writer, data.header);
+    writer.write_shared(encoded_body());
+}
+
+const blob& mutation::encoded_body()
+{
+    if (_encoded_body.length() == 0)
+    {
+        binary_writer writer(static_cast<int>(_update_bytes + sizeof(int) * 2 * (data.updates.size() + 1)));
+        marshall(writer, data.updates);
+
+        // the first code is compatible with single-update mutations,
+        // and the codes of the rest updates (if any) follow
+        int rpc_code = rpc_codes.empty() ? static_cast<int>(RPC_REPLICATION_WRITE_EMPTY) : rpc_codes[0];
+        marshall(writer, rpc_code);
+        for (size_t i = 1; i < rpc_codes.size(); i++)
+        {
+            marshall(writer, rpc_codes[i]);
+        }
+
+        _encoded_body = writer.get_buffer();
+    }
+    return _encoded_body;
 }
 
 int mutation::clear_prepare_or_commit_tasks()
@@ -55,7 +55,7 @@ public:
 
     // state change
     void set_id(ballot b, decree c);
-    void set_client_request(task_code code, message_ptr& request);
+    void add_client_request(task_code code, message_ptr& request);
     void set_logged() { dassert (!is_logged(), ""); _not_logged = 0; }
     unsigned int decrease_left_secondary_ack_count() { return --_left_secondary_ack_count; }
     unsigned int decrease_left_potential_secondary_ack_count() { return --_left_potential_secondary_ack_count; }
@@ -67,11 +67,20 @@ public:
     // reader & writer
     static mutation_ptr read_from(message_ptr& reader);
     void write_to(message_ptr& writer);
+    void write_to(binary_writer& writer);
 
-    // data
-    mutation_data  data;
-    int            rpc_code;
-    message_ptr    client_request;
+    // everything after the header, encoded on first use and immutable since then
+    const blob& encoded_body();
+
+    // data, where each update comes with its rpc code and a request message;
+    // the messages are always present (read_from builds them from the updates on
+    // non-primaries and for replayed mutations), while only those of the client
+    // requests received by the primary carry a non-zero from_address to reply to.
+    // Empty mutations have no updates at all
+    mutation_data             data;
+    std::vector<int>          rpc_codes;
+    std::vector<message_ptr>  client_requests;
+    uint32_t                  update_bytes() const { return _update_bytes; }
         
 private:
     union
@@ -94,6 +103,8 @@ private:
     task_ptr      _log_task;
 
     message_ptr   _from_message;
+    uint32_t      _update_bytes;
+    blob          _encoded_body; // updates and rpc codes, see encoded_body()
     char          _name[40]; // ballot.decree
 };
 
@@ -26,6 +26,8 @@
 
 #include "mutation_log.h"
 #include <boost/filesystem.hpp>
+#include <dsn/internal/perf_counters.h>
+#include <algorithm>
 #ifdef _WIN32
 #include <io.h>
 #endif
@@ -39,17 +41,26 @@ namespace dsn { namespace replication {
 
     using namespace ::dsn::service;
 
-mutation_log::mutation_log(uint32_t log_buffer_size_mb, uint32_t log_pending_max_ms, uint32_t max_log_file_mb, bool batch_write, int write_task_max_count)
+mutation_log::mutation_log(uint32_t log_buffer_size_mb, uint32_t log_pending_max_ms, uint32_t max_log_file_mb, bool batch_write, int write_task_max_count, bool durable_write, log_block_codec codec)
 {
     _log_buffer_size_bytes = log_buffer_size_mb * 1024 * 1024;
     _log_pending_max_milliseconds = log_pending_max_ms;    
     _max_log_file_size_in_bytes = ((int64_t)max_log_file_mb) * 1024L * 1024L;
     _batch_write = batch_write;
+    _durable_write = durable_write;
     _write_task_number = write_task_max_count;
+    _codec = codec;
+    if (_codec != LOG_BLOCK_CODEC_NONE)
+    {
+        _compression_ratio = utils::perf_counters::instance().get_counter("replica.log.compression_ratio(%)", COUNTER_TYPE_NUMBER_PERCENTILES, true);
+        _compression_time_ns = utils::perf_counters::instance().get_counter("replica.log.compression_time(ns)", COUNTER_TYPE_NUMBER_PERCENTILES, true);
+    }
 
     _last_file_number = 0;
     _global_start_offset = 0;
     _global_end_offset = 0;
+    _is_compressing = false;
+    _compressing_create_new_log = false;
 
     _last_log_file = nullptr;
     _current_log_file = nullptr;
@@ -103,6 +114,11 @@ error_code mutation_log::initialize(const char* dir)
         ++it)
     {
         std::string fullPath = it->path().string();
+
+        // decree index sidecars are loaded with their log files
+        if (it->path().extension() == ".index" || it->path().extension() == ".tmp")
+            continue;
+
         log_file_ptr log = log_file::opend_read(fullPath.c_str());
         if (log == nullptr)
         {
@@ -141,6 +157,7 @@ error_code mutation_log::create_new_log_file()
     if (_current_log_file != nullptr)
     {
         _last_log_file = _current_log_file;
+        _current_log_file->seal();
         dassert (_current_log_file->end_offset() == _global_end_offset, "");
     }
 
@@ -177,23 +194,35 @@ void mutation_log::create_new_pending_buffer()
     dassert (_pending_write_callbacks == nullptr, "");
     dassert (_pending_write_timer == nullptr, "");
 
-    _pending_write = message::create_request(RPC_PREPARE, _log_pending_max_milliseconds);
+    _pending_write = message::create_request(RPC_PREPARE, _log_pending_max_milliseconds, 0, LOG_WRITE_BUFFER_SIZE);
     _pending_write_callbacks.reset(new std::list<aio_task_ptr>);
 
     dassert (_pending_write->total_size() == MSG_HDR_SERIALIZED_SIZE, "");
+    _pending_write_offset = _global_end_offset;
     _global_end_offset += MSG_HDR_SERIALIZED_SIZE;
 }
 
 void mutation_log::internal_pending_write_timer(uint64_t id)
 {
-    zauto_lock l(_lock);
-    dassert (nullptr != _pending_write, "");
-    dassert (_pending_write->header().id == id, "");
-    dassert (task::get_current_task() == _pending_write_timer, "");
+    error_code err;
+    {
+        zauto_lock l(_lock);
+        dassert (nullptr != _pending_write, "");
+        dassert (_pending_write->header().id == id, "");
+        dassert (task::get_current_task() == _pending_write_timer, "");
 
-    _pending_write_timer = nullptr;
-    auto err = write_pending_mutations();
-    dassert(err == ERR_OK, "write_pending_mutations failed, err = %s", err.to_string());
+        _pending_write_timer = nullptr;
+        err = write_pending_mutations();
+    }
+
+    if (err == ERR_IO_PENDING)
+    {
+        write_compressing_block();
+    }
+    else
+    {
+        dassert(err == ERR_OK, "write_pending_mutations failed, err = %s", err.to_string());
+    }
 }
 
 error_code mutation_log::write_pending_mutations(bool create_new_log_when_necessary)
@@ -205,27 +234,88 @@ error_code mutation_log::write_pending_mutations(bool create_new_log_when_necess
 
     _pending_write->seal(true);
 
-    auto bb = _pending_write->writer().get_buffer();
-    uint64_t offset = end_offset() - bb.length();
-    auto buf = bb.buffer();
-    blob bb2(buf, bb.length());
+    // the block is compressed by the caller once _lock is released
+    if (_codec != LOG_BLOCK_CODEC_NONE)
+    {
+        dassert (!_is_compressing, "");
+        _is_compressing = true;
+        _compressing_create_new_log = create_new_log_when_necessary;
+        return ERR_IO_PENDING;
+    }
 
-    task_ptr aio = _current_log_file->write_log_entry(
-        bb2,
-        LPC_AIO_IMMEDIATE_CALLBACK,
-        this,
-        std::bind(
+    return write_sealed_block(create_new_log_when_necessary);
+}
+
+void mutation_log::write_compressing_block()
+{
+    while (true)
+    {
+        // _pending_write is left to this thread while _is_compressing,
+        // as appends are queued meanwhile
+        message_ptr block = compress_block(_pending_write);
+
+        zauto_lock l(_lock);
+        dassert (_is_compressing, "");
+        _is_compressing = false;
+
+        _pending_write = block;
+        _global_end_offset = _pending_write_offset + block->total_size();
+        auto err = write_sealed_block(_compressing_create_new_log);
+        if (err != ERR_OK)
+        {
+            derror("write compressed log block failed, err = %s", err.to_string());
+        }
+
+        // the queued appends go to the next block, which may fill up again
+        while (!_is_compressing && !_compressing_appends.empty())
+        {
+            auto mu = _compressing_appends.front().first;
+            auto tsk = _compressing_appends.front().second;
+            _compressing_appends.pop_front();
+            append_pending(mu, tsk);
+        }
+
+        if (!_is_compressing)
+            break;
+    }
+}
+
+error_code mutation_log::write_sealed_block(bool create_new_log_when_necessary)
+{
+    // write the buffer chain directly, which is kept alive until the write completes
+    std::shared_ptr<std::vector<blob>> buffers(new std::vector<blob>());
+    _pending_write->writer().get_buffers(*buffers);
+    uint64_t offset = end_offset() - _pending_write->total_size();
+
+    aio_handler callback = std::bind(
             &mutation_log::internal_write_callback, 
             std::placeholders::_1, 
             std::placeholders::_2, 
-            _pending_write_callbacks, bb2),
+            _pending_write_callbacks, buffers);
+
+    // the decree index of the file is saved only after its writes are done
+    log_file_ptr file = _current_log_file;
+    file->add_pending_write();
+    callback = [file, callback](error_code err, uint32_t size)
+    {
+        callback(err, size);
+        file->on_pending_write_done(err);
+    };
+
+    // acknowledge the appends only when they are durable
+    task_ptr aio = _current_log_file->write_log_entry(
+        *buffers,
+        LPC_AIO_IMMEDIATE_CALLBACK,
+        this,
+        callback,
         offset,
-        -1
+        -1,
+        _durable_write
         );    
     
     if (aio == nullptr)
     {
-        internal_write_callback(ERR_FILE_OPERATION_FAILED, 0, _pending_write_callbacks, bb2);
+        callback(ERR_FILE_OPERATION_FAILED, 0);
     }
     else
     {
@@ -254,7 +344,47 @@ error_code mutation_log::write_pending_mutations(bool create_new_log_when_necess
     return ERR_OK;
 }
 
-void mutation_log::internal_write_callback(error_code err, uint32_t size, mutation_log::pending_callbacks_ptr callbacks, blob data)
+message_ptr mutation_log::compress_block(message_ptr& raw_block)
+{
+    uint64_t start_ns = utils::get_current_physical_time_ns();
+
+    std::vector<blob> buffers;
+    raw_block->writer().get_buffers(buffers);
+    buffers[0] = buffers[0].range(MSG_HDR_SERIALIZED_SIZE);
+
+    int raw_size = raw_block->total_size() - MSG_HDR_SERIALIZED_SIZE;
+    std::shared_ptr<char> raw(new char[raw_size], std::default_delete<char[]>());
+    int pos = 0;
+    for (auto& bb : buffers)
+    {
+        memcpy(raw.get() + pos, bb.data(), bb.length());
+        pos += bb.length();
+    }
+    dassert (pos == raw_size, "");
+
+    int capacity = utils::lz4_compress_bound(raw_size);
+    std::shared_ptr<char> compressed(new char[capacity], std::default_delete<char[]>());
+    int size = utils::lz4_compress(raw.get(), raw_size, compressed.get(), capacity);
+    dassert (size > 0, "");
+
+    _compression_ratio->set(static_cast<uint64_t>(size) * 100 / (raw_size > 0 ? raw_size : 1));
+
+    // incompressible blocks are written as they are
+    message_ptr block = raw_block;
+    if (size + static_cast<int>(sizeof(raw_size)) < raw_size)
+    {
+        block = message::create_request(RPC_PREPARE, _log_pending_max_milliseconds, LOG_BLOCK_CODEC_LZ4);
+        block->header().id = raw_block->header().id;
+        block->writer().write(raw_size);
+        block->writer().write_shared(blob(compressed, 0, size));
+        block->seal(true);
+    }
+
+    _compression_time_ns->set(utils::get_current_physical_time_ns() - start_ns);
+    return block;
+}
+
+void mutation_log::internal_write_callback(error_code err, uint32_t size, mutation_log::pending_callbacks_ptr callbacks, std::shared_ptr<std::vector<blob>> buffers)
 {
     for (auto it = callbacks->begin(); it != callbacks->end(); it++)
     {
@@ -265,113 +395,455 @@ void mutation_log::internal_write_callback(error_code err, uint32_t size, mutati
 /*
 TODO: when there is a log error, the server cannot contain any primary or secondary any more!
 */
-error_code mutation_log::replay(ReplayCallback callback)
+error_code mutation_log::replay(ReplayCallback callback, const multi_partition_decrees& committed_decrees)
 {
-    zauto_lock l(_lock);
+    std::vector<log_file_ptr> logs;
+    int64_t offset;
+    {
+        zauto_lock l(_lock);
+        for (auto it = _log_files.begin(); it != _log_files.end(); it++)
+        {
+            logs.push_back(it->second);
+        }
+        offset = start_offset();
+    }
+
+    // the log files are decoded in parallel ahead of the one being replayed,
+    // while the callback still sees the mutations in log order; no lock is
+    // held here as both the decoding and the callback may wait for tasks
+    std::vector<decoded_log_file_ptr> results(logs.size());
+    std::vector<task_ptr> tasks(logs.size());
+    auto decode = [&](size_t i)
+    {
+        if (i < logs.size())
+        {
+            results[i].reset(new decoded_log_file());
+            tasks[i] = tasking::enqueue(
+                LPC_DECODE_LOG_FILE,
+                this,
+                std::bind(&mutation_log::decode_log_file, logs[i], logs[i]->replay_start_offset(committed_decrees), results[i])
+                );
+        }
+    };
 
-    int64_t offset = start_offset();
+    for (size_t i = 0; i < LOG_REPLAY_DECODE_AHEAD; i++)
+    {
+        decode(i);
+    }
+
+    log_file_ptr last_log_file;
     error_code err = ERR_OK;
-    for (auto it = _log_files.begin(); it != _log_files.end(); it++)
+    for (size_t i = 0; i < logs.size(); i++)
     {
-        log_file_ptr log = it->second;
+        decode(i + LOG_REPLAY_DECODE_AHEAD);
 
+        log_file_ptr log = logs[i];
         if (log->start_offset() != offset)
         {
             derror("offset mismatch in log file offset and global offset %lld vs %lld", log->start_offset(), offset);
-            return ERR_FILE_OPERATION_FAILED;
+            err = ERR_FILE_OPERATION_FAILED;
+            break;
         }
 
-        _last_log_file = log;
+        last_log_file = log;
 
-        ::dsn::blob bb;
-        err = log->read_next_log_entry(bb);
-        if (err != ERR_OK)
+        tasks[i]->wait();
+        tasks[i] = nullptr;
+        decoded_log_file_ptr result = results[i];
+        results[i] = nullptr;
+
+        for (auto& mu : result->mutations)
         {
-            if (err == ERR_HANDLE_EOF)
-            {
-                err = ERR_OK;
-                continue;
-            }
+            callback(mu);
+        }
 
-            derror(
-                "read log header failed for %s, err = %s", log->path().c_str(), err.to_string());
+        offset = result->end_offset;
+        err = result->err;
+        if (err == ERR_WRONG_CHECKSUM || err == ERR_FILE_OPERATION_FAILED)
             break;
-        }
 
+        // tail data corruption is checked by next file's offset checking
+        if (err != ERR_INVALID_DATA && err != ERR_OK)
+            break;        
+    }
 
-        message_ptr msg(new message(bb));
-        offset += MSG_HDR_SERIALIZED_SIZE;
+    for (auto& tsk : tasks)
+    {
+        if (tsk != nullptr) tsk->wait();
+    }
 
-        if (!msg->is_right_body())
+    zauto_lock l(_lock);
+    _last_log_file = last_log_file;
+
+    if (err == ERR_INVALID_DATA && offset + _last_log_file->header().log_buffer_size_bytes >= end_offset())
+    {
+        // remove bad data at tail, but still we may lose data so error code remains unchanged
+        _global_end_offset = offset;
+    }
+    else if (err == ERR_OK)
+    {
+        dassert (end_offset() == offset, "");
+    }
+
+    return err;
+}
+
+/*static*/ error_code mutation_log::replay_shards(
+    std::vector<mutation_log*>& shards,
+    ReplayCallback callback,
+    const multi_partition_decrees& committed_decrees
+    )
+{
+    // the last shard of each partition, told by the decree indexes without decoding the logs
+    std::unordered_map<global_partition_id, size_t> last_shards;
+    std::unordered_set<global_partition_id> spread_partitions;
+    if (shards.size() > 1)
+    {
+        for (size_t i = 0; i < shards.size(); i++)
         {
-            derror("data read crc check failed at offset %llu", offset);
-            return ERR_WRONG_CHECKSUM;
+            std::unordered_set<global_partition_id> gpids;
+            shards[i]->get_replay_partitions(committed_decrees, gpids);
+            for (auto& gpid : gpids)
+            {
+                auto r = last_shards.insert(std::make_pair(gpid, i));
+                if (!r.second)
+                {
+                    r.first->second = i;
+                    spread_partitions.insert(gpid);
+                }
+            }
         }
+    }
 
-        offset += log->read_header(msg);
+    // ballots only grow in a partition's log, so this is the order the mutations
+    // were logged in no matter which shard they went to
+    auto logged_before = [](const mutation_ptr& l, const mutation_ptr& r)
+    {
+        return l->data.header.ballot < r->data.header.ballot
+            || (l->data.header.ballot == r->data.header.ballot && l->data.header.decree < r->data.header.decree);
+    };
+
+    // a spread partition's mutations in its other shards are all that is held in memory,
+    // the rest are streamed to the callback in log order
+    std::unordered_map<global_partition_id, std::deque<mutation_ptr>> held;
+    auto release = [&](size_t shard)
+    {
+        for (auto it = held.begin(); it != held.end();)
+        {
+            if (last_shards[it->first] <= shard)
+            {
+                for (auto& mu : it->second)
+                {
+                    callback(mu);
+                }
+                it = held.erase(it);
+            }
+            else
+            {
+                it++;
+            }
+        }
+    };
 
-        while (true)
+    error_code err = ERR_OK;
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        for (auto& kv : held)
         {
-            while (!msg->reader().is_eof())
+            if (last_shards[kv.first] == i)
             {
-                auto oldSz = msg->reader().get_remaining_size();
-                mutation_ptr mu = mutation::read_from(msg);
-                dassert (nullptr != mu, "");                                
-                mu->set_logged();
+                std::stable_sort(kv.second.begin(), kv.second.end(), logged_before);
+            }
+        }
+
+        auto err2 = shards[i]->replay(
+            [&](mutation_ptr& mu)
+            {
+                auto& gpid = mu->data.header.gpid;
+                auto it = committed_decrees.find(gpid);
+                if (it == committed_decrees.end() || mu->data.header.decree <= it->second)
+                    return;
+
+                if (spread_partitions.find(gpid) == spread_partitions.end())
+                {
+                    callback(mu);
+                    return;
+                }
 
-                if (mu->data.header.log_offset != offset)
+                auto& mus = held[gpid];
+                if (last_shards[gpid] != i)
                 {
-                    derror("offset mismatch in log entry and mutation %lld vs %lld", offset, mu->data.header.log_offset);
-                    return ERR_FILE_OPERATION_FAILED;
+                    mus.push_back(mu);
+                    return;
                 }
 
+                while (!mus.empty() && logged_before(mus.front(), mu))
+                {
+                    callback(mus.front());
+                    mus.pop_front();
+                }
                 callback(mu);
+            },
+            committed_decrees
+            );
+        if (err == ERR_OK)
+        {
+            err = err2;
+        }
 
-                offset += oldSz - msg->reader().get_remaining_size();
+        release(i);
+    }
+
+    // e.g., a partition out of its last shard when the index is not right
+    for (auto& kv : held)
+    {
+        std::stable_sort(kv.second.begin(), kv.second.end(), logged_before);
+    }
+    release(shards.size());
+    return err;
+}
+
+void mutation_log::get_replay_partitions(
+    const multi_partition_decrees& committed_decrees,
+    __out_param std::unordered_set<global_partition_id>& gpids
+    )
+{
+    std::vector<log_file_ptr> logs;
+    {
+        zauto_lock l(_lock);
+        for (auto it = _log_files.begin(); it != _log_files.end(); it++)
+        {
+            logs.push_back(it->second);
+        }
+    }
+
+    std::vector<log_file_ptr> indexed(logs.size());
+    std::vector<task_ptr> tasks;
+    for (size_t i = 0; i < logs.size(); i++)
+    {
+        if (logs[i]->has_decree_index())
+        {
+            indexed[i] = logs[i];
+            continue;
+        }
+
+        auto& slot = indexed[i];
+        auto log = logs[i];
+        tasks.push_back(tasking::enqueue(
+            LPC_DECODE_LOG_FILE,
+            this,
+            [&slot, log]()
+            {
+                slot = index_log_file(log);
             }
+            ));
+    }
+
+    for (auto& tsk : tasks)
+    {
+        tsk->wait();
+    }
 
-            err = log->read_next_log_entry(bb);
-            if (err != ERR_OK)
+    for (size_t i = 0; i < logs.size(); i++)
+    {
+        // a file which cannot be read may hold any partition
+        if (indexed[i] == nullptr)
+        {
+            for (auto& kv : committed_decrees)
             {
-                if (err == ERR_HANDLE_EOF)
-                {
-                    err = ERR_OK;
-                    break;
-                }
+                gpids.insert(kv.first);
+            }
+            continue;
+        }
 
-                derror(
-                    "read log entry failed for %s, err = %s", log->path().c_str(), err.to_string());
-                break;
+        for (auto& kv : indexed[i]->get_decree_index())
+        {
+            auto it = committed_decrees.find(kv.first);
+            if (it != committed_decrees.end() && kv.second.max_decree > it->second)
+            {
+                gpids.insert(kv.first);
             }
-            
-            msg = new message(bb);
-            offset += MSG_HDR_SERIALIZED_SIZE;
+        }
+    }
+}
+
+/*static*/ log_file_ptr mutation_log::index_log_file(log_file_ptr log)
+{
+    log_file_ptr copy = log_file::opend_read(log->path().c_str());
+    if (copy == nullptr)
+        return nullptr;
+
+    decoded_log_file_ptr result(new decoded_log_file());
+    result->index_only = true;
+    decode_log_file(copy, copy->start_offset(), result);
+    copy->close();
+
+    // the index is saved when the file is fully decoded, so that the replay can use it
+    if (result->err == ERR_OK)
+    {
+        log->read_decree_index();
+    }
+    return copy;
+}
 
-            if (!msg->is_right_body())
+/*static*/ void mutation_log::decode_log_file(log_file_ptr log, int64_t replay_start_offset, decoded_log_file_ptr result)
+{
+    int64_t offset = log->start_offset();
+    int64_t block_offset = offset;
+    bool build_index = !log->has_decree_index();
+    result->end_offset = offset;
+
+    // the first block is always read for the file header
+    ::dsn::blob bb;
+    error_code err = log->read_next_log_entry(bb);
+    if (err != ERR_OK)
+    {
+        if (err == ERR_HANDLE_EOF)
+        {
+            err = ERR_OK;
+        }
+        else
+        {
+            derror(
+                "read log header failed for %s, err = %s", log->path().c_str(), err.to_string());
+        }
+        result->err = err;
+        return;
+    }
+
+    // a compressed block is shorter on disk than the offsets of its mutations
+    // (assigned at append) suggest, so the next block starts at block_end_offset
+    message_ptr msg;
+    err = open_log_block(bb, msg);
+    if (err != ERR_OK)
+    {
+        derror("open log block failed at offset %lld, err = %s", offset, err.to_string());
+        result->err = err;
+        return;
+    }
+    int64_t block_end_offset = offset + bb.length();
+    offset += MSG_HDR_SERIALIZED_SIZE;
+    offset += log->read_header(msg);
+
+    // skip the blocks holding committed mutations only
+    bool skip_block = false;
+    if (replay_start_offset > log->start_offset())
+    {
+        if (replay_start_offset >= log->end_offset())
+        {
+            log->close();
+            result->end_offset = log->end_offset();
+            result->err = ERR_OK;
+            return;
+        }
+
+        log->seek_for_read(replay_start_offset);
+        block_end_offset = replay_start_offset;
+        skip_block = true;
+    }
+
+    while (true)
+    {
+        while (!skip_block && !msg->reader().is_eof())
+        {
+            auto oldSz = msg->reader().get_remaining_size();
+            mutation_ptr mu = mutation::read_from(msg);
+            dassert (nullptr != mu, "");                                
+            mu->set_logged();
+
+            if (mu->data.header.log_offset != offset)
+            {
+                derror("offset mismatch in log entry and mutation %lld vs %lld", offset, mu->data.header.log_offset);
+                result->err = ERR_FILE_OPERATION_FAILED;
+                return;
+            }
+
+            if (build_index)
+            {
+                log->add_decree_index(mu->data.header.gpid, mu->data.header.decree, block_offset);
+            }
+
+            if (!result->index_only)
             {
-                derror("data read crc check failed at offset %llu", offset);
-                return ERR_WRONG_CHECKSUM;
+                result->mutations.push_back(mu);
             }
+
+            offset += oldSz - msg->reader().get_remaining_size();
         }
 
-        log->close();
+        skip_block = false;
+        result->end_offset = block_end_offset;
+        block_offset = block_end_offset;
 
-        // tail data corruption is checked by next file's offset checking
-        if (err != ERR_INVALID_DATA && err != ERR_OK)
-            break;        
+        err = log->read_next_log_entry(bb);
+        if (err != ERR_OK)
+        {
+            if (err == ERR_HANDLE_EOF)
+            {
+                err = ERR_OK;
+                break;
+            }
+
+            derror(
+                "read log entry failed for %s, err = %s", log->path().c_str(), err.to_string());
+            break;
+        }
+        
+        err = open_log_block(bb, msg);
+        if (err != ERR_OK)
+        {
+            derror("open log block failed at offset %lld, err = %s", block_offset, err.to_string());
+            result->err = err;
+            return;
+        }
+        block_end_offset = block_offset + bb.length();
+        offset = block_offset + MSG_HDR_SERIALIZED_SIZE;
     }
 
-    if (err == ERR_INVALID_DATA && offset + _last_log_file->header().log_buffer_size_bytes >= end_offset())
+    log->close();
+
+    // a fully decoded file gets its index saved, as it is never written again
+    if (build_index && err == ERR_OK)
     {
-        // remove bad data at tail, but still we may lose data so error code remains unchanged
-        _global_end_offset = offset;
+        log->write_decree_index();
     }
-    else if (err == ERR_OK)
+
+    result->err = err;
+}
+
+/*static*/ error_code mutation_log::open_log_block(const blob& bb, __out_param message_ptr& msg)
+{
+    msg = new message(bb);
+    if (!msg->is_right_body())
+        return ERR_WRONG_CHECKSUM;
+
+    int codec = msg->header().client.hash;
+    if (codec == LOG_BLOCK_CODEC_NONE)
+        return ERR_OK;
+
+    if (codec != LOG_BLOCK_CODEC_LZ4)
     {
-        dassert (end_offset() == offset, "");
+        derror("unknown log block codec %d", codec);
+        return ERR_INVALID_DATA;
+    }
+
+    int raw_size;
+    if (0 == msg->reader().read(raw_size) || raw_size < 0)
+        return ERR_INVALID_DATA;
+
+    // keep the header, and replace the body with the raw one
+    std::shared_ptr<char> buffer(new char[MSG_HDR_SERIALIZED_SIZE + raw_size], std::default_delete<char[]>());
+    memcpy(buffer.get(), bb.data(), MSG_HDR_SERIALIZED_SIZE);
+
+    blob compressed = msg->reader().get_remaining_buffer();
+    if (raw_size != utils::lz4_decompress(compressed.data(), compressed.length(), buffer.get() + MSG_HDR_SERIALIZED_SIZE, raw_size))
+    {
+        derror("decompress log block failed");
+        return ERR_INVALID_DATA;
     }
 
-    return err;
+    msg = new message(blob(buffer, 0, MSG_HDR_SERIALIZED_SIZE + raw_size));
+    return ERR_OK;
 }
 
 error_code mutation_log::start_write_service(multi_partition_decrees& initMaxDecrees, int max_staleness_for_commit)
@@ -387,33 +859,53 @@ error_code mutation_log::start_write_service(multi_partition_decrees& initMaxDec
 
 void mutation_log::close()
 {
+    log_file_ptr last_file;
     while (true)
     {
-        zauto_lock l(_lock);
-
-        if (nullptr != _pending_write_timer)
+        error_code err = ERR_OK;
         {
-            bool finish;
-            _pending_write_timer->cancel(false, &finish);
-            if (finish)
+            zauto_lock l(_lock);
+
+            // wait for the block being compressed by another thread
+            bool wait = _is_compressing;
+            if (!wait && nullptr != _pending_write_timer)
             {
-                _pending_write_timer = nullptr;
-                write_pending_mutations(false);
-                dassert (nullptr == _pending_write_timer, "");
+                bool finish;
+                _pending_write_timer->cancel(false, &finish);
+                if (finish)
+                {
+                    _pending_write_timer = nullptr;
+                    err = write_pending_mutations(false);
+                    dassert (nullptr == _pending_write_timer, "");
+                }
+                else
+                {
+                    wait = true;
+                }
             }
-            else
+
+            if (wait)
             {
                 std::this_thread::sleep_for(std::chrono::milliseconds(0));
                 continue;
             }
-        }
 
-        if (nullptr != _current_log_file)
-        {
-            _current_log_file->close();
-            _current_log_file = nullptr;
+            if (err != ERR_IO_PENDING)
+            {
+                last_file = _current_log_file;
+                _current_log_file = nullptr;
+                break;
+            }
         }
-        break;
+
+        write_compressing_block();
+    }
+
+    // closing waits for the in-flight writes, which must not be done with the lock held
+    if (nullptr != last_file)
+    {
+        last_file->close();
+        last_file->seal();
     }
 }
 
@@ -423,10 +915,36 @@ task_ptr mutation_log::append(mutation_ptr& mu,
                         aio_handler callback,
                         int hash)
 {
-    zauto_lock l(_lock);
+    aio_task_ptr tsk(new file::internal_use_only::service_aio_task(callback_code, callback_host, callback, hash));
+
+    // encoded here as queued appends are written by another thread
+    mu->encoded_body();
+
+    error_code err;
+    {
+        zauto_lock l(_lock);
+
+        dassert(nullptr != _current_log_file, "");
+
+        // the offset of the next block is known only after the current one is compressed
+        if (_is_compressing)
+        {
+            _compressing_appends.push_back(std::make_pair(mu, tsk));
+            return tsk;
+        }
+
+        err = append_pending(mu, tsk);
+    }
 
-    dassert(nullptr != _current_log_file, "");
+    if (err == ERR_IO_PENDING)
+    {
+        write_compressing_block();
+    }
+    return tsk;
+}
 
+error_code mutation_log::append_pending(mutation_ptr& mu, aio_task_ptr& tsk)
+{
     auto it = _init_prepared_decrees.find(mu->data.header.gpid);
     if (it != _init_prepared_decrees.end())
     {
@@ -445,18 +963,21 @@ task_ptr mutation_log::append(mutation_ptr& mu,
         create_new_pending_buffer();
     }
 
+    // the log offset goes to the log only, as the mutation may be shared with other threads now
     auto oldSz = _pending_write->total_size();
-    mu->data.header.log_offset = end_offset();
-    mu->write_to(_pending_write);
+    mutation_header header = mu->data.header;
+    header.log_offset = end_offset();
+    marshall(_pending_write->writer(), header);
+    _pending_write->writer().write_shared(mu->encoded_body());
+    _current_log_file->add_decree_index(mu->data.header.gpid, mu->data.header.decree, _pending_write_offset);
     _global_end_offset += _pending_write->total_size() - oldSz;
 
-    aio_task_ptr tsk(new file::internal_use_only::service_aio_task(callback_code, callback_host, callback, hash));
-    
     _pending_write_callbacks->push_back(tsk);
 
+    error_code err = ERR_OK;
     if (!_batch_write)
     {
-        write_pending_mutations();
+        err = write_pending_mutations();
     }
     else
     {
@@ -464,12 +985,12 @@ task_ptr mutation_log::append(mutation_ptr& mu,
         {
             if (nullptr == _pending_write_timer)
             {
-                write_pending_mutations();
+                err = write_pending_mutations();
             }   
             else if (_pending_write_timer->cancel(false))
             {
                 _pending_write_timer = nullptr;
-                write_pending_mutations();
+                err = write_pending_mutations();
             }
         }
 
@@ -485,7 +1006,7 @@ task_ptr mutation_log::append(mutation_ptr& mu,
         }
     }   
 
-    return tsk;
+    return err;
 }
 
 void mutation_log::on_partition_removed(global_partition_id gpid)
@@ -545,7 +1066,24 @@ int mutation_log::garbage_collection(multi_partition_decrees& durable_decrees)
     }
 
     if (itr != files.rend()) itr++;
-    
+
+    // the decree index knows exactly what each file holds, so a longer prefix
+    // of the files can be deleted when all its mutations are durable
+    int64_t gc_count = std::distance(itr, files.rend());
+    int64_t durable_count = 0;
+    for (auto it = files.begin(); it != files.end(); it++)
+    {
+        if (!it->second->has_decree_index() || !it->second->is_durable(durable_decrees))
+            break;
+        durable_count++;
+    }
+
+    if (durable_count > gc_count)
+    {
+        itr = files.rbegin();
+        std::advance(itr, files.size() - durable_count);
+    }
+
     int count = 0;
     for (; itr != files.rend(); itr++)
     {
@@ -554,6 +1092,7 @@ int mutation_log::garbage_collection(multi_partition_decrees& durable_decrees)
         ddebug("remove log segment %s", itr->second->path().c_str());
 
         boost::filesystem::remove(itr->second->path().c_str());
+        boost::filesystem::remove((itr->second->path() + ".index").c_str());
 
         count++;
 
@@ -584,6 +1123,7 @@ std::map<int, log_file_ptr>& mutation_log::get_logfiles_for_test()
     if (name.length() < strlen("log.")
         || name.substr(0, strlen("log.")) != std::string("log.")
         || (name.length() > strlen(".removed") && name.substr(name.length() - strlen(".removed")) == std::string(".removed"))
+        || (name.length() > strlen(".index") && name.substr(name.length() - strlen(".index")) == std::string(".index"))
         )
     {
         dwarn( "Invalid log path %s", path);
@@ -610,7 +1150,9 @@ std::map<int, log_file_ptr>& mutation_log::get_logfiles_for_test()
     int index = atoi(name.substr(pos + 1, pos2 - pos - 1).c_str());
     int64_t startOffset = atol(name.substr(pos2 + 1).c_str());
     
-    return new log_file(path, hFile, index, startOffset, 0, true);
+    log_file_ptr log = new log_file(path, hFile, index, startOffset, 0, true);
+    log->read_decree_index();
+    return log;
 }
 
 /*static*/ log_file_ptr log_file::create_write(const char* dir, int index, int64_t startOffset, int max_staleness_for_commit, int write_task_max_count)
@@ -640,6 +1182,10 @@ log_file::log_file(const char* path, handle_t handle, int index, int64_t startOf
     _header.max_staleness_for_commit = max_staleness_for_commit;
     _write_task_itr = 0;    
     _write_tasks.resize(write_task_max_count);
+    _is_syncing = false;
+    _has_decree_index = !isRead; // read files get it from the sidecar or replay
+    _unfinished_writes = 1;
+    _write_failed = false;
 
     if (isRead)
     {
@@ -659,6 +1205,24 @@ void log_file::close()
         }
     }
 
+    // wait for the in-flight group commits
+    while (true)
+    {
+        aio_task_ptr tsk;
+        {
+            zauto_lock l(_sync_lock);
+            if (!_is_syncing)
+                break;
+            tsk = _sync_task;
+        }
+
+        // a write linked to its barrier has no sync task
+        if (tsk != nullptr)
+            tsk->wait();
+        else
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
     if (0 != _handle)
     {
         if (_is_read)
@@ -668,21 +1232,47 @@ void log_file::close()
 
         _handle = 0;
     }
+
+    _read_buffer = blob();
+}
+
+int log_file::read_ahead(int size)
+{
+    if (_read_buffer.length() >= size)
+        return _read_buffer.length();
+
+    // move the leftover to the head of a new block, and fill the rest from the file
+    int block_size = size > LOG_READ_BLOCK_SIZE ? size : LOG_READ_BLOCK_SIZE;
+    std::shared_ptr<char> block(new char[block_size], std::default_delete<char[]>());
+
+    int len = _read_buffer.length();
+    if (len > 0)
+    {
+        memcpy(block.get(), _read_buffer.data(), len);
+    }
+
+    while (len < block_size)
+    {
+        int read_count = ::read(
+            (int)(_handle),
+            (void*)(block.get() + len),
+            block_size - len
+            );
+        if (read_count <= 0)
+            break;
+        len += read_count;
+    }
+
+    _read_buffer.assign(block, 0, len);
+    return len;
 }
 
 error_code log_file::read_next_log_entry(__out_param::dsn::blob& bb)
 {
     dassert (_is_read, "");
 
-    std::shared_ptr<char> hdrBuffer(new char[MSG_HDR_SERIALIZED_SIZE]);
-    
-    int read_count = ::read(
-        (int)(_handle),
-        hdrBuffer.get(),
-        MSG_HDR_SERIALIZED_SIZE
-        );
-
-    if (MSG_HDR_SERIALIZED_SIZE != read_count)
+    int read_count = read_ahead(MSG_HDR_SERIALIZED_SIZE);
+    if (MSG_HDR_SERIALIZED_SIZE > read_count)
     {
         if (read_count > 0)
         {
@@ -696,61 +1286,113 @@ error_code log_file::read_next_log_entry(__out_param::dsn::blob& bb)
     }
 
     message_header hdr;
-    ::dsn::blob bb2(hdrBuffer, MSG_HDR_SERIALIZED_SIZE);
+    ::dsn::blob bb2 = _read_buffer.range(0, MSG_HDR_SERIALIZED_SIZE);
     ::dsn::binary_reader reader(bb2);
     hdr.unmarshall(reader);
 
-    if (!hdr.is_right_header((char*)hdrBuffer.get()))
+    if (!hdr.is_right_header((char*)bb2.data()))
     {
         derror("invalid data header");
         return ERR_INVALID_DATA;
     }
 
-    std::shared_ptr<char> data(new char[MSG_HDR_SERIALIZED_SIZE + hdr.body_length]);
-    memcpy(data.get(), hdrBuffer.get(), MSG_HDR_SERIALIZED_SIZE);
-    bb.assign(data, 0, MSG_HDR_SERIALIZED_SIZE + hdr.body_length);
-
-    read_count = ::read(
-        (int)(_handle),
-        (void*)((char*)bb.data() + MSG_HDR_SERIALIZED_SIZE),
-        hdr.body_length
-        );
-
-    if (hdr.body_length != read_count)
+    // entries are handed out as ranges of the read-ahead block without copying
+    int entry_size = MSG_HDR_SERIALIZED_SIZE + hdr.body_length;
+    read_count = read_ahead(entry_size);
+    if (entry_size > read_count)
     {
-        derror("incomplete read data, size = %d vs %d", read_count, MSG_HDR_SERIALIZED_SIZE);
+        derror("incomplete read data, size = %d vs %d", read_count, entry_size);
         return ERR_INVALID_DATA;
     }
-    
+
+    bb = _read_buffer.range(0, entry_size);
+    _read_buffer = _read_buffer.range(entry_size);
     return ERR_OK;
 }
 
 aio_task_ptr log_file::write_log_entry(
-                blob& bb,
+                const std::vector<blob>& buffers,
                 task_code evt,  // to indicate which thread pool to execute the callback
                 servicelet* callback_host,
                 aio_handler callback,
                 int64_t offset,
-                int hash
+                int hash,
+                bool durable /*= false*/
                 )
 {
     dassert (!_is_read, "");
     dassert (offset == end_offset(), "");
 
-    auto task = file::write(
-        _handle, 
-        bb.data(),
-        bb.length(),
-        offset - start_offset(), 
-        evt, 
-        callback_host,
-        callback, 
-        hash
-        );
+    // link the write to a barrier of its own when there is none in flight to
+    // wait for, otherwise join the group commit once the write is done
+    bool linked = false;
+    if (durable)
+    {
+        zauto_lock l(_sync_lock);
+        if (!_is_syncing)
+        {
+            _is_syncing = true;
+            linked = true;
+        }
+    }
+
+    if (linked)
+    {
+        callback = std::bind(
+            &log_file::on_synced_write_completed,
+            log_file_ptr(this),
+            std::placeholders::_1,
+            std::placeholders::_2,
+            callback_host,
+            callback,
+            hash);
+    }
+    else if (durable)
+    {
+        callback = std::bind(
+            &log_file::commit_write,
+            log_file_ptr(this),
+            std::placeholders::_1,
+            std::placeholders::_2,
+            callback_host,
+            callback,
+            hash);
+    }
+
+    std::vector<file_buffer> fbs(buffers.size());
+    uint32_t size = 0;
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        fbs[i].buffer = (void*)buffers[i].data();
+        fbs[i].size = buffers[i].length();
+        size += buffers[i].length();
+    }
+
+    auto task = linked ?
+        file::write_vector_and_sync(
+            _handle,
+            &fbs[0],
+            static_cast<int>(fbs.size()),
+            offset - start_offset(),
+            evt,
+            callback_host,
+            callback,
+            hash
+            ) :
+        file::write_vector(
+            _handle, 
+            &fbs[0],
+            static_cast<int>(fbs.size()),
+            offset - start_offset(), 
+            evt, 
+            callback_host,
+            callback, 
+            hash
+            );
     
-    _end_offset = offset + bb.length();
+    _end_offset = offset + size;
 
-    //printf ("WriteBB: size = %u, startoffset = %llu, endOffset = %llu\n", bb.length(), offset, _end_offset);
+    //printf ("WriteBB: size = %u, startoffset = %llu, endOffset = %llu\n", size, offset, _end_offset);
         
     // !!! dangerous, we are in the middle of a local lock
     // we already have flow control on maximum on-the-fly prepare requests, so flow control here can be disabled
@@ -765,6 +1407,371 @@ aio_task_ptr log_file::write_log_entry(
     return task;
 }
 
+void log_file::commit_write(error_code err, uint32_t size, servicelet* callback_host, aio_handler callback, int hash)
+{
+    if (err != ERR_OK)
+    {
+        callback(err, size);
+        return;
+    }
+
+    zauto_lock l(_sync_lock);
+    pending_sync ps;
+    ps.callback = std::move(callback);
+    ps.size = size;
+    _sync_pending.push_back(std::move(ps));
+
+    // the in-flight barrier will start the next one on completion
+    if (!_is_syncing)
+    {
+        _is_syncing = true;
+        start_sync(callback_host, hash);
+    }
+}
+
+void log_file::start_sync(servicelet* callback_host, int hash)
+{
+    // under _sync_lock
+    pending_syncs_ptr syncs(new std::vector<pending_sync>());
+    syncs->swap(_sync_pending);
+
+    _sync_task = file::sync(
+        _handle,
+        LPC_AIO_IMMEDIATE_CALLBACK,
+        callback_host,
+        std::bind(
+            &log_file::on_sync_completed,
+            log_file_ptr(this),
+            std::placeholders::_1,
+            callback_host,
+            hash,
+            syncs),
+        hash
+        );
+}
+
+void log_file::on_sync_completed(error_code err, servicelet* callback_host, int hash, pending_syncs_ptr syncs)
+{
+    if (err != ERR_OK)
+    {
+        derror("sync log file %s failed, err = %s", _path.c_str(), err.to_string());
+    }
+
+    for (auto& ps : *syncs)
+    {
+        ps.callback(err, ps.size);
+    }
+
+    end_sync(callback_host, hash);
+}
+
+void log_file::on_synced_write_completed(error_code err, uint32_t size, servicelet* callback_host, aio_handler callback, int hash)
+{
+    if (err != ERR_OK)
+    {
+        derror("write and sync log file %s failed, err = %s", _path.c_str(), err.to_string());
+    }
+
+    callback(err, size);
+
+    end_sync(callback_host, hash);
+}
+
+void log_file::end_sync(servicelet* callback_host, int hash)
+{
+    // the writes completed meanwhile are not necessarily covered by the
+    // barrier just done, so they need another one
+    zauto_lock l(_sync_lock);
+    if (_sync_pending.empty())
+    {
+        _is_syncing = false;
+        _sync_task = nullptr;
+    }
+    else
+    {
+        start_sync(callback_host, hash);
+    }
+}
+
+void log_file::seek_for_read(int64_t offset)
+{
+    dassert (_is_read, "");
+    dassert (offset >= _start_offset && offset <= _end_offset, "");
+
+    ::lseek((int)(_handle), offset - _start_offset, SEEK_SET);
+    _read_buffer = blob();
+}
+
+void log_file::add_decree_index(global_partition_id gpid, decree d, int64_t block_offset)
+{
+    auto it = _decree_index.find(gpid);
+    if (it == _decree_index.end())
+    {
+        partition_decree_index& pi = _decree_index[gpid];
+        pi.min_decree = d;
+        pi.max_decree = d;
+        pi.points.push_back(decree_index_point{ block_offset, d });
+        return;
+    }
+
+    partition_decree_index& pi = it->second;
+    if (d < pi.min_decree) pi.min_decree = d;
+    if (d > pi.max_decree) pi.max_decree = d;
+
+    // one point per block, as blocks are the unit of read
+    auto& last = pi.points.back();
+    if (last.offset == block_offset)
+    {
+        if (d > last.max_decree) last.max_decree = d;
+    }
+    else
+    {
+        pi.points.push_back(decree_index_point{ block_offset, d });
+    }
+}
+
+void log_file::on_pending_write_done(error_code err)
+{
+    if (err != ERR_OK)
+    {
+        _write_failed = true;
+    }
+
+    if (--_unfinished_writes == 0)
+    {
+        write_decree_index();
+    }
+}
+
+void log_file::seal()
+{
+    if (--_unfinished_writes == 0)
+    {
+        write_decree_index();
+    }
+}
+
+bool log_file::write_decree_index()
+{
+    if (_write_failed)
+    {
+        dwarn("skip the decree index of %s as its writes failed", _path.c_str());
+        return false;
+    }
+
+    // sealed as a log block is, so that its crc guards it against corruption
+    message_ptr msg = message::create_request(RPC_PREPARE, 0, LOG_BLOCK_CODEC_NONE);
+    binary_writer& writer = msg->writer();
+    writer.write(LOG_DECREE_INDEX_MAGIC);
+    writer.write(_end_offset);
+    writer.write(static_cast<int>(_decree_index.size()));
+    for (auto& kv : _decree_index)
+    {
+        writer.write_pod(kv.first);
+        writer.write(kv.second.min_decree);
+        writer.write(kv.second.max_decree);
+        writer.write(static_cast<int>(kv.second.points.size()));
+        for (auto& pt : kv.second.points)
+        {
+            writer.write(pt.offset);
+            writer.write(pt.max_decree);
+        }
+    }
+    msg->seal(true);
+
+    // written aside and renamed so that a partial index is never seen
+    std::string path = _path + ".index";
+    std::string tmp_path = path + ".tmp";
+    FILE* fp = ::fopen(tmp_path.c_str(), "wb+");
+    if (fp == nullptr)
+    {
+        dwarn("create decree index %s failed", tmp_path.c_str());
+        return false;
+    }
+
+    std::vector<blob> bbs;
+    writer.get_buffers(bbs);
+
+    bool ok = true;
+    for (auto& bb : bbs)
+    {
+        if (1 != ::fwrite((const void*)bb.data(), bb.length(), 1, fp))
+        {
+            ok = false;
+            break;
+        }
+    }
+    ::fclose(fp);
+
+    boost::system::error_code ec;
+    if (ok)
+    {
+        boost::filesystem::rename(tmp_path, path, ec);
+        ok = !ec;
+    }
+
+    if (!ok)
+    {
+        dwarn("write decree index %s failed", path.c_str());
+        boost::filesystem::remove(tmp_path, ec);
+        return false;
+    }
+
+    _has_decree_index = true;
+    return true;
+}
+
+bool log_file::read_decree_index()
+{
+    std::string path = _path + ".index";
+    boost::system::error_code ec;
+    if (!boost::filesystem::exists(path, ec))
+        return false;
+
+    auto len = boost::filesystem::file_size(path, ec);
+    if (ec)
+        return false;
+
+    std::shared_ptr<char> buffer(new char[len + 1], std::default_delete<char[]>());
+    FILE* fp = ::fopen(path.c_str(), "rb");
+    if (fp == nullptr)
+        return false;
+    auto read_count = ::fread((void*)buffer.get(), 1, len, fp);
+    ::fclose(fp);
+    if (read_count != len)
+        return false;
+
+    if (len < static_cast<uintmax_t>(MSG_HDR_SERIALIZED_SIZE)
+        || !message_header::is_right_header(buffer.get())
+        || message_header::get_body_length(buffer.get()) != static_cast<int>(len) - MSG_HDR_SERIALIZED_SIZE)
+    {
+        dwarn("invalid decree index header in %s", path.c_str());
+        return false;
+    }
+
+    blob bb(buffer, 0, static_cast<int>(len));
+    message_ptr msg = new message(bb);
+    if (!msg->is_right_body())
+    {
+        dwarn("invalid decree index checksum in %s", path.c_str());
+        return false;
+    }
+
+    binary_reader& reader = msg->reader();
+    decree_index index;
+    
+    int magic = 0, count = 0;
+    int64_t end_offset = 0;
+    if (0 == reader.read(magic) || magic != LOG_DECREE_INDEX_MAGIC 
+        || 0 == reader.read(end_offset) || 0 == reader.read(count))
+    {
+        dwarn("invalid decree index %s", path.c_str());
+        return false;
+    }
+
+    // e.g., the file lost its tail in a crash
+    if (end_offset != _end_offset)
+    {
+        dwarn("decree index %s is for end offset %lld while the file ends at %lld, ignore it",
+            path.c_str(), static_cast<long long int>(end_offset), static_cast<long long int>(_end_offset));
+        return false;
+    }
+
+    // counts are bounded by what is left to read so a corrupt one never allocates
+    const int partition_size = static_cast<int>(sizeof(global_partition_id) + 2 * sizeof(decree) + sizeof(int));
+    const int point_size = static_cast<int>(sizeof(int64_t) + sizeof(decree));
+    if (count < 0 || count > reader.get_remaining_size() / partition_size)
+    {
+        dwarn("invalid partition count %d in decree index %s", count, path.c_str());
+        return false;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        global_partition_id gpid;
+        partition_decree_index pi;
+        int point_count = 0;
+        if (0 == reader.read_pod(gpid)
+            || 0 == reader.read(pi.min_decree)
+            || 0 == reader.read(pi.max_decree)
+            || 0 == reader.read(point_count)
+            || pi.min_decree > pi.max_decree)
+        {
+            dwarn("invalid decree index %s", path.c_str());
+            return false;
+        }
+
+        if (point_count <= 0 || point_count > reader.get_remaining_size() / point_size)
+        {
+            dwarn("invalid point count %d in decree index %s", point_count, path.c_str());
+            return false;
+        }
+
+        pi.points.resize(point_count);
+        for (auto& pt : pi.points)
+        {
+            if (0 == reader.read(pt.offset) || 0 == reader.read(pt.max_decree))
+            {
+                dwarn("invalid decree index %s", path.c_str());
+                return false;
+            }
+
+            // a point out of the file would make replay skip mutations never applied
+            if (pt.offset < _start_offset || pt.offset >= _end_offset)
+            {
+                dwarn("decree index %s has offset %lld out of the file [%lld, %lld), ignore it",
+                    path.c_str(), static_cast<long long int>(pt.offset),
+                    static_cast<long long int>(_start_offset), static_cast<long long int>(_end_offset));
+                return false;
+            }
+        }
+
+        index[gpid] = std::move(pi);
+    }
+
+    _decree_index = std::move(index);
+    _has_decree_index = true;
+    return true;
+}
+
+int64_t log_file::replay_start_offset(const multi_partition_decrees& committed_decrees) const
+{
+    if (!_has_decree_index)
+        return _start_offset;
+
+    int64_t offset = _end_offset;
+    for (auto& kv : _decree_index)
+    {
+        auto it = committed_decrees.find(kv.first);
+        if (it == committed_decrees.end())
+            return _start_offset;
+
+        if (kv.second.max_decree <= it->second)
+            continue;
+
+        for (auto& pt : kv.second.points)
+        {
+            if (pt.max_decree > it->second)
+            {
+                if (pt.offset < offset) offset = pt.offset;
+                break;
+            }
+        }
+    }
+    return offset;
+}
+
+bool log_file::is_durable(const multi_partition_decrees& durable_decrees) const
+{
+    for (auto& kv : _decree_index)
+    {
+        auto it = durable_decrees.find(kv.first);
+        if (it != durable_decrees.end() && it->second < kv.second.max_decree)
+            return false;
+    }
+    return true;
+}
+
 int log_file::read_header(message_ptr& reader)
 {
     
@@ -27,17 +27,36 @@
 
 #include "replication_common.h"
 #include "mutation.h"
+#include <dsn/internal/perf_counter.h>
+#include <atomic>
+#include <deque>
+#include <unordered_set>
 
 namespace dsn { namespace replication {
 
 #define INVALID_FILENUMBER (0)
 #define MAX_LOG_FILESIZE (32)
+#define LOG_WRITE_BUFFER_SIZE (64 * 1024) // size of each buffer in the chain of a pending write
+#define LOG_READ_BLOCK_SIZE (4 * 1024 * 1024) // size of each read-ahead block during replay
+#define LOG_DECREE_INDEX_MAGIC 0x33646e69 // "ind3", the head of a decree index sidecar body
+#define LOG_REPLAY_DECODE_AHEAD (4) // max log files being decoded ahead of the one being replayed
 
 class log_file;
 typedef boost::intrusive_ptr<log_file> log_file_ptr;
 
 typedef std::unordered_map<global_partition_id, decree> multi_partition_decrees;
 
+//
+// codec of a log block body; as log blocks are never routed, it is recorded
+// in the client.hash slot of the block header, and a compressed body is
+// [int32 raw body length][compressed raw body]
+//
+enum log_block_codec
+{
+    LOG_BLOCK_CODEC_NONE = 0,
+    LOG_BLOCK_CODEC_LZ4 = 1
+};
+
 class mutation_log : public virtual servicelet
 {
 public:
@@ -53,7 +72,9 @@ public:
         uint32_t log_pending_max_ms, 
         uint32_t max_log_file_mb = (uint64_t) MAX_LOG_FILESIZE, 
         bool batch_write = true, 
-        int write_task_max_count = 2
+        int write_task_max_count = 2,
+        bool durable_write = true,
+        log_block_codec codec = LOG_BLOCK_CODEC_NONE
         );
     virtual ~mutation_log();
     
@@ -61,7 +82,26 @@ public:
     // initialization
     //
     error_code initialize(const char* dir);
-    error_code replay(ReplayCallback callback);
+    // mutations with decree <= committed_decrees[gpid] are not needed, so the log
+    // blocks (or whole files) holding only such mutations are skipped when the
+    // decree index tells so; partitions not in committed_decrees are fully replayed
+    error_code replay(ReplayCallback callback, const multi_partition_decrees& committed_decrees);
+    // replay the shards of a sharded log one by one, calling back with the mutations of
+    // the partitions in committed_decrees with decree > committed_decrees[gpid]; after the
+    // shard count changes a partition's older mutations may be in any shard, so those of a
+    // partition found in more than one shard are held until its last shard is replayed,
+    // and merged into it in (ballot, decree) order
+    static error_code replay_shards(
+        std::vector<mutation_log*>& shards,
+        ReplayCallback callback,
+        const multi_partition_decrees& committed_decrees
+        );
+    // the partitions in committed_decrees with mutations above it in this log, told by the
+    // decree indexes; the files without one (e.g., the last one before a crash) are indexed first
+    void get_replay_partitions(
+        const multi_partition_decrees& committed_decrees,
+        __out_param std::unordered_set<global_partition_id>& gpids
+        );
     void reset();
     error_code start_write_service(multi_partition_decrees& initMaxDecrees, int max_staleness_for_commit);
     void close();
@@ -98,11 +138,33 @@ private:
     //
     typedef std::shared_ptr<std::list<aio_task_ptr>> pending_callbacks_ptr;
 
+    struct decoded_log_file
+    {
+        error_code                err;
+        int64_t                   end_offset; // right after the last decoded entry
+        std::vector<mutation_ptr> mutations;
+        bool                      index_only; // build the decree index without keeping the mutations
+    };
+    typedef std::shared_ptr<decoded_log_file> decoded_log_file_ptr;
+
     error_code create_new_log_file();
     void create_new_pending_buffer();    
     void internal_pending_write_timer(uint64_t id);
-    static void internal_write_callback(error_code err, uint32_t size, pending_callbacks_ptr callbacks, blob data);
+    static void internal_write_callback(error_code err, uint32_t size, pending_callbacks_ptr callbacks, std::shared_ptr<std::vector<blob>> buffers);
+    // under _lock; ERR_IO_PENDING when the sealed block is to be compressed
+    // by the caller with write_compressing_block after _lock is released
     error_code write_pending_mutations(bool create_new_log_when_necessary = true);
+    error_code write_sealed_block(bool create_new_log_when_necessary);
+    void write_compressing_block();
+    error_code append_pending(mutation_ptr& mu, aio_task_ptr& tsk);
+    static void decode_log_file(log_file_ptr log, int64_t replay_start_offset, decoded_log_file_ptr result);
+    // builds the decree index of a log file without one through another handle of it,
+    // returned as the index is kept even when the file ends with torn data
+    static log_file_ptr index_log_file(log_file_ptr log);
+    // the compressed block of a sealed raw block, or the raw block when not smaller
+    message_ptr compress_block(message_ptr& raw_block);
+    // check and open a log block read from disk, decompressing its body if necessary
+    static error_code open_log_block(const blob& bb, __out_param message_ptr& msg);
 
 private:    
     
@@ -110,6 +172,10 @@ private:
     int64_t                   _max_log_file_size_in_bytes;            
     std::string               _dir;    
     bool                      _batch_write;
+    bool                      _durable_write; // ack appends only after fdatasync
+    log_block_codec           _codec;
+    perf_counter_ptr          _compression_ratio;   // compressed size * 100 / raw size of each block
+    perf_counter_ptr          _compression_time_ns; // cpu time to compress each block
 
     // write & read
     int                         _last_file_number;
@@ -128,8 +194,15 @@ private:
     uint32_t                    _log_pending_max_milliseconds;
     
     message_ptr                 _pending_write;
+    int64_t                     _pending_write_offset; // of the log block being buffered
     pending_callbacks_ptr       _pending_write_callbacks;
     task_ptr                    _pending_write_timer;
+
+    // compression of lz4 blocks is done outside _lock, and the offset of the next
+    // block is known only after that, so the appends meanwhile are queued
+    bool                        _is_compressing;
+    bool                        _compressing_create_new_log;
+    std::deque<std::pair<mutation_ptr, aio_task_ptr>> _compressing_appends;
     
     int                         _write_task_number;
 };
@@ -161,17 +234,35 @@ public:
     // read routines
     //
     error_code read_next_log_entry(__out_param::dsn::blob& bb);
+    // continue reading at the given global offset, which must be a log block start
+    void seek_for_read(int64_t offset);
 
     //
     // write routines
     //
     // return value: nullptr for error or immediate success (using ::GetLastError to get code), otherwise it is pending
     aio_task_ptr write_log_entry(
-                    blob& bb,
+                    const std::vector<blob>& buffers,
                     task_code evt,  // to indicate which thread pool to execute the callback
                     servicelet* callback_host,
                     aio_handler callback,
                     int64_t offset,
+                    int hash,
+                    bool durable = false // callback after the write is synced, see commit_write
+                    );
+
+    //
+    // group commit: the callback is invoked after a durable barrier (fdatasync)
+    // that covers the completed write of the given size; the writes completing
+    // while a barrier is in flight share the next barrier. A durable write issued
+    // when no barrier is in flight carries its own (file::write_vector_and_sync)
+    // instead, which saves a round trip with providers linking the two
+    //
+    void commit_write(
+                    error_code err,
+                    uint32_t size,
+                    servicelet* callback_host,
+                    aio_handler callback,
                     int hash
                     );
     
@@ -183,12 +274,67 @@ public:
     const multi_partition_decrees& init_prepare_decrees() { return _init_prepared_decrees; }
     const log_file_header& header() const { return _header;}
 
+    //
+    // sparse decree index, kept in memory for the file being written and saved
+    // as a sidecar (<path>.index) once the file is sealed (on rotation or close)
+    // and all its writes are done, or rebuilt when a file is replayed; the sidecar
+    // is sealed with a crc like a log block, records the file end offset, and is
+    // ignored (so the file is fully scanned) when it is corrupt or does not match
+    //
+    struct decree_index_point
+    {
+        int64_t offset;      // of the log block
+        decree  max_decree;  // of the partition in this block
+    };
+    struct partition_decree_index
+    {
+        decree min_decree;
+        decree max_decree;
+        std::vector<decree_index_point> points; // one per log block holding the partition
+    };
+    typedef std::unordered_map<global_partition_id, partition_decree_index> decree_index;
+
+    void add_decree_index(global_partition_id gpid, decree d, int64_t block_offset);
+    bool has_decree_index() const { return _has_decree_index; }
+    const decree_index& get_decree_index() const { return _decree_index; }
+    bool write_decree_index();
+    bool read_decree_index();
+
+    // tracks the writes of the file being written, so that its index is saved
+    // after the last write is done (durable with durable_write) and the file is sealed
+    void add_pending_write() { ++_unfinished_writes; }
+    void on_pending_write_done(error_code err);
+    void seal();
+
+    // offset of the first log block with mutations not covered by committed_decrees,
+    // or end_offset() when there is none; start_offset() without the index
+    int64_t replay_start_offset(const multi_partition_decrees& committed_decrees) const;
+    // mutations of the partitions in durable_decrees are all durable, and
+    // the rest are of removed partitions
+    bool is_durable(const multi_partition_decrees& durable_decrees) const;
+
     int read_header(message_ptr& msg);
     int write_header(message_ptr& msg, multi_partition_decrees& initMaxDecrees, int bufferSizeBytes);
     
 private:
     log_file(const char* path, handle_t handle, int index, int64_t startOffset, int max_staleness_for_commit, bool isRead, int write_task_max_count = 2);
 
+    // make sure at least size bytes are in _read_buffer unless the file ends,
+    // return the buffered size
+    int read_ahead(int size);
+
+    struct pending_sync
+    {
+        aio_handler callback;
+        uint32_t    size;
+    };
+    typedef std::shared_ptr<std::vector<pending_sync>> pending_syncs_ptr;
+
+    void start_sync(servicelet* callback_host, int hash);
+    void on_sync_completed(error_code err, servicelet* callback_host, int hash, pending_syncs_ptr syncs);
+    void on_synced_write_completed(error_code err, uint32_t size, servicelet* callback_host, aio_handler callback, int hash);
+    void end_sync(servicelet* callback_host, int hash);
+
 protected:        
     int64_t       _start_offset;
     int64_t       _end_offset;
@@ -198,10 +344,23 @@ protected:
     int           _index;
     std::vector<aio_task_ptr>  _write_tasks;
     int                        _write_task_itr;    
+    blob                       _read_buffer; // unconsumed data of the last read-ahead block
+
+    // group commit
+    zlock                      _sync_lock;
+    bool                       _is_syncing;     // a barrier, or a write linked to one, is in flight
+    std::vector<pending_sync>  _sync_pending; // completed writes waiting for the next barrier
+    aio_task_ptr               _sync_task;      // null for a write linked to the barrier
 
     // for gc
     multi_partition_decrees _init_prepared_decrees;    
     log_file_header         _header;
+
+    // decree index
+    bool                    _has_decree_index;
+    decree_index            _decree_index;
+    std::atomic<int>        _unfinished_writes; // pending writes, plus one until sealed
+    std::atomic<bool>       _write_failed;
 };
 
 DEFINE_REF_OBJECT(log_file)
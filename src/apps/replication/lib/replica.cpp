@@ -111,7 +111,17 @@ void replica::on_client_read(const read_request_header& meta, message_ptr& reque
 
     if (meta.semantic == read_semantic_t::ReadLastUpdate)
     {
-        if (status() != PS_PRIMARY || 
+        if (status() == PS_SECONDARY)
+        {
+            // served only with a valid read lease and the primary's commit point applied,
+            // so the read misses at most the updates committed within the last lease
+            if (!_secondary_states.check_read_lease(get_ballot(), _app->last_committed_decree(), now_ms()))
+            {
+                response_client_message(request, ERR_INVALID_STATE);
+                return;
+            }
+        }
+        else if (status() != PS_PRIMARY || 
             last_committed_decree() < _primary_states.last_prepare_decree_on_new_primary)
         {
             response_client_message(request, ERR_INVALID_STATE);
@@ -120,7 +130,26 @@ void replica::on_client_read(const read_request_header& meta, message_ptr& reque
     }
 
     dassert (_app != nullptr, "");
-    _app->dispatch_rpc_call(meta.code, request, true);
+
+    decree d = invalid_decree;
+    if (meta.semantic == read_semantic_t::ReadSnapshot)
+    {
+        // no version means the latest committed state of this replica
+        d = (meta.version_decree == invalid_decree ? _app->last_committed_decree() : meta.version_decree);
+        if (d > _app->last_committed_decree())
+        {
+            // not caught up yet, the client tries other replicas
+            response_client_message(request, ERR_INVALID_VERSION);
+            return;
+        }
+        else if (d < _app->min_readable_decree())
+        {
+            response_client_message(request, ERR_VERSION_OUTDATED);
+            return;
+        }
+    }
+
+    _app->dispatch_read(meta.code, request, d);
 }
 
 void replica::response_client_message(message_ptr& request, error_code error, decree d/* = invalid_decree*/)
@@ -154,13 +183,6 @@ void replica::execute_mutation(mutation_ptr& mu)
         {
         dassert (_app->last_committed_decree() + 1 == mu->data.header.decree, "");
         bool ack_client = (status() == PS_PRIMARY);
-        if (ack_client)
-        {
-            if (mu->client_request == nullptr)
-                ack_client = false;
-            else if (mu->client_request->header().from_address.ip == 0)
-                ack_client = false;
-        }
         err = _app->write_internal(mu, ack_client); 
         }
         break;
@@ -188,6 +210,22 @@ void replica::execute_mutation(mutation_ptr& mu)
     
     ddebug("TwoPhaseCommit, %s: mutation %s committed, err = %s", name(), mu->name(), err.to_string());
 
+    if (!_options.learn_log_streaming_disabled)
+    {
+        // a gap (e.g., the prepare list is reset on learning) restarts the history
+        if (!_committed_mutations.empty()
+            && _committed_mutations.back()->data.header.decree + 1 != mu->data.header.decree)
+        {
+            _committed_mutations.clear();
+        }
+
+        _committed_mutations.push_back(mu);
+        if (_committed_mutations.size() > static_cast<size_t>(_options.staleness_for_start_prepare_for_potential_secondary))
+        {
+            _committed_mutations.pop_front();
+        }
+    }
+
     if (err != ERR_OK)
     {
         handle_local_failure(err);
@@ -244,6 +282,7 @@ void replica::close()
     cleanup_preparing_mutations(true);
     _primary_states.cleanup();
     _potential_secondary_states.cleanup(true);
+    _committed_mutations.clear();
 
     if (_app != nullptr)
     {
@@ -37,6 +37,7 @@
 # include "mutation.h"
 # include "prepare_list.h"
 # include "replica_context.h"
+# include <deque>
 
 namespace dsn { namespace replication {
 
@@ -128,6 +129,8 @@ private:
     /////////////////////////////////////////////////////////////////
     // 2pc
     void init_prepare(mutation_ptr& mu);
+    void on_pending_mutation_timer();
+    void flush_pending_mutation();
     void send_prepare_message(const end_point& addr, partition_status status, mutation_ptr& mu, int timeout_milliseconds);
     void on_append_log_completed(mutation_ptr& mu, error_code err, uint32_t size);
     void on_prepare_reply(std::pair<mutation_ptr, partition_status> pr, error_code err, message_ptr& request, message_ptr& reply);
@@ -140,6 +143,8 @@ private:
     void init_learn(uint64_t signature);
     void on_learn_reply(error_code err, std::shared_ptr<learn_request>& req, std::shared_ptr<learn_response>& resp);
     void on_copy_remote_state_completed(error_code err, int size, std::shared_ptr<learn_response> resp);
+    bool get_learn_mutations(decree start, __out_param std::vector<blob>& mutations);
+    int  apply_learn_mutations(const std::vector<blob>& mutations);
     void on_learn_remote_state_completed(error_code err);
     void handle_learning_error(error_code err);
     void handle_learning_succeeded_on_primary(const end_point& node, uint64_t learnSignature);
@@ -175,6 +180,7 @@ private:
     
 private:
     friend class ::dsn::replication::replication_checker;
+    friend class replication_tester; // unit tests (src/tests)
 
     // replica configuration, updated by update_local_configuration ONLY    
     replica_configuration   _config;
@@ -183,6 +189,10 @@ private:
     // prepare list
     prepare_list*           _prepare_list;
 
+    // the latest committed mutations in decree order, at most the prepare list
+    // capacity, for learners slightly behind (as committed ones leave the list)
+    std::deque<mutation_ptr> _committed_mutations;
+
     // private log (if enabled)
     mutation_log*           _log;
 
@@ -197,6 +207,7 @@ private:
     
     // replica status specific states
     primary_context             _primary_states;
+    secondary_context           _secondary_states;
     potential_secondary_context _potential_secondary_states;
     bool                        _inactive_is_transient; // upgrade to P/S is allowed only iff true
 };
@@ -46,8 +46,72 @@ void replica::on_client_write(int code, message_ptr& request)
         return;
     }
 
-    mutation_ptr mu = new_mutation(_prepare_list->max_decree() + 1);
-    mu->set_client_request(code, request);
+    if (_options.request_batch_disabled || !_app->is_write_batch_allowed())
+    {
+        mutation_ptr mu = new_mutation(_prepare_list->max_decree() + 1);
+        mu->add_client_request(code, request);
+        init_prepare(mu);
+        return;
+    }
+
+    // batch the concurrent writes into the pending mutation, which is prepared
+    // at once when nothing is in flight, otherwise when it is full, when the
+    // in-flight mutations commit, or at the latest after the pending delay
+    auto& mu = _primary_states.pending_mutation;
+    if (mu == nullptr)
+    {
+        mu = new_mutation(invalid_decree);
+    }
+    mu->add_client_request(code, request);
+
+    if (_prepare_list->max_decree() == last_committed_decree()
+        || static_cast<int>(mu->data.updates.size()) >= _options.mutation_max_request_count
+        || mu->update_bytes() >= static_cast<uint32_t>(_options.mutation_max_size_mb) * 1024 * 1024)
+    {
+        flush_pending_mutation();
+    }
+    else if (_primary_states.pending_mutation_task == nullptr)
+    {
+        _primary_states.pending_mutation_task = tasking::enqueue(
+            LPC_MUTATION_PENDING_TIMER,
+            this,
+            &replica::on_pending_mutation_timer,
+            gpid_to_hash(get_gpid()),
+            _options.mutation_max_pending_time_ms
+            );
+    }
+}
+
+void replica::on_pending_mutation_timer()
+{
+    check_hashed_access();
+
+    _primary_states.pending_mutation_task = nullptr;
+    flush_pending_mutation();
+}
+
+void replica::flush_pending_mutation()
+{
+    if (_primary_states.pending_mutation_task != nullptr)
+    {
+        _primary_states.pending_mutation_task->cancel(false);
+        _primary_states.pending_mutation_task = nullptr;
+    }
+
+    mutation_ptr mu = _primary_states.pending_mutation;
+    _primary_states.pending_mutation = nullptr;
+    if (mu == nullptr)
+        return;
+
+    if (PS_PRIMARY != status())
+    {
+        for (auto& request : mu->client_requests)
+        {
+            response_client_message(request, ERR_INVALID_STATE);
+        }
+        return;
+    }
+
     init_prepare(mu);
 }
 
@@ -119,7 +183,7 @@ void replica::init_prepare(mutation_ptr& mu)
     // local log
     dassert (mu->data.header.log_offset == invalid_offset, "");
     dassert (mu->log_task() == nullptr, "");
-    mu->log_task() = _stub->_log->append(mu,
+    mu->log_task() = _stub->get_log(get_gpid())->append(mu,
         LPC_WRITE_REPLICATION_LOG,
         this,
         std::bind(&replica::on_append_log_completed, this, mu, 
@@ -132,7 +196,10 @@ void replica::init_prepare(mutation_ptr& mu)
     return;
 
 ErrOut:
-    response_client_message(mu->client_request, err);
+    for (auto& request : mu->client_requests)
+    {
+        response_client_message(request, err);
+    }
     return;
 }
 
@@ -176,6 +243,13 @@ void replica::do_possible_commit_on_primary(mutation_ptr& mu)
     if (mu->is_ready_for_commit(_options.prepare_ack_on_secondary_before_logging_allowed))
     {
         _prepare_list->commit(mu->data.header.decree, false);
+
+        // the writes batched while the prepares were in flight go out now
+        if (_primary_states.pending_mutation != nullptr
+            && _prepare_list->max_decree() == last_committed_decree())
+        {
+            flush_pending_mutation();
+        }
     }
 }
 
@@ -242,6 +316,11 @@ void replica::on_prepare(message_ptr& request)
     }
 
     dassert (rconfig.status == status(), "");    
+    if (PS_SECONDARY == status() && _options.read_lease_ms > 0)
+    {
+        _secondary_states.renew_read_lease(get_ballot(), mu->data.header.last_committed_decree, now_ms() + _options.read_lease_ms);
+    }
+
     if (decree <= last_committed_decree())
     {
         ack_prepare_message(ERR_OK, mu);
@@ -282,7 +361,7 @@ void replica::on_prepare(message_ptr& request)
     
     // write log
     dassert (mu->log_task() == nullptr, "");
-    mu->log_task() = _stub->_log->append(mu,
+    mu->log_task() = _stub->get_log(get_gpid())->append(mu,
         LPC_WRITE_REPLICATION_LOG,
         this,
         std::bind(&replica::on_append_log_completed, this, mu, std::placeholders::_1, std::placeholders::_2),
@@ -27,6 +27,7 @@
 #include "mutation.h"
 #include "mutation_log.h"
 #include "replica_stub.h"
+#include <algorithm>
 
 # ifdef __TITLE__
 # undef __TITLE__
@@ -40,6 +41,13 @@ void replica::init_group_check()
     if (PS_PRIMARY != status() || _options.group_check_disabled)
         return;
 
+    // group checks also renew the read leases of the secondaries when there are no writes
+    int interval_ms = _options.group_check_internal_ms;
+    if (_options.read_lease_ms > 0 && _options.read_lease_ms / 2 < interval_ms)
+    {
+        interval_ms = std::max(_options.read_lease_ms / 2, 1);
+    }
+
     dassert (nullptr == _primary_states.group_check_task, "");
     _primary_states.group_check_task = tasking::enqueue(
             LPC_GROUP_CHECK,
@@ -47,7 +55,7 @@ void replica::init_group_check()
             &replica::broadcast_group_check,
             gpid_to_hash(get_gpid()),
             0,
-            _options.group_check_internal_ms
+            interval_ms
             );
 }
 
@@ -131,6 +139,10 @@ void replica::on_group_check(const group_check_request& request, __out_param gro
     case PS_INACTIVE:
         break;
     case PS_SECONDARY:
+        if (_options.read_lease_ms > 0)
+        {
+            _secondary_states.renew_read_lease(get_ballot(), request.last_committed_decree, now_ms() + _options.read_lease_ms);
+        }
         if (request.last_committed_decree > last_committed_decree())
         {
             _prepare_list->commit(request.last_committed_decree, true);
@@ -522,6 +522,10 @@ bool replica::update_local_configuration(const replica_configuration& config, bo
     }
 
     uint64_t oldTs = _last_config_change_time_ms;
+    if (old_status != config.status || old_ballot != config.ballot)
+    {
+        _secondary_states.cleanup();
+    }
     _config = config;
     _last_config_change_time_ms =now_ms();
     dassert (max_prepared_decree() >= last_committed_decree(), "");
@@ -536,10 +540,10 @@ bool replica::update_local_configuration(const replica_configuration& config, bo
             replay_prepare_list();
             break;
         case PS_INACTIVE:
-            _primary_states.cleanup(old_ballot != config.ballot);
-            break;
         case PS_SECONDARY:
         case PS_ERROR:
+            // the batched writes are replied with ERR_INVALID_STATE so the clients retry
+            // them, as nothing flushes them once this replica is no longer the primary
             _primary_states.cleanup();
             break;
         case PS_POTENTIAL_SECONDARY:
@@ -726,15 +730,14 @@ void replica::replay_prepare_list()
 
         if (old != nullptr)
         {
-            mu->rpc_code = old->rpc_code;
+            mu->rpc_codes = old->rpc_codes;
             mu->data.updates = old->data.updates;
-            mu->client_request = old->client_request;
+            mu->client_requests = old->client_requests;
 
             dbg_dassert (mu->data.updates.size() == old->data.updates.size(), "");
         }
         else
         {
-            mu->rpc_code = RPC_REPLICATION_WRITE_EMPTY;
             ddebug(
                 "%s: emit empty mutation %s when replay prepare list",
                 name(),
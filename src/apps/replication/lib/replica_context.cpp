@@ -60,8 +60,18 @@ void primary_context::do_cleanup_pending_mutations(bool clean_pending_mutations)
         pending_mutation_task = nullptr;
     }
 
-    if (clean_pending_mutations)
+    if (clean_pending_mutations && pending_mutation != nullptr)
     {
+        // the batched writes are never prepared, tell the clients to retry
+        for (auto& request : pending_mutation->client_requests)
+        {
+            if (request == nullptr)
+                continue;
+
+            message_ptr resp = request->create_response();
+            resp->writer().write(ERR_INVALID_STATE);
+            rpc::reply(resp);
+        }
         pending_mutation = nullptr;
     }
 }
@@ -147,6 +157,37 @@ bool primary_context::check_exist(const end_point& node, partition_status st)
     }
 }
 
+void secondary_context::cleanup()
+{
+    read_lease_expire_ms = 0;
+    read_lease_ballot = invalid_ballot;
+    read_lease_commit_decree = invalid_decree;
+}
+
+void secondary_context::renew_read_lease(ballot b, decree primary_committed, uint64_t expire_ms)
+{
+    if (b != read_lease_ballot.load())
+    {
+        cleanup();
+        read_lease_ballot = b;
+    }
+
+    if (primary_committed > read_lease_commit_decree.load())
+        read_lease_commit_decree = primary_committed;
+    read_lease_expire_ms = expire_ms;
+}
+
+bool secondary_context::check_read_lease(ballot b, decree app_committed, uint64_t now) const
+{
+    uint64_t expire_ms = read_lease_expire_ms.load();
+    if (now >= expire_ms)
+        return false;
+
+    bool valid = (b == read_lease_ballot.load())
+        && app_committed >= read_lease_commit_decree.load();
+    return valid && expire_ms == read_lease_expire_ms.load();
+}
+
 bool potential_secondary_context::cleanup(bool force)
 {
     if (learn_remote_files_task != nullptr)
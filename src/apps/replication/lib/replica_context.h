@@ -26,6 +26,7 @@
 #pragma once
 
 #include "mutation.h"
+#include <atomic>
 
 namespace dsn { namespace replication {
 
@@ -74,6 +75,27 @@ public:
 };
 
 
+//
+// read lease of a secondary, renewed by each prepare or group check from the 
+// primary of the same ballot, which also carries the commit point of the primary;
+// renewed on the replication thread and checked by reads on other threads, so
+// the expiry is invalidated first and published last on changes, and a check
+// seeing it change in between fails
+//
+class secondary_context
+{
+public:
+    secondary_context() { cleanup(); }
+    void cleanup();
+    void renew_read_lease(ballot b, decree primary_committed, uint64_t expire_ms);
+    bool check_read_lease(ballot b, decree app_committed, uint64_t now) const;
+
+public:
+    std::atomic<ballot>   read_lease_ballot;
+    std::atomic<decree>   read_lease_commit_decree;
+    std::atomic<uint64_t> read_lease_expire_ms;
+};
+
 class potential_secondary_context 
 {
 public:
@@ -179,6 +179,21 @@ void replica::on_learn(const learn_request& request, __out_param learn_response&
     }
 
     decree decree = request.last_committed_decree_in_app + 1;
+
+    // a learner slightly behind gets the latest committed mutations kept by
+    // this replica, instead of the app state (e.g., checkpoint files)
+    if (!_options.learn_log_streaming_disabled && get_learn_mutations(decree, response.mutations))
+    {
+        ddebug(
+            "%s: on_learn %s:%d with %d mutations from decree %llu",
+            name(),
+            request.learner.name.c_str(), static_cast<int>(request.learner.port),
+            static_cast<int>(response.mutations.size()),
+            decree
+            );
+        return;
+    }
+
     int lerr = _app->get_learn_state(decree, request.app_specific_learn_request, response.state);
     if (lerr != 0)
     {
@@ -278,13 +293,15 @@ void replica::on_copy_remote_state_completed(error_code err2, int size, std::sha
          // the only place where there is non-in-partition-thread update  
         decree oldDecree = _app->last_committed_decree();
 
-        int err = _app->apply_learn_state(resp->state);
+        int err = resp->mutations.size() > 0 ?
+            apply_learn_mutations(resp->mutations) :
+            _app->apply_learn_state(resp->state);
 
         ddebug(
-                "%s: learning %d files to %s, err = %x, "
+                "%s: learning %d files and %d mutations to %s, err = %x, "
                 "appCommit(%llu => %llu), durable(%llu), remoteC(%llu), prepStart(%llu), state(%s)",
                 name(),
-                resp->state.files.size(), _dir.c_str(), err,
+                static_cast<int>(resp->state.files.size()), static_cast<int>(resp->mutations.size()), _dir.c_str(), err,
                 oldDecree, _app->last_committed_decree(),
                 _app->last_durable_decree(),                
                 resp->commit_decree,
@@ -326,6 +343,51 @@ void replica::on_copy_remote_state_completed(error_code err2, int size, std::sha
         );
 }
 
+bool replica::get_learn_mutations(decree start, __out_param std::vector<blob>& mutations)
+{
+    if (_committed_mutations.empty()
+        || start < _committed_mutations.front()->data.header.decree
+        || start > _committed_mutations.back()->data.header.decree)
+        return false;
+
+    // at most learn_mutation_max_size_mb per round, and the learner asks for the rest in the next rounds
+    uint64_t max_bytes = static_cast<uint64_t>(_options.learn_mutation_max_size_mb) * 1024 * 1024;
+    uint64_t bytes = 0;
+    auto it = _committed_mutations.begin() + static_cast<size_t>(start - _committed_mutations.front()->data.header.decree);
+    for (; it != _committed_mutations.end() && bytes < max_bytes; ++it)
+    {
+        binary_writer writer;
+        (*it)->write_to(writer);
+        mutations.push_back(writer.get_buffer());
+        bytes += mutations.back().length();
+    }
+    return !mutations.empty();
+}
+
+int replica::apply_learn_mutations(const std::vector<blob>& mutations)
+{
+    for (auto& bb : mutations)
+    {
+        message_ptr msg(new message(bb, false));
+        mutation_ptr mu = mutation::read_from(msg);
+
+        if (mu->data.header.decree <= _app->last_committed_decree())
+            continue;
+
+        if (mu->data.header.decree != _app->last_committed_decree() + 1)
+        {
+            derror("%s: learned mutation %s is not continuous with appCommit = %llu",
+                name(), mu->name(), _app->last_committed_decree());
+            return ERR_INVALID_DATA.get();
+        }
+
+        error_code err = _app->write_internal(mu, false);
+        if (err != ERR_OK)
+            return err.get();
+    }
+    return 0;
+}
+
 void replica::on_learn_remote_state_completed(error_code err)
 {
     check_hashed_access();
@@ -29,7 +29,10 @@
 #include "mutation.h"
 #include "replication_failure_detector.h"
 #include "rpc_replicated.h"
+#include <dsn/internal/perf_counters.h>
+#include <dsn/internal/network.h>
 #include <boost/filesystem.hpp>
+#include <sstream>
 
 # ifdef __TITLE__
 # undef __TITLE__
@@ -40,6 +43,15 @@ namespace dsn { namespace replication {
 
 using namespace dsn::service;
 
+// shard 0 is in 'log' as the unsharded log was, and shard i > 0 is in 'log.i'
+static std::string get_log_shard_dir(const std::string& dir, int shard)
+{
+    std::stringstream ss;
+    ss << dir << "/log";
+    if (shard > 0) ss << "." << shard;
+    return ss.str();
+}
+
 replica_stub::replica_stub(replica_state_subscriber subscriber /*= nullptr*/, bool is_long_subscriber/* = true*/)
     : serverlet("replica_stub")
 {
@@ -47,6 +59,10 @@ replica_stub::replica_stub(replica_state_subscriber subscriber /*= nullptr*/, bo
     _is_long_subscriber = is_long_subscriber;
     _failure_detector = nullptr;
     _state = NS_Disconnected;
+    _config_epoch = 0;
+    _config_version = 0;
+    _last_full_config_sync_ms = 0;
+    publish_replicas();
 }
 
 replica_stub::~replica_stub(void)
@@ -63,7 +79,9 @@ void replica_stub::initialize(configuration_ptr config, bool clear/* = false*/)
 
 void replica_stub::initialize(const replication_options& opts, configuration_ptr config, bool clear/* = false*/)
 {
-    zauto_lock l(_repicas_lock);
+    // no lock is held until the replicas are attached, as loading and replay wait
+    // for the tasks they fan out, and nothing else touches the stub before that
+    uint64_t start_time_ms = now_ms();
 
     _config = config;
 
@@ -81,28 +99,50 @@ void replica_stub::initialize(const replication_options& opts, configuration_ptr
     }
 
     _dir = boost::filesystem::canonical(boost::filesystem::path(_dir)).string();
-    std::string logDir = _dir + "/log";
-    if (!boost::filesystem::exists(logDir))
+    if (_options.log_shard_count < 1)
     {
-        boost::filesystem::create_directory(logDir);
+        _options.log_shard_count = 1;
     }
 
-    // init rps
+    // init rps, loaded in parallel
     boost::filesystem::directory_iterator endtr;
     replicas rps;
+    std::vector<std::string> names;
 
     for (boost::filesystem::directory_iterator it(dir());
         it != endtr;
         ++it)
     {
         auto name = it->path().string();
-        if (name.length() >= 4 &&
-            (name.substr(name.length() - strlen("log")) == "log" ||
-            name.substr(name.length() - strlen(".err")) == ".err")
+        auto fname = it->path().filename().string();
+        if (fname == "log" || fname.compare(0, strlen("log."), "log.") == 0 ||
+            (name.length() >= 4 && name.substr(name.length() - strlen(".err")) == ".err")
             )
             continue;
 
-        auto r = replica::load(this, name.c_str(), _options, true);
+        names.push_back(name);
+    }
+
+    std::vector<replica_ptr> loaded(names.size());
+    std::vector<task_ptr> load_tasks(names.size());
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        load_tasks[i] = tasking::enqueue(
+            LPC_LOAD_REPLICA,
+            this,
+            [this, &names, &loaded, i]()
+            {
+                loaded[i] = replica::load(this, names[i].c_str(), _options, true);
+            }
+            );
+    }
+
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        load_tasks[i]->wait();
+
+        auto& name = names[i];
+        auto& r = loaded[i];
         if (r != nullptr)
         {
             ddebug( "%u.%u @ %s:%d: load replica success with durable decree = %llu from '%s'",
@@ -115,14 +155,42 @@ void replica_stub::initialize(const replication_options& opts, configuration_ptr
         }
     }
 
-    // init logs
-    _log = new mutation_log(opts.log_buffer_size_mb, opts.log_pending_max_ms, opts.log_file_size_mb, opts.log_batch_write, opts.log_max_concurrent_writes);
-    error_code err = _log->initialize(logDir.c_str());
-    dassert (err == ERR_OK, "");
-    
-    err = _log->replay(
-        std::bind(&replica_stub::replay_mutation, this, std::placeholders::_1, &rps)
+    // init logs, including the shards left by a larger shard count before
+    int shard_count = _options.log_shard_count;
+    while (boost::filesystem::exists(get_log_shard_dir(_dir, shard_count)))
+    {
+        shard_count++;
+    }
+
+    error_code err = ERR_OK;
+    for (int i = 0; i < shard_count; i++)
+    {
+        auto log = new mutation_log(opts.log_buffer_size_mb, opts.log_pending_max_ms, opts.log_file_size_mb, opts.log_batch_write, opts.log_max_concurrent_writes, opts.log_durable_write,
+            opts.log_compression == "lz4" ? LOG_BLOCK_CODEC_LZ4 : LOG_BLOCK_CODEC_NONE);
+        auto err2 = log->initialize(get_log_shard_dir(_dir, i).c_str());
+        dassert (err2 == ERR_OK, "");
+        _logs.push_back(log);
+    }
+
+    // log blocks holding only committed mutations are skipped with the decree index,
+    // and the shards are replayed with replay_shards as a partition's older mutations
+    // may be in another shard (e.g., a leftover one) once the shard count changes
+    multi_partition_decrees committed_decrees;
+    for (auto it = rps.begin(); it != rps.end(); it++)
+    {
+        committed_decrees[it->first] = it->second->last_committed_decree();
+    }
+
+    replay_context ctx;
+    ctx.rps = &rps;
+    ctx.count = 0;
+    ctx.replayed_count = 0;
+    err = mutation_log::replay_shards(
+        _logs,
+        std::bind(&replica_stub::replay_mutation, this, std::placeholders::_1, &ctx),
+        committed_decrees
         );
+    flush_replay_batches(&ctx);
     
     for (auto it = rps.begin(); it != rps.end(); it++)
     {
@@ -141,7 +209,37 @@ void replica_stub::initialize(const replication_options& opts, configuration_ptr
         it->second->set_inactive_state_transient(err == ERR_OK);
     }
 
-    // start log serving    
+    std::vector<multi_partition_decrees> initMaxDecrees(_options.log_shard_count); // for log truncate
+    for (auto it = rps.begin(); it != rps.end(); it++)
+    {
+        int shard = static_cast<int>(static_cast<unsigned int>(gpid_to_hash(it->first)) % static_cast<unsigned int>(_options.log_shard_count));
+        initMaxDecrees[shard][it->second->get_gpid()] = it->second->max_prepared_decree();
+    }
+    for (int i = 0; i < _options.log_shard_count; i++)
+    {
+        err = _logs[i]->start_write_service(initMaxDecrees[i], _options.staleness_for_commit);
+        dassert (err == ERR_OK, "");
+    }
+
+    // attach rps
+    _lookup_latency_ns = utils::perf_counters::instance().get_counter("replica.stub.lookup_latency(ns)", COUNTER_TYPE_NUMBER_PERCENTILES, true);
+
+    zauto_lock l(_repicas_lock);
+    _replicas = rps;
+    publish_replicas();
+
+    rps.clear();
+
+    uint64_t startup_time_ms = now_ms() - start_time_ms;
+    ddebug("%s:%d: replica stub initialized with %d replicas and %d replayed mutations in %llu ms",
+        primary_address().name.c_str(), static_cast<int>(primary_address().port),
+        static_cast<int>(_replicas.size()),
+        ctx.replayed_count,
+        startup_time_ms
+        );
+    utils::perf_counters::instance().get_counter("replica.stub.startup_time(ms)", COUNTER_TYPE_NUMBER_PERCENTILES, true)->set(startup_time_ms);
+
+    // start log serving, not before the replicas are attached as gc must see their durable decrees
     if (false == _options.gc_disabled)
     {
         _gc_timer_task = tasking::enqueue(
@@ -154,19 +252,6 @@ void replica_stub::initialize(const replication_options& opts, configuration_ptr
             );
     }
 
-    multi_partition_decrees initMaxDecrees; // for log truncate
-    for (auto it = rps.begin(); it != rps.end(); it++)
-    {
-        initMaxDecrees[it->second->get_gpid()] = it->second->max_prepared_decree();
-    }
-    err = _log->start_write_service(initMaxDecrees, _options.staleness_for_commit);
-    dassert (err == ERR_OK, "");
-
-    // attach rps
-    _replicas = rps;
-
-    rps.clear();
-
     // start timer for configuration sync
     if (!_options.config_sync_disabled)
     {
@@ -201,35 +286,134 @@ void replica_stub::initialize(const replication_options& opts, configuration_ptr
     }
 }
 
-void replica_stub::replay_mutation(mutation_ptr& mu, replicas* rps)
+void replica_stub::replay_mutation(mutation_ptr& mu, replay_context* ctx)
+{
+    auto it = ctx->rps->find(mu->data.header.gpid);
+    if (it != ctx->rps->end())
+    {
+        auto& batch = ctx->batches[mu->data.header.gpid];
+        if (batch == nullptr)
+        {
+            batch.reset(new std::vector<mutation_ptr>());
+        }
+        batch->push_back(mu);
+
+        if (++ctx->count >= REPLAY_BATCH_MAX_COUNT)
+        {
+            flush_replay_batches(ctx);
+        }
+    }
+}
+
+void replica_stub::flush_replay_batches(replay_context* ctx)
+{
+    // each partition replays its batch on its own replica thread, and all of them
+    // are done before the next batch so every partition sees its mutations in log order
+    std::vector<task_ptr> tasks;
+    for (auto it = ctx->batches.begin(); it != ctx->batches.end(); it++)
+    {
+        replica_ptr r = (*ctx->rps)[it->first];
+        auto batch = it->second;
+        tasks.push_back(tasking::enqueue(
+            LPC_REPLAY_MUTATIONS,
+            this,
+            [r, batch]()
+            {
+                for (auto& mu : *batch)
+                {
+                    r->replay_mutation(mu);
+                }
+            },
+            gpid_to_hash(it->first)
+            ));
+    }
+
+    for (auto& tsk : tasks)
+    {
+        tsk->wait();
+    }
+
+    ctx->replayed_count += ctx->count;
+    ctx->count = 0;
+    ctx->batches.clear();
+}
+
+static inline uint32_t replica_slot_hash(global_partition_id gpid)
+{
+    return (static_cast<uint32_t>(gpid.app_id) * 2654435761u) ^ static_cast<uint32_t>(gpid.pidx);
+}
+
+void replica_stub::publish_replicas()
 {
-    auto it = rps->find(mu->data.header.gpid);
-    if (it != rps->end())
+    uint32_t sz = 16;
+    while (sz < _replicas.size() * 2)
+        sz *= 2;
+
+    std::unique_ptr<replica_table> tbl(new replica_table);
+    tbl->slots.resize(sz);
+    tbl->mask = sz - 1;
+    for (auto& kv : _replicas)
     {
-        it->second->replay_mutation(mu);
+        for (uint32_t i = replica_slot_hash(kv.first) & tbl->mask; ; i = (i + 1) & tbl->mask)
+        {
+            auto& slot = tbl->slots[i];
+            if (slot.rep == nullptr)
+            {
+                slot.gpid = kv.first;
+                slot.rep = kv.second;
+                break;
+            }
+        }
     }
+
+    std::atomic_store(&_replica_table, replica_table_ptr(tbl.release()));
 }
 
 replica_ptr replica_stub::get_replica(global_partition_id gpid, bool new_when_possible, const char* app_type)
 {
+    // sample one lookup in 64 per thread for the latency counter
+    static __thread uint32_t s_lookup_count = 0;
+    uint64_t start_ns = 0;
+    if ((++s_lookup_count & 63) == 0 && _lookup_latency_ns != nullptr)
+    {
+        start_ns = now_ns();
+    }
+
+    replica_ptr rep = nullptr;
+    auto tbl = std::atomic_load(&_replica_table);
+    for (uint32_t i = replica_slot_hash(gpid) & tbl->mask; ; i = (i + 1) & tbl->mask)
+    {
+        auto& slot = tbl->slots[i];
+        if (slot.rep == nullptr)
+            break;
+        else if (slot.gpid == gpid)
+        {
+            rep = slot.rep;
+            break;
+        }
+    }
+
+    if (start_ns != 0)
+    {
+        _lookup_latency_ns->set(now_ns() - start_ns);
+    }
+
+    if (rep != nullptr || !new_when_possible)
+        return rep;
+
     zauto_lock l(_repicas_lock);
     auto it = _replicas.find(gpid);
     if (it != _replicas.end())
         return it->second;
     else
     {
-        if (!new_when_possible)
-            return nullptr;
-        else
+        dassert (app_type, "");
+        replica* r = replica::newr(this, app_type, gpid, _options);
+        if (r != nullptr) 
         {
-            dassert (app_type, "");
-            replica* rep = replica::newr(this, app_type, gpid, _options);
-            if (rep != nullptr) 
-            {
-                add_replica(rep);
-            }
-            return rep;
+            add_replica(r);
         }
+        return r;
     }
 }
 
@@ -271,6 +455,106 @@ void replica_stub::on_client_write(message_ptr& request)
     }
 }
 
+//
+// collects the replies to the requests of a client batch, and replies them together
+// once all are collected; when the requests are all released before that (e.g., 
+// writes dropped by a reconfiguration), the missing replies are left empty so the
+// client retries those requests
+//
+class batch_reply_collector : public rpc_server_session
+{
+public:
+    batch_reply_collector(message_ptr& batch, rpc_server_session_ptr& session, int count)
+        : rpc_server_session(session->net(), session->remote_address()),
+        _batch(batch), _replies(count), _pending_count(count)
+    {
+    }
+
+    ~batch_reply_collector()
+    {
+        if (_batch != nullptr)
+        {
+            reply();
+        }
+    }
+
+    virtual void send(message_ptr& reply_msg)
+    {
+        uint64_t index = reply_msg->header().id;
+        dassert (index < _replies.size(), "invalid request index %llu in batch", index);
+
+        // without the message header
+        blob bb = reply_msg->writer().get_buffer();
+        zauto_lock l(_lock);
+        _replies[index] = bb.range(MSG_HDR_SERIALIZED_SIZE);
+        if (--_pending_count == 0)
+        {
+            reply();
+        }
+    }
+
+private:
+    void reply()
+    {
+        message_ptr resp = _batch->create_response();
+        client_batch_helper::write_reply(resp->writer(), ERR_OK, _replies);
+        rpc::reply(resp);
+        _batch = nullptr;
+    }
+
+private:
+    zlock              _lock;
+    message_ptr        _batch;
+    std::vector<blob>  _replies;
+    int                _pending_count;
+};
+
+void replica_stub::on_client_batch(message_ptr& request, bool is_read)
+{
+    // the replies go back through the session of the batch
+    auto session = request->server_session();
+    if (session == nullptr)
+    {
+        dwarn("client batch from %s:%d has no session to reply with, ignore it",
+            request->header().from_address.name.c_str(), static_cast<int>(request->header().from_address.port));
+        return;
+    }
+
+    std::vector<blob> bbs;
+    bool valid = client_batch_helper::read(request->reader(), bbs);
+    for (size_t i = 0; valid && i < bbs.size(); i++)
+    {
+        valid = (bbs[i].length() >= MSG_HDR_SERIALIZED_SIZE);
+    }
+    if (!valid)
+    {
+        derror("invalid client batch from %s:%d",
+            request->header().from_address.name.c_str(), static_cast<int>(request->header().from_address.port));
+        message_ptr resp = request->create_response();
+        client_batch_helper::write_reply(resp->writer(), ERR_INVALID_DATA, std::vector<blob>());
+        rpc::reply(resp);
+        return;
+    }
+
+    // each request is a whole client request message, dispatched as if received on its own
+    int count = static_cast<int>(bbs.size());
+    rpc_server_session_ptr collector(new batch_reply_collector(request, session, count));
+    for (int i = 0; i < count; i++)
+    {
+        message_ptr msg(new message(bbs[i]));
+        msg->header().id = static_cast<uint64_t>(i);
+        msg->header().from_address = request->header().from_address;
+        msg->header().to_address = request->header().to_address;
+        msg->header().local_rpc_code = (uint16_t)(is_read ? RPC_REPLICATION_CLIENT_READ : RPC_REPLICATION_CLIENT_WRITE);
+        msg->server_session() = collector;
+
+        if (is_read)
+            on_client_read(msg);
+        else
+            on_client_write(msg);
+    }
+}
+
 void replica_stub::on_client_read(message_ptr& request)
 {
     read_request_header req;
@@ -431,6 +715,7 @@ void replica_stub::on_remove(const replica_configuration& request)
 
 void replica_stub::query_configuration_by_node()
 {
+    zauto_lock l(_repicas_lock);
     if (_state == NS_Disconnected)
     {
         return;
@@ -449,6 +734,22 @@ void replica_stub::query_configuration_by_node()
 
     configuration_query_by_node_request req;
     req.node = primary_address();
+
+    // ask for the changes since the last sync only, except for a full sync
+    // every config_sync_full_interval_ms which corrects the replicas that
+    // have missed or failed to apply a configuration pushed earlier
+    if (_state == NS_Connected
+        && _options.config_sync_full_interval_ms > 0
+        && now_ms() < _last_full_config_sync_ms + static_cast<uint64_t>(_options.config_sync_full_interval_ms))
+    {
+        req.known_epoch = _config_epoch;
+        req.known_version = _config_version;
+    }
+    else
+    {
+        req.known_epoch = 0;
+        req.known_version = 0;
+    }
     marshall(msg, req);
 
     _config_query_task = rpc::call_replicated(
@@ -513,11 +814,23 @@ void replica_stub::on_node_query_reply(error_code err, message_ptr& request, mes
 
         if (resp.err != ERR_OK)
             return;
+
+        if (!resp.is_delta)
+        {
+            _meta_partitions.clear();
+            _last_full_config_sync_ms = now_ms();
+        }
+        _config_epoch = resp.epoch;
+        _config_version = resp.version;
+
+        for (auto& gpid : resp.removed_partitions)
+        {
+            _meta_partitions.erase(gpid);
+        }
         
-        replicas rs = _replicas;
         for (auto it = resp.partitions.begin(); it != resp.partitions.end(); it++)
         {
-            rs.erase(it->gpid);
+            _meta_partitions.insert(it->gpid);
             tasking::enqueue(
                 LPC_QUERY_NODE_CONFIGURATION_SCATTER,
                 this,
@@ -527,8 +840,11 @@ void replica_stub::on_node_query_reply(error_code err, message_ptr& request, mes
         }
 
         // for rps not exist on meta_servers
-        for (auto it = rs.begin(); it != rs.end(); it++)
+        for (auto it = _replicas.begin(); it != _replicas.end(); it++)
         {
+            if (_meta_partitions.find(it->first) != _meta_partitions.end())
+                continue;
+
             tasking::enqueue(
                 LPC_QUERY_NODE_CONFIGURATION_SCATTER,
                 this,
@@ -620,6 +936,12 @@ void replica_stub::remove_replica_on_meta_server(const partition_configuration&
 
     marshall(msg, *request);
 
+    // the removal is not acked, so do a full sync next time to retry it if needed
+    {
+        zauto_lock l(_repicas_lock);
+        _last_full_config_sync_ms = 0;
+    }
+
     rpc::call_replicated(
         _failure_detector->current_server_contact(),
         _failure_detector->get_servers(),
@@ -702,7 +1024,10 @@ void replica_stub::on_gc()
     {
         durable_decrees[it->first] = it->second->last_durable_decree();
     }
-    _log->garbage_collection(durable_decrees);
+    for (auto& log : _logs)
+    {
+        log->garbage_collection(durable_decrees);
+    }
     
     // gc on-disk rps
     boost::filesystem::directory_iterator endtr;
@@ -845,6 +1170,7 @@ void replica_stub::add_replica(replica_ptr r)
 {
     zauto_lock l(_repicas_lock);
     _replicas[r->get_gpid()] = r;
+    publish_replicas();
 }
 
 bool replica_stub::remove_replica(replica_ptr r)
@@ -852,6 +1178,7 @@ bool replica_stub::remove_replica(replica_ptr r)
     zauto_lock l(_repicas_lock);
     if (_replicas.erase(r->get_gpid()) > 0)
     {
+        publish_replicas();
         return true;
     }
     else
@@ -877,6 +1204,8 @@ void replica_stub::open_service()
 {
     register_rpc_handler(RPC_REPLICATION_CLIENT_WRITE, "write", &replica_stub::on_client_write);
     register_rpc_handler(RPC_REPLICATION_CLIENT_READ, "read", &replica_stub::on_client_read);
+    register_rpc_handler(RPC_REPLICATION_CLIENT_BATCH_WRITE, "batch_write", &replica_stub::on_client_batch_write);
+    register_rpc_handler(RPC_REPLICATION_CLIENT_BATCH_READ, "batch_read", &replica_stub::on_client_batch_read);
 
     register_rpc_handler(RPC_CONFIG_PROPOSAL, "ProposeConfig", &replica_stub::on_config_proposal);
 
@@ -939,6 +1268,7 @@ void replica_stub::close()
             _replicas.begin()->second->close();
             _replicas.erase(_replicas.begin());
         }
+        publish_replicas();
     }
         
     if (_failure_detector != nullptr)
@@ -948,12 +1278,12 @@ void replica_stub::close()
         _failure_detector = nullptr;
     }
 
-    if (_log != nullptr)
+    for (auto& log : _logs)
     {
-        _log->close();
-        delete _log;
-        _log = nullptr;
+        log->close();
+        delete log;
     }
+    _logs.clear();
 }
 
 }} // namespace
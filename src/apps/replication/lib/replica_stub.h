@@ -32,12 +32,17 @@
 //
 
 #include "replication_common.h"
+#include <dsn/internal/perf_counter.h>
+#include <atomic>
+#include <set>
 
 namespace dsn { namespace replication {
 
 class mutation_log;
 class replication_failure_detector;
 
+#define REPLAY_BATCH_MAX_COUNT (10000) // max mutations buffered before they are replayed in parallel
+
 // from, new replica config, isClosing
 typedef std::function<void (const end_point&, const replica_configuration&, bool)> replica_state_subscriber;
 
@@ -61,6 +66,8 @@ public:
     //
     void on_client_write(message_ptr& request);
     void on_client_read(message_ptr& request);
+    void on_client_batch_write(message_ptr& request) { on_client_batch(request, false); }
+    void on_client_batch_read(message_ptr& request) { on_client_batch(request, true); }
 
     //
     //    messages from meta server
@@ -128,10 +135,12 @@ private:
     void close_replica(replica_ptr r);
     void add_replica(replica_ptr r);
     bool remove_replica(replica_ptr r);
+    void publish_replicas(); // under _repicas_lock
     void notify_replica_state_update(const replica_configuration& config, bool isClosing);
 
 private:
     friend class ::dsn::replication::replication_checker;
+    friend class replication_tester; // unit tests (src/tests)
     typedef std::unordered_map<global_partition_id, replica_ptr> replicas;
     typedef std::unordered_map<global_partition_id, task_ptr> opening_replicas;
     typedef std::unordered_map<global_partition_id, std::pair<task_ptr, replica_ptr>> closing_replicas; // <close, replica>
@@ -140,8 +149,34 @@ private:
     replicas                    _replicas;
     opening_replicas            _opening_replicas;
     closing_replicas            _closing_replicas;
+
+    //
+    // immutable open-addressing snapshot of _replicas for lock-free get_replica on
+    // the request path, rebuilt and published whenever _replicas changes;
+    // readers hold a reference on the snapshot they look up in, so a replaced
+    // snapshot (and the replicas it refers to) is freed by its last reader
+    //
+    struct replica_slot
+    {
+        global_partition_id gpid;
+        replica_ptr         rep; // null for empty slot
+    };
+
+    struct replica_table
+    {
+        std::vector<replica_slot> slots; // size is power of 2
+        uint32_t                  mask;
+    };
+
+    typedef std::shared_ptr<const replica_table> replica_table_ptr;
+
+    replica_table_ptr            _replica_table; // accessed with std::atomic_load/store
+    perf_counter_ptr             _lookup_latency_ns; // sampled get_replica latency
     
-    mutation_log                *_log;
+    // log shards each with its own lock, buffer, timer and files, where the
+    // partitions are hashed onto the first log_shard_count shards, and the
+    // rest (left by a larger shard count before) are only replayed and gc-ed
+    std::vector<mutation_log*>  _logs;
     std::string                 _dir;
 
     replication_failure_detector *_failure_detector;
@@ -156,16 +191,38 @@ private:
     // temproal states
     task_ptr                    _config_query_task;
     task_ptr                    _config_sync_timer_task;
+
+    // config sync state (under _repicas_lock), where (epoch, version) is
+    // the meta server's config version this node has synced up to, and
+    // _meta_partitions are the partitions the meta server puts on this node
+    int64_t                     _config_epoch;
+    int64_t                     _config_version;
+    uint64_t                    _last_full_config_sync_ms;
+    std::set<global_partition_id> _meta_partitions;
     task_ptr                    _gc_timer_task;
 
 private:    
     friend class replica;
     void response_client_error(message_ptr& request, int error);
-    void replay_mutation(mutation_ptr& mu, replicas* rps);
+    void on_client_batch(message_ptr& request, bool is_read);
+    struct replay_context
+    {
+        replicas* rps;
+        std::unordered_map<global_partition_id, std::shared_ptr<std::vector<mutation_ptr>>> batches;
+        int       count;          // mutations in batches
+        int       replayed_count; // mutations in flushed batches
+    };
+    void replay_mutation(mutation_ptr& mu, replay_context* ctx);
+    void flush_replay_batches(replay_context* ctx);
+    mutation_log* get_log(global_partition_id gpid) const;
 };
 
 DEFINE_REF_OBJECT(replica_stub)
 
 //------------ inline impl ----------------------
+inline mutation_log* replica_stub::get_log(global_partition_id gpid) const
+{
+    return _logs[static_cast<unsigned int>(gpid_to_hash(gpid)) % static_cast<unsigned int>(_options.log_shard_count)];
+}
 
 }} // namespace
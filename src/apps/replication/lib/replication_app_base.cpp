@@ -36,6 +36,9 @@
 
 namespace dsn { namespace replication {
 
+static __thread decree s_read_decree = invalid_decree;
+static __thread int    s_read_error = 0; // set by reject_read
+
 void register_replica_provider(replica_app_factory f, const char* name)
 {
     ::dsn::utils::factory_store<replication_app_base>::register_factory(name, f, PROVIDER_TYPE_MAIN);
@@ -49,6 +52,8 @@ replication_app_base::replication_app_base(replica* replica, configuration_ptr&
 
     _replica = replica;
     _last_committed_decree = _last_durable_decree = 0;
+    _write_contract_checked = false;
+    _write_batch_allowed = false;
 
     if (!boost::filesystem::exists(_dir_data))
         boost::filesystem::create_directory(_dir_data);
@@ -60,21 +65,43 @@ replication_app_base::replication_app_base(replica* replica, configuration_ptr&
 error_code replication_app_base::write_internal(mutation_ptr& mu, bool ack_client)
 {
     dassert (mu->data.header.decree == last_committed_decree() + 1, "");
-    
-    if (mu->rpc_code != RPC_REPLICATION_WRITE_EMPTY)
+
+    decree last_decree = last_committed_decree();
+    if (mu->rpc_codes.size() > 0)
     {
-        auto& msg = mu->client_request;
-        dispatch_rpc_call(
-            mu->rpc_code,
-            msg,
-            ack_client
-            );
+        // updates in a batch are applied in order, each replied on its own
+        for (size_t i = 0; i < mu->rpc_codes.size(); i++)
+        {
+            auto& msg = mu->client_requests[i];
+            dispatch_rpc_call(
+                mu->rpc_codes[i],
+                msg,
+                ack_client && msg->header().from_address.ip != 0
+                );
+        }
     }
     else
     {
         on_empty_write();
     }
 
+    // apps written against the old contract advance the decree on each write
+    // themselves, which only holds with one update per mutation, so the first
+    // single-update write tells whether batching can be turned on for this app
+    if (!_write_contract_checked && mu->rpc_codes.size() == 1)
+    {
+        _write_contract_checked = true;
+        _write_batch_allowed = (last_committed_decree() == last_decree);
+        if (!_write_batch_allowed)
+        {
+            dwarn("replication local app %s advances last_committed_decree on writes itself, "
+                "request batching is disabled for it", data_dir().c_str());
+        }
+    }
+
+    // one decree per mutation no matter how many updates it carries
+    _last_committed_decree.store(mu->data.header.decree);
+
     if (_physical_error != 0)
     {
         derror("physical error %d occurs in replication local app %s", _physical_error, data_dir().c_str());
@@ -83,6 +110,32 @@ error_code replication_app_base::write_internal(mutation_ptr& mu, bool ack_clien
     return _physical_error == 0 ? ERR_OK : ERR_LOCAL_APP_FAILURE;
 }
 
+/*static*/ decree replication_app_base::read_decree()
+{
+    return s_read_decree;
+}
+
+/*static*/ void replication_app_base::reject_read(error_code err)
+{
+    s_read_error = err.get();
+}
+
+void replication_app_base::dispatch_read(int code, message_ptr& request, decree d)
+{
+    s_read_decree = d;
+    s_read_error = 0;
+    dispatch_rpc_call(code, request, true);
+    s_read_decree = invalid_decree;
+
+    if (s_read_error != 0)
+    {
+        message_ptr resp = request->create_response();
+        resp->writer().write(s_read_error);
+        rpc::reply(resp);
+        s_read_error = 0;
+    }
+}
+
 void replication_app_base::dispatch_rpc_call(int code, message_ptr& request, bool ack_client)
 {
     auto it = _handlers.find(code);
@@ -29,19 +29,36 @@
 #include "meta_server_failure_detector.h"
 #include <boost/filesystem.hpp>
 #include <sys/stat.h>
+#include <sstream>
+#include <map>
 
 # ifdef __TITLE__
 # undef __TITLE__
 # endif
 # define __TITLE__ "meta.service"
 
+// what file::open returns on failure, and the handle of no file
+# ifdef _WIN32
+static const handle_t invalid_file_handle = nullptr;
+# else
+static const handle_t invalid_file_handle = static_cast<handle_t>(-1);
+# endif
+
 meta_service::meta_service(server_state* state)
 : _state(state), serverlet("meta_service")
 {
     _balancer = nullptr;
     _failure_detector = nullptr;
-    _log = static_cast<handle_t>(0);
+    _log = invalid_file_handle;
     _offset = 0;
+    _log_gen = 0;
+    _log_writing = false;
+    _log_pending[0] = 0;
+    _log_pending[1] = 0;
+    _checkpointing = false;
+    _checkpoint_waiting = false;
+    _checkpoint_log = invalid_file_handle;
+    _checkpoint_file = invalid_file_handle;
     _data_dir = ".";
     _started = false;
 
@@ -52,44 +69,52 @@ meta_service::~meta_service(void)
 {
 }
 
-void meta_service::start(const char* data_dir, bool clean_state)
+// the logs on disk in log order, where a plain 'oplog' is left by older
+// versions which never roll the log over, so it comes before all generations
+static std::vector<std::string> list_logs(const std::string& dir)
 {
-    dassert(!_started, "meta service is already started");
-
-    _data_dir = data_dir;
-
-    if (clean_state)
+    std::map<int64_t, std::string> logs;
+    boost::filesystem::directory_iterator end;
+    for (boost::filesystem::directory_iterator it(dir); it != end; ++it)
     {
-        try {
-            boost::filesystem::remove(_data_dir + "/checkpoint");
-            boost::filesystem::remove(_data_dir + "/oplog");
+        std::string name = it->path().filename().string();
+        if (name == "oplog")
+        {
+            logs[-1] = it->path().string();
         }
-        catch (std::exception& ex)
+        else if (name.length() > 6 && name.compare(0, 6, "oplog.") == 0
+            && name.find_first_not_of("0123456789", 6) == std::string::npos)
         {
-            ex;
+            logs[atoll(name.c_str() + 6)] = it->path().string();
         }
     }
-    else
+
+    std::vector<std::string> r;
+    for (auto& log : logs)
     {
-        if (!boost::filesystem::exists(_data_dir))
-        {
-            boost::filesystem::create_directory(_data_dir);
-        }
+        r.push_back(log.second);
+    }
+    return r;
+}
 
-        if (boost::filesystem::exists(_data_dir + "/checkpoint"))
-        {
-            _state->load((_data_dir + "/checkpoint").c_str());
-        }
+std::string meta_service::log_path(int64_t gen) const
+{
+    std::stringstream ss;
+    ss << _data_dir << "/oplog." << gen;
+    return ss.str();
+}
 
-        if (boost::filesystem::exists(_data_dir + "/oplog"))
-        {
-            replay_log((_data_dir + "/oplog").c_str());
-            _state->save((_data_dir + "/checkpoint").c_str());
-            boost::filesystem::remove(_data_dir + "/oplog");
-        }
-    }
+void meta_service::start(const char* data_dir, bool clean_state)
+{
+    dassert(!_started, "meta service is already started");
 
-    _log = file::open((_data_dir + "/oplog").c_str(), O_RDWR | O_CREAT, 0666);
+    _data_dir = data_dir;
+    load_state(clean_state);
+
+    _log_gen = 0;
+    _offset = 0;
+    _log = file::open(log_path(_log_gen).c_str(), O_RDWR | O_CREAT, 0666);
+    dassert(_log != invalid_file_handle, "open operation log %s failed", log_path(_log_gen).c_str());
 
     _balancer = new load_balancer(_state);            
     _failure_detector = new meta_server_failure_detector(_state, this);
@@ -111,6 +136,14 @@ void meta_service::start(const char* data_dir, bool clean_state)
         10000
         );
 
+    if (_opts.meta_checkpoint_interval_ms > 0)
+    {
+        _checkpoint_timer = tasking::enqueue(LPC_CM_CHECKPOINT, this, &meta_service::on_checkpoint_timer, 0,
+            _opts.meta_checkpoint_interval_ms, // delay
+            _opts.meta_checkpoint_interval_ms
+            );
+    }
+
     auto err = _failure_detector->start(
         _opts.fd_check_interval_seconds,
         _opts.fd_beacon_interval_seconds,
@@ -124,6 +157,53 @@ void meta_service::start(const char* data_dir, bool clean_state)
     _started = true;
 }
 
+void meta_service::load_state(bool clean_state)
+{
+    if (clean_state)
+    {
+        try {
+            boost::filesystem::remove(_data_dir + "/checkpoint");
+            boost::filesystem::remove(_data_dir + "/checkpoint.tmp");
+            for (auto& log : list_logs(_data_dir))
+            {
+                boost::filesystem::remove(log);
+            }
+        }
+        catch (std::exception& ex)
+        {
+            ex;
+        }
+    }
+    else
+    {
+        if (!boost::filesystem::exists(_data_dir))
+        {
+            boost::filesystem::create_directory(_data_dir);
+        }
+
+        if (boost::filesystem::exists(_data_dir + "/checkpoint"))
+        {
+            _state->load((_data_dir + "/checkpoint").c_str());
+        }
+
+        auto logs = list_logs(_data_dir);
+        if (logs.size() > 0)
+        {
+            for (auto& log : logs)
+            {
+                replay_log(log.c_str());
+            }
+
+            _state->save((_data_dir + "/checkpoint.tmp").c_str());
+            boost::filesystem::rename(_data_dir + "/checkpoint.tmp", _data_dir + "/checkpoint");
+            for (auto& log : logs)
+            {
+                boost::filesystem::remove(log);
+            }
+        }
+    }
+}
+
 bool meta_service::stop()
 {
     if (!_started) return false;
@@ -133,6 +213,22 @@ bool meta_service::stop()
     _failure_detector = nullptr;
 
     _balancer_timer->cancel(true);
+    if (_checkpoint_timer != nullptr)
+    {
+        _checkpoint_timer->cancel(true);
+        _checkpoint_timer = nullptr;
+    }
+
+    task_ptr log_batch_timer;
+    {
+        zauto_lock l(_log_lock);
+        log_batch_timer = _log_batch_timer;
+        _log_batch_timer = nullptr;
+    }
+    if (log_batch_timer != nullptr)
+    {
+        log_batch_timer->cancel(true);
+    }
     unregister_rpc_handler(RPC_CM_CALL);
     delete _balancer;
     _balancer = nullptr;
@@ -217,30 +313,73 @@ void meta_service::replay_log(const char* log)
     FILE* fp = ::fopen(log, "rb");
     dassert (fp != nullptr, "open operation log %s failed, err = %d", log, errno);
 
-    char buffer[4096]; // enough for holding configuration_update_request
+    ::fseek(fp, 0, SEEK_END);
+    uint64_t file_size = static_cast<uint64_t>(::ftell(fp));
+    ::fseek(fp, 0, SEEK_SET);
+
+    // stream the log through a buffer holding many records per read, which
+    // only grows when a single record does not fit in
+    std::vector<char> buffer(1024 * 1024);
+    size_t begin = 0, end = 0;
+    uint64_t offset = 0; // file offset of buffer[begin]
+    bool eof = false;
     while (true)
     {
-        int32_t len;
-        if (1 != ::fread((void*)&len, sizeof(int32_t), 1, fp))
-            break;
+        while (end - begin >= sizeof(int32_t))
+        {
+            // a length torn by a crash mid-write can be anything, so a record
+            // running beyond the file is the torn tail of the log
+            int32_t len = *(int32_t*)&buffer[begin];
+            if (len < 0 || offset + sizeof(int32_t) + len > file_size)
+            {
+                eof = true;
+                break;
+            }
+
+            if (end - begin < sizeof(int32_t) + len)
+                break;
+
+            blob bb(&buffer[begin + sizeof(int32_t)], 0, len);
+            binary_reader reader(bb);
+            begin += sizeof(int32_t) + len;
+            offset += sizeof(int32_t) + len;
+
+            configuration_update_request request;
+            configuration_update_response response;
+            unmarshall(reader, request);
+
+            node_states state;
+            state.push_back(std::make_pair(request.node, true));
+
+            _state->set_node_state(state, nullptr);
+            _state->update_configuration(request, response);
+            response.err.end_tracking();
+        }
 
-        dassert(len <= 4096, "");
-        auto r = ::fread((void*)buffer, len, 1, fp);
-        dassert(r == 1, "log is corrupted");
+        if (eof)
+            break;
 
-        blob bb(buffer, 0, len);
-        binary_reader reader(bb);
+        memmove(&buffer[0], &buffer[begin], end - begin);
+        end -= begin;
+        begin = 0;
 
-        configuration_update_request request;
-        configuration_update_response response;
-        unmarshall(reader, request);
+        if (end >= sizeof(int32_t))
+        {
+            size_t need = sizeof(int32_t) + *(int32_t*)&buffer[0];
+            if (need > buffer.size())
+                buffer.resize(need);
+        }
 
-        node_states state;
-        state.push_back(std::make_pair(request.node, true));
+        size_t r = ::fread((void*)&buffer[end], 1, buffer.size() - end, fp);
+        if (r == 0)
+            eof = true;
+        end += r;
+    }
 
-        _state->set_node_state(state, nullptr);
-        _state->update_configuration(request, response);
-        response.err.end_tracking();
+    if (offset < file_size)
+    {
+        dwarn("log %s ends with an incomplete record of %llu bytes, ignored", log,
+            static_cast<unsigned long long>(file_size - offset));
     }
 
     ::fclose(fp);
@@ -270,7 +409,6 @@ void meta_service::update_configuration(message_ptr req, message_ptr resp)
     }
 
     auto bb = req->reader().get_remaining_buffer();
-    uint64_t offset;
     int len = bb.length() + sizeof(int32_t);
     
     char* buffer = (char*)malloc(len);
@@ -283,16 +421,7 @@ void meta_service::update_configuration(message_ptr req, message_ptr resp)
     auto request = std::shared_ptr<configuration_update_request>(new configuration_update_request());
     unmarshall(req, *request);
 
-    {
-
-        zauto_lock l(_log_lock);
-        offset = _offset;
-        _offset += len;
-
-        file::write(_log, buffer, len, offset, LPC_CM_LOG_UPDATE, this,
-            std::bind(&meta_service::on_log_completed, this, 
-            std::placeholders::_1, std::placeholders::_2, bb2, request, resp));
-    }
+    append_log_update(bb2, request, resp);
 }
 
 void meta_service::update_configuration(std::shared_ptr<configuration_update_request>& update)
@@ -305,37 +434,137 @@ void meta_service::update_configuration(std::shared_ptr<configuration_update_req
     blob bb = writer.get_buffer();
     *(int32_t*)bb.data() = bb.length() - sizeof(int32_t);
 
+    append_log_update(bb, update, nullptr);
+}
+
+void meta_service::append_log_update(const blob& buffer, const std::shared_ptr<configuration_update_request>& request, const message_ptr& response)
+{
+    log_update u;
+    u.buffer = buffer;
+    u.request = request;
+    u.response = response;
+
+    zauto_lock l(_log_lock);
+    _log_updates.push_back(u);
+
+    // written when the current write completes
+    if (_log_writing)
+        return;
+
+    if (_opts.meta_log_batch_window_ms > 0)
     {
-        zauto_lock l(_log_lock);
-        auto offset = _offset;
-        _offset += bb.length();
+        if (_log_batch_timer == nullptr)
+        {
+            _log_batch_timer = tasking::enqueue(LPC_CM_LOG_BATCH, this, &meta_service::on_log_batch_timer, 0,
+                _opts.meta_log_batch_window_ms);
+        }
+    }
+    else
+    {
+        write_log_updates();
+    }
+}
 
-        file::write(_log, bb.data(), bb.length(), offset, LPC_CM_LOG_UPDATE, this,
-            std::bind(&meta_service::on_log_completed, this,
-            std::placeholders::_1, std::placeholders::_2, bb, update, nullptr));
+void meta_service::on_log_batch_timer()
+{
+    zauto_lock l(_log_lock);
+    _log_batch_timer = nullptr;
+    if (!_log_writing && _log_updates.size() > 0)
+    {
+        write_log_updates();
+    }
+}
+
+void meta_service::write_log_updates()
+{
+    log_batch batch(new std::vector<log_update>());
+    batch->swap(_log_updates);
+
+    blob bb;
+    if (batch->size() == 1)
+    {
+        bb = (*batch)[0].buffer;
     }
+    else
+    {
+        int len = 0;
+        for (auto& u : *batch)
+        {
+            len += u.buffer.length();
+        }
+
+        std::shared_ptr<char> buffer(new char[len], std::default_delete<char[]>());
+        int pos = 0;
+        for (auto& u : *batch)
+        {
+            memcpy(buffer.get() + pos, u.buffer.data(), u.buffer.length());
+            pos += u.buffer.length();
+        }
+        bb = blob(buffer, 0, len);
+    }
+
+    auto offset = _offset;
+    _offset += bb.length();
+    _log_pending[_log_gen % 2] += static_cast<int>(batch->size());
+    _log_writing = true;
+
+    file::write(_log, bb.data(), bb.length(), offset, LPC_CM_LOG_UPDATE, this,
+        std::bind(&meta_service::on_log_written, this,
+        std::placeholders::_1, std::placeholders::_2, bb, batch, _log, _log_gen));
 }
 
-void meta_service::on_log_completed(error_code err, int size, 
-    blob buffer, 
-    std::shared_ptr<configuration_update_request> req, message_ptr resp)
+void meta_service::on_log_written(error_code err, uint32_t size, blob buffer, log_batch batch, handle_t log, int64_t gen)
 {
     dassert(err == ERR_OK, "log operation failed, cannot proceed, err = %s", err.to_string());
-    dassert(buffer.length() == size, "log size must equal to the specified buffer size");
+    dassert(buffer.length() == static_cast<int>(size), "log size must equal to the specified buffer size");
 
-    configuration_update_response response;    
-    update_configuration(*req, response);
+    // the log is not closed by checkpointing until the batch is applied
+    if (_opts.meta_log_durable_write)
+    {
+        file::sync(log, LPC_CM_LOG_UPDATE, this,
+            std::bind(&meta_service::on_log_completed, this,
+            std::placeholders::_1, std::placeholders::_2, batch, gen));
+    }
+    else
+    {
+        on_log_completed(err, size, batch, gen);
+    }
+}
+
+void meta_service::on_log_completed(error_code err, uint32_t size, log_batch batch, int64_t gen)
+{
+    dassert(err == ERR_OK, "log operation failed, cannot proceed, err = %s", err.to_string());
 
-    if (resp != nullptr)
+    for (auto& u : *batch)
     {
-        meta_response_header rhdr;
-        rhdr.err = err;
-        rhdr.primary_address = primary_address();
+        configuration_update_response response;
+        update_configuration(*u.request, response);
 
-        marshall(resp, rhdr);
-        marshall(resp, response);
+        if (u.response != nullptr)
+        {
+            meta_response_header rhdr;
+            rhdr.err = err;
+            rhdr.primary_address = primary_address();
 
-        rpc::reply(resp);
+            marshall(u.response, rhdr);
+            marshall(u.response, response);
+
+            rpc::reply(u.response);
+        }
+    }
+    // the checkpoint waiting for the updates of this log to be applied is resumed
+    // by the last of them
+    if (_log_pending[gen % 2].fetch_sub(static_cast<int>(batch->size())) == static_cast<int>(batch->size())
+        && _checkpoint_waiting.exchange(false))
+    {
+        tasking::enqueue(LPC_CM_CHECKPOINT, this, &meta_service::on_checkpoint_log_applied);
+    }
+
+    zauto_lock l(_log_lock);
+    _log_writing = false;
+    if (_log_updates.size() > 0)
+    {
+        write_log_updates();
     }
 }
 
@@ -380,3 +609,126 @@ void meta_service::on_config_changed(global_partition_id gpid)
         _failure_detector->set_primary(false);
     }
 }
+
+// checkpointing
+void meta_service::on_checkpoint_timer()
+{
+    if (_checkpointing.exchange(true))
+        return;
+
+    {
+        zauto_lock l(_log_lock);
+
+        // nothing is logged since last checkpoint
+        if (_offset == 0 && _checkpoint_log_gens.size() == 0)
+        {
+            _checkpointing = false;
+            return;
+        }
+
+        if (_offset > 0)
+        {
+            auto log = file::open(log_path(_log_gen + 1).c_str(), O_RDWR | O_CREAT, 0666);
+            if (log == invalid_file_handle)
+            {
+                derror("open operation log %s failed, checkpoint skipped", log_path(_log_gen + 1).c_str());
+                _checkpointing = false;
+                return;
+            }
+
+            _checkpoint_log = _log;
+            _checkpoint_log_gens.push_back(_log_gen);
+
+            _log_gen++;
+            _offset = 0;
+            _log = log;
+        }
+    }
+
+    on_checkpoint_log_applied();
+}
+
+void meta_service::on_checkpoint_log_applied()
+{
+    // wait for the updates still being logged to or applied from the previous log,
+    // where on_log_completed calls back once they are (or when it takes the flag
+    // from us below, to avoid missing the last of them)
+    _checkpoint_waiting = true;
+    if (_log_pending[(_log_gen + 1) % 2].load() > 0 || !_checkpoint_waiting.exchange(false))
+        return;
+
+    if (_checkpoint_log != invalid_file_handle)
+    {
+        auto err = file::close(_checkpoint_log);
+        err.end_tracking();
+        _checkpoint_log = invalid_file_handle;
+    }
+
+    _state->snapshot(_checkpoint);
+    _checkpoint_file = file::open((_data_dir + "/checkpoint.tmp").c_str(), O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    if (_checkpoint_file == invalid_file_handle)
+    {
+        derror("create %s/checkpoint.tmp failed", _data_dir.c_str());
+        end_checkpoint(false);
+        return;
+    }
+
+    file::write(_checkpoint_file, _checkpoint.data(), _checkpoint.length(), 0,
+        LPC_CM_CHECKPOINT_WRITE, this, &meta_service::on_checkpoint_written);
+}
+
+void meta_service::on_checkpoint_written(error_code err, uint32_t size)
+{
+    if (err != ERR_OK || size != static_cast<uint32_t>(_checkpoint.length()))
+    {
+        derror("write checkpoint failed, err = %s, size = %u", err.to_string(), size);
+        end_checkpoint(false);
+        return;
+    }
+
+    file::sync(_checkpoint_file, LPC_CM_CHECKPOINT_WRITE, this, &meta_service::on_checkpoint_synced);
+}
+
+void meta_service::on_checkpoint_synced(error_code err, uint32_t size)
+{
+    if (err != ERR_OK)
+    {
+        derror("sync checkpoint failed, err = %s", err.to_string());
+        end_checkpoint(false);
+        return;
+    }
+
+    end_checkpoint(true);
+}
+
+void meta_service::end_checkpoint(bool succeeded)
+{
+    if (_checkpoint_file != invalid_file_handle)
+    {
+        auto err = file::close(_checkpoint_file);
+        err.end_tracking();
+        _checkpoint_file = invalid_file_handle;
+    }
+    _checkpoint = blob();
+
+    // the logs are kept on failure and removed by a later checkpoint
+    if (succeeded)
+    {
+        try {
+            boost::filesystem::rename(_data_dir + "/checkpoint.tmp", _data_dir + "/checkpoint");
+            for (auto& gen : _checkpoint_log_gens)
+            {
+                boost::filesystem::remove(log_path(gen));
+            }
+
+            ddebug("checkpoint done, %d logs removed", static_cast<int>(_checkpoint_log_gens.size()));
+            _checkpoint_log_gens.clear();
+        }
+        catch (std::exception& ex)
+        {
+            derror("checkpoint rename or log removal failed, err = %s", ex.what());
+        }
+    }
+
+    _checkpointing = false;
+}
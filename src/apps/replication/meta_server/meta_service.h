@@ -26,6 +26,7 @@
 #pragma once
 
 #include "replication_common.h"
+#include <atomic>
 
 using namespace dsn;
 using namespace dsn::service;
@@ -38,6 +39,7 @@ class meta_server_failure_detector;
 namespace dsn {
     namespace replication{
         class replication_checker;
+        class replication_tester;
     }
 }
 
@@ -52,7 +54,9 @@ public:
 
 private:
     void on_request(message_ptr& request);
+    void load_state(bool clean_state); // from the checkpoint and the logs in _data_dir
     void replay_log(const char* log);
+    std::string log_path(int64_t gen) const;
 
     // partition server & client => meta server
     void query_configuration_by_node(configuration_query_by_node_request& request, __out_param configuration_query_by_node_response& response);
@@ -61,16 +65,38 @@ private:
     // update configuration
     void update_configuration(message_ptr req, message_ptr resp);
     void update_configuration(std::shared_ptr<configuration_update_request>& update);
-    void on_log_completed(error_code err, int size, blob buffer, std::shared_ptr<configuration_update_request> req, message_ptr resp);
     void update_configuration(configuration_update_request& request, __out_param configuration_update_response& response);
+
+    // group commit of the configuration updates
+    struct log_update
+    {
+        blob                                          buffer;   // [length][request]
+        std::shared_ptr<configuration_update_request> request;
+        message_ptr                                   response; // null for updates from meta server itself
+    };
+    typedef std::shared_ptr<std::vector<log_update>> log_batch;
+
+    void append_log_update(const blob& buffer, const std::shared_ptr<configuration_update_request>& request, const message_ptr& response);
+    void write_log_updates(); // under _log_lock
+    void on_log_batch_timer();
+    void on_log_written(error_code err, uint32_t size, blob buffer, log_batch batch, handle_t log, int64_t gen);
+    void on_log_completed(error_code err, uint32_t size, log_batch batch, int64_t gen);
       
     // load balance actions
     void on_load_balance_timer();
     void on_config_changed(global_partition_id gpid);
 
+    // checkpointing
+    void on_checkpoint_timer();
+    void on_checkpoint_log_applied();
+    void on_checkpoint_written(error_code err, uint32_t size);
+    void on_checkpoint_synced(error_code err, uint32_t size);
+    void end_checkpoint(bool succeeded);
+
 private:
     friend class meta_server_failure_detector;
     friend class ::dsn::replication::replication_checker;
+    friend class ::dsn::replication::replication_tester; // unit tests (src/tests)
 
     meta_server_failure_detector *_failure_detector;
     server_state                 *_state;
@@ -83,5 +109,26 @@ private:
     zlock                        _log_lock;
     handle_t                     _log;
     uint64_t                     _offset;
+    int64_t                      _log_gen;        // updates are logged to oplog.<_log_gen>
+
+    // updates arriving while a log write is in flight, or within
+    // meta_log_batch_window_ms, are written and synced to the log together,
+    // and then applied and replied in log order
+    std::vector<log_update>      _log_updates;    // waiting for the next write
+    bool                         _log_writing;    // a write (and sync) is in flight
+    task_ptr                     _log_batch_timer;
+    std::atomic<int>             _log_pending[2]; // logged or being logged but not yet applied, by gen % 2
+
+    // a checkpoint rolls the log over to the next generation, waits until the
+    // updates in the previous logs are applied, writes a snapshot of the state
+    // to checkpoint.tmp, renames it to checkpoint, and removes the previous logs;
+    // replay after the checkpoint is safe as stale updates are rejected by ballot
+    task_ptr                     _checkpoint_timer;
+    std::atomic<bool>            _checkpointing;
+    std::atomic<bool>            _checkpoint_waiting;  // for the updates in the previous logs to be applied
+    handle_t                     _checkpoint_log;      // the log just rolled over from
+    std::vector<int64_t>         _checkpoint_log_gens; // rolled over but not yet removed
+    handle_t                     _checkpoint_file;
+    blob                         _checkpoint;
 }; 
 
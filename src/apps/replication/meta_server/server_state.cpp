@@ -57,6 +57,8 @@ server_state::server_state(void)
     _node_live_count = 0;
     _freeze = true;
     _node_live_percentage_threshold_for_update = 65;
+    _config_epoch = static_cast<int64_t>(env::random64(1, 0x7fffffffffffffffULL));
+    _config_version = 1;
 }
 
 server_state::~server_state(void)
@@ -82,6 +84,7 @@ void server_state::load(const char* chk_point)
 
     dassert(_apps.size() == 1, "");
     auto& app = _apps[0];
+    app.partition_versions.assign(app.partition_count, _config_version);
     for (int i = 0; i < app.partition_count; i++)
     {
         auto& ps = app.partitions[i];
@@ -103,6 +106,7 @@ void server_state::load(const char* chk_point)
     {
         node.second.address = node.first;
         node.second.is_alive = true;
+        node.second.version = _config_version;
         _node_live_count++;
     }
 
@@ -117,23 +121,31 @@ void server_state::load(const char* chk_point)
 
 void server_state::save(const char* chk_point)
 {
-    binary_writer writer;
-    marshall(writer, _apps);
+    blob bb;
+    snapshot(bb);
 
     FILE* fp = ::fopen(chk_point, "wb+");
+    ::fwrite((const void*)bb.data(), bb.length(), 1, fp);
+    ::fclose(fp);
+}
 
-    int32_t len = writer.total_size();
-    ::fwrite((const void*)&len, sizeof(len), 1, fp);
-
-    std::vector<blob> bbs;
-    writer.get_buffers(bbs);
-
-    for (auto& bb : bbs)
+void server_state::snapshot(__out_param blob& chk_point)
+{
+    // copy under the lock and serialize outside, so that updates are
+    // only blocked for the copy
+    std::vector<app_state> apps;
     {
-        ::fwrite((const void*)bb.data(), bb.length(), 1, fp);
+        zauto_read_lock l(_lock);
+        apps = _apps;
     }
 
-    ::fclose(fp);
+    binary_writer writer;
+    int32_t len = 0;
+    marshall(writer, len);
+    marshall(writer, apps);
+
+    chk_point = writer.get_buffer();
+    *(int32_t*)chk_point.data() = chk_point.length() - sizeof(int32_t);
 }
 
 void server_state::init_app(configuration_ptr& cf)
@@ -162,6 +174,7 @@ void server_state::init_app(configuration_ptr& cf)
         ps.max_replica_count = max_replica_count;
 
         app.partitions.push_back(ps);
+        app.partition_versions.push_back(_config_version);
     }
     
     _apps.push_back(app);
@@ -224,6 +237,7 @@ void server_state::set_node_state(const node_states& nodes, __out_param machine_
             node_state n;
             n.address = itr.first;
             n.is_alive = itr.second;
+            n.version = _config_version;
 
             _nodes[itr.first] = n;
 
@@ -305,20 +319,88 @@ void server_state::switch_meta_primary()
 // partition server & client => meta server
 void server_state::query_configuration_by_node(configuration_query_by_node_request& request, __out_param configuration_query_by_node_response& response)
 {
-    zauto_read_lock l(_lock);
-    auto it = _nodes.find(request.node);
-    if (it == _nodes.end())
+    // removals already known to the node, pruned below under the write lock
+    int64_t known_version = 0;
     {
-        response.err = ERR_OBJECT_NOT_FOUND;
+        zauto_read_lock l(_lock);
+        auto it = _nodes.find(request.node);
+        if (it == _nodes.end())
+        {
+            response.err = ERR_OBJECT_NOT_FOUND;
+            response.epoch = _config_epoch;
+            response.version = 0;
+            response.is_delta = false;
+        }
+        else
+        {
+            node_state& node = it->second;
+            response.err = ERR_OK;
+            response.epoch = _config_epoch;
+            response.version = node.version;
+
+            // a version from another server_state instance, or one we have
+            // not handed out to this node, gets the full list
+            response.is_delta = (request.known_epoch == _config_epoch
+                && request.known_version > 0
+                && request.known_version <= node.version);
+
+            if (!response.is_delta)
+            {
+                for (auto& p : node.partitions)
+                {
+                    response.partitions.push_back(_apps[p.app_id - 1].partitions[p.pidx]);
+                }
+            }
+            else if (request.known_version < node.version)
+            {
+                for (auto& p : node.partitions)
+                {
+                    app_state& app = _apps[p.app_id - 1];
+                    if (app.partition_versions[p.pidx] > request.known_version)
+                    {
+                        response.partitions.push_back(app.partitions[p.pidx]);
+                    }
+                }
+
+                for (auto& r : node.removed)
+                {
+                    if (r.second > request.known_version)
+                    {
+                        response.removed_partitions.push_back(r.first);
+                    }
+                }
+            }
+
+            // the node queries again with the version in this response only
+            // after applying it, so a delta request acknowledges the removals up
+            // to its known version, and a full list makes all of them obsolete
+            if (!node.removed.empty())
+            {
+                known_version = response.is_delta ? request.known_version : node.version;
+            }
+        }
     }
-    else
+
+    if (known_version > 0)
     {
-        response.err = ERR_OK;
+        prune_removed_partitions(request.node, known_version);
+    }
+}
 
-        for (auto& p : it->second.partitions)
-        {
-            response.partitions.push_back(_apps[p.app_id - 1].partitions[p.pidx]);
-        }
+void server_state::prune_removed_partitions(const end_point& node, int64_t known_version)
+{
+    zauto_write_lock l(_lock);
+    auto it = _nodes.find(node);
+    if (it == _nodes.end())
+        return;
+
+    auto& removed = it->second.removed;
+    for (auto r = removed.begin(); r != removed.end();)
+    {
+        if (r->second <= known_version)
+            r = removed.erase(r);
+        else
+            r++;
     }
 }
 
@@ -371,6 +453,7 @@ void server_state::update_configuration_internal(configuration_update_request& r
         response.err = ERR_OK;
 
         // update to new config
+        update_config_versions(old, request.config, request.node);
         old = request.config;
         response.config = request.config;
         
@@ -409,6 +492,11 @@ void server_state::update_configuration_internal(configuration_update_request& r
             dassert(false, "invalid config type %x", static_cast<int>(request.type));
         }
 
+        if (node.partitions.find(old.gpid) == node.partitions.end())
+            node.removed[old.gpid] = _config_version;
+        else
+            node.removed.erase(old.gpid);
+
         std::stringstream cf;
         cf << "{primary:" << request.config.primary.name << ":" << request.config.primary.port << ", secondaries = [";
         for (auto& s : request.config.secondaries)
@@ -436,6 +524,29 @@ void server_state::update_configuration_internal(configuration_update_request& r
 #endif
 }
 
+void server_state::update_config_versions(const partition_configuration& old_config, const partition_configuration& new_config, const end_point& node)
+{
+    int64_t version = ++_config_version;
+    _apps[new_config.gpid.app_id - 1].partition_versions[new_config.gpid.pidx] = version;
+
+    auto touch = [this, version](const end_point& ep)
+    {
+        if (ep == end_point::INVALID)
+            return;
+        auto it = _nodes.find(ep);
+        if (it != _nodes.end())
+            it->second.version = version;
+    };
+
+    touch(node);
+    touch(old_config.primary);
+    touch(new_config.primary);
+    for (auto& ep : old_config.secondaries)
+        touch(ep);
+    for (auto& ep : new_config.secondaries)
+        touch(ep);
+}
+
 void server_state::check_consistency(global_partition_id gpid)
 {
     app_state& app = _apps[gpid.app_id - 1];
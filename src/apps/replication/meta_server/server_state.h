@@ -27,6 +27,7 @@
 
 #include "replication_common.h"
 #include <set>
+#include <map>
 
 using namespace dsn;
 using namespace dsn::service;
@@ -35,6 +36,7 @@ using namespace dsn::replication;
 namespace dsn {
     namespace replication{
         class replication_checker;
+        class replication_tester;
     }
 }
 
@@ -47,6 +49,7 @@ struct app_state
     int32_t                              app_id;
     int32_t                              partition_count;
     std::vector<partition_configuration> partitions;
+    std::vector<int64_t>                 partition_versions; // not persisted, see server_state::_config_version
 };
 
 typedef std::unordered_map<global_partition_id, std::shared_ptr<configuration_update_request> > machine_fail_updates;
@@ -69,6 +72,7 @@ public:
 
     void load(const char* chk_point);
     void save(const char* chk_point);
+    void snapshot(__out_param blob& chk_point); // the content of save, i.e., [length][apps]
 
     // partition server & client => meta server
     void query_configuration_by_node(configuration_query_by_node_request& request, __out_param configuration_query_by_node_response& response);
@@ -80,10 +84,13 @@ public:
     
 private:
     void check_consistency(global_partition_id gpid);
+    void update_config_versions(const partition_configuration& old_config, const partition_configuration& new_config, const end_point& node);
     void update_configuration_internal(configuration_update_request& request, __out_param configuration_update_response& response);
+    void prune_removed_partitions(const end_point& node, int64_t known_version);
 
 private:
     friend class ::dsn::replication::replication_checker;
+    friend class ::dsn::replication::replication_tester; // unit tests (src/tests)
 
     struct node_state
     {
@@ -91,6 +98,16 @@ private:
         end_point                     address;
         std::set<global_partition_id> primaries;
         std::set<global_partition_id> partitions;
+
+        // config version of the latest change to any partition hosted
+        // (or formerly hosted) by this node, and the partitions removed
+        // from this node with the version of their removal, kept until
+        // the node queries with a version covering them (i.e., it has
+        // applied the delta with them) or gets a full sync
+        int64_t                       version;
+        std::map<global_partition_id, int64_t> removed;
+
+        node_state() : is_alive(false), version(0) {}
     };
 
     mutable zrwlock_nr                   _lock;
@@ -101,6 +118,12 @@ private:
     int                               _node_live_percentage_threshold_for_update;
     std::atomic<bool>                 _freeze;
 
+    // replica servers pass back the (epoch, version) of their last
+    // node query so that only the partitions changed since then are
+    // returned; the epoch tells apart versions from another instance
+    int64_t                           _config_epoch;
+    int64_t                           _config_version;
+
     mutable zrwlock_nr                   _meta_lock;
     std::vector<end_point>            _meta_servers;
     int                               _leader_index;
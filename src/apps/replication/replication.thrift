@@ -129,6 +129,7 @@ struct learn_response
     4:i64                   prepare_start_decree;
     5:learn_state           state;
     6:string                base_local_dir;
+    7:list<dsn.blob>        mutations; // committed mutations from commit_decree of the learner, instead of state
 }
 
 struct group_check_request
@@ -206,6 +207,8 @@ struct configuration_proposal_request
 struct configuration_query_by_node_request
 {
     1:dsn.end_point    node;
+    2:i64              known_epoch;
+    3:i64              known_version;
 }
 
 // meta server => client
@@ -213,6 +216,10 @@ struct configuration_query_by_node_response
 {
     1:dsn.error_code                err;
     2:list<partition_configuration> partitions;
+    3:i64                           epoch;
+    4:i64                           version;
+    5:bool                          is_delta;
+    6:list<global_partition_id>     removed_partitions;
 }
 
 struct configuration_query_by_index_request
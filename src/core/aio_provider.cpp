@@ -41,7 +41,44 @@ service_node* aio_provider::node() const
 
 void aio_provider::complete_io(aio_task_ptr& aio, error_code err, uint32_t bytes, int delay_milliseconds)
 {
+    auto ctx = aio->aio();
+    if (ctx->bounce_buffer != nullptr)
+    {
+        if (ctx->type == AIO_Read && err == ERR_OK)
+        {
+            const char* src = ctx->bounce_buffer.get();
+            uint32_t left = bytes;
+            for (auto& b : ctx->buffers)
+            {
+                if (left == 0)
+                    break;
+
+                uint32_t sz = b.size < left ? b.size : left;
+                memcpy(b.buffer, src, sz);
+                src += sz;
+                left -= sz;
+            }
+        }
+        ctx->bounce_buffer.reset();
+    }
+
     _engine->complete_io(aio, err, bytes, delay_milliseconds);
 }
 
+/*static*/ void aio_provider::gather_buffers(disk_aio* aio)
+{
+    aio->bounce_buffer.reset(new char[aio->buffer_size]);
+    aio->buffer = aio->bounce_buffer.get();
+
+    if (aio->type == AIO_Write)
+    {
+        char* dst = aio->bounce_buffer.get();
+        for (auto& b : aio->buffers)
+        {
+            memcpy(dst, b.buffer, b.size);
+            dst += b.size;
+        }
+    }
+}
+
 } // end namespace dsn
@@ -84,6 +84,35 @@ void disk_engine::write(aio_task_ptr& aio)
     return start_io(aio);
 }
 
+void disk_engine::read_vector(aio_task_ptr& aio)
+{
+    dassert(!aio->aio()->buffers.empty(), "vectored read must have buffers");
+    aio->aio()->type = AIO_Read;
+    return start_io(aio);
+}
+
+void disk_engine::write_vector(aio_task_ptr& aio)
+{
+    dassert(!aio->aio()->buffers.empty(), "vectored write must have buffers");
+    aio->aio()->type = AIO_Write;
+    return start_io(aio);
+}
+
+void disk_engine::write_vector_and_sync(aio_task_ptr& aio)
+{
+    dassert(!aio->aio()->buffers.empty(), "vectored write must have buffers");
+    aio->aio()->type = AIO_Write;
+    aio->aio()->sync_after_write = true;
+    aio->aio()->written_bytes = 0;
+    return start_io(aio);
+}
+
+void disk_engine::sync(aio_task_ptr& aio)
+{
+    aio->aio()->type = AIO_Sync;
+    return start_io(aio);
+}
+
 void disk_engine::start_io(aio_task_ptr& aio_tsk)
 {
     auto aio = aio_tsk->aio();
@@ -117,6 +146,23 @@ void disk_engine::complete_io(aio_task_ptr& aio, error_code err, uint32_t bytes,
 {
     // TODO: failure injection, profiling, throttling
 
+    // the provider cannot link the sync to the write, so issue it now that
+    // the write is done, and report the written bytes when it completes
+    auto ctx = aio->aio();
+    if (ctx->sync_after_write && !_provider->links_sync_to_write())
+    {
+        if (ctx->type == AIO_Write && err == ERR_OK)
+        {
+            ctx->type = AIO_Sync;
+            ctx->written_bytes = bytes;
+            return _provider->aio(aio);
+        }
+        else if (ctx->type == AIO_Sync)
+        {
+            bytes = ctx->written_bytes;
+        }
+    }
+
     if (err != ERR_OK)
     {
         dwarn(
@@ -44,6 +44,10 @@ public:
     error_code      close(handle_t hFile);
     void            read(aio_task_ptr& aio);
     void            write(aio_task_ptr& aio);  
+    void            sync(aio_task_ptr& aio);
+    void            read_vector(aio_task_ptr& aio);
+    void            write_vector(aio_task_ptr& aio);
+    void            write_vector_and_sync(aio_task_ptr& aio);
 
     disk_aio_ptr    prepare_aio_context(aio_task* tsk) { return _provider->prepare_aio_context(tsk); }
     service_node*   node() const { return _node; }
@@ -52,6 +52,7 @@ threadpool_spec& threadpool_spec::operator=(const threadpool_spec& source)
     worker_affinity_mask = source.worker_affinity_mask;
     max_input_queue_length = source.max_input_queue_length;
     partitioned = source.partitioned;
+    dequeue_batch_size = source.dequeue_batch_size;
     
     queue_factory_name = source.queue_factory_name;
     worker_factory_name = source.worker_factory_name;
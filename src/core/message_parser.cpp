@@ -30,6 +30,8 @@
 # undef __TITLE__
 # endif
 # define __TITLE__ "message.parser"
+# define CRC_INVALID 0xdead0c2c
+# define COMPACT_FLAG_HAS_BODY_CRC 0x1
 
 namespace dsn {
 
@@ -94,11 +96,22 @@ namespace dsn {
     message_ptr dsn_message_parser::get_message_on_receive(int read_length, __out_param int& read_next)
     {
         mark_read(read_length);
+        return get_message(read_next);
+    }
 
+    message_ptr dsn_message_parser::get_message(__out_param int& read_next)
+    {
         if (_read_buffer_occupied >= MSG_HDR_SERIALIZED_SIZE)
         {            
-            int msg_sz = MSG_HDR_SERIALIZED_SIZE +
-                message_header::get_body_length((char*)_read_buffer.data());
+            int body_length = message_header::get_body_length((char*)_read_buffer.data());
+            if (body_length < 0 || body_length > MAX_BODY_LENGTH)
+            {
+                derror("invalid message body length %d", body_length);
+                read_next = -1;
+                return nullptr;
+            }
+
+            int msg_sz = MSG_HDR_SERIALIZED_SIZE + body_length;
 
             // msg done
             if (_read_buffer_occupied >= msg_sz)
@@ -126,4 +139,164 @@ namespace dsn {
             return nullptr;
         }
     }
-}
\ No newline at end of file
+
+    //-------------------- compact message --------------------
+
+    char* compact_message_parser::write_varint(char* ptr, uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            *ptr++ = static_cast<char>(v | 0x80);
+            v >>= 7;
+        }
+        *ptr++ = static_cast<char>(v);
+        return ptr;
+    }
+
+    const char* compact_message_parser::read_varint(const char* ptr, const char* end, __out_param uint64_t& v)
+    {
+        v = 0;
+        for (int shift = 0; ptr < end && shift < 64; shift += 7)
+        {
+            uint64_t b = static_cast<uint8_t>(*ptr++);
+            v |= ((b & 0x7f) << shift);
+            if ((b & 0x80) == 0)
+                return ptr;
+        }
+        return nullptr;
+    }
+
+    uint32_t compact_message_parser::zigzag_encode(int32_t v)
+    {
+        return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+    }
+
+    int32_t compact_message_parser::zigzag_decode(uint64_t v)
+    {
+        uint32_t u = static_cast<uint32_t>(v);
+        return static_cast<int32_t>((u >> 1) ^ (~(u & 1) + 1));
+    }
+
+    compact_message_parser::compact_message_parser(int buffer_block_size)
+        : dsn_message_parser(buffer_block_size), _peer_compact(true)
+    {
+    }
+
+    message_ptr compact_message_parser::get_message_on_receive(int read_length, __out_param int& read_next)
+    {
+        mark_read(read_length);
+
+        if (_read_buffer_occupied < static_cast<int>(sizeof(uint32_t)) + 1)
+        {
+            read_next = MAX_HEADER_LENGTH;
+            return nullptr;
+        }
+
+        const char* hdr = _read_buffer.data();
+        if (*(uint32_t*)hdr != MAGIC)
+        {
+            _peer_compact = false;
+            return dsn_message_parser::get_message(read_next);
+        }
+
+        _peer_compact = true;
+        int hdr_sz = static_cast<uint8_t>(hdr[sizeof(uint32_t)]);
+        if (hdr_sz < static_cast<int>(sizeof(uint32_t)) + 2)
+        {
+            derror("invalid compact message header length %d", hdr_sz);
+            read_next = -1;
+            return nullptr;
+        }
+
+        if (_read_buffer_occupied < hdr_sz)
+        {
+            read_next = hdr_sz - _read_buffer_occupied;
+            return nullptr;
+        }
+
+        const char* ptr = hdr + sizeof(uint32_t) + 1;
+        const char* end = hdr + hdr_sz;
+        uint8_t flags = static_cast<uint8_t>(*ptr++);
+        uint64_t body_length, code, id, rpc_id, timeout_or_error, hash, port;
+
+        ptr = read_varint(ptr, end, body_length);
+        if (ptr) ptr = read_varint(ptr, end, code);
+        if (ptr) ptr = read_varint(ptr, end, id);
+        if (ptr) ptr = read_varint(ptr, end, rpc_id);
+        if (ptr) ptr = read_varint(ptr, end, timeout_or_error);
+        if (ptr) ptr = read_varint(ptr, end, hash);
+        if (ptr) ptr = read_varint(ptr, end, port);
+        if (ptr && (flags & COMPACT_FLAG_HAS_BODY_CRC) && ptr + sizeof(uint32_t) > end)
+            ptr = nullptr;
+        if (ptr == nullptr || body_length > static_cast<uint64_t>(MAX_BODY_LENGTH))
+        {
+            derror("invalid compact message header, body length = %llu", 
+                static_cast<unsigned long long>(body_length));
+            read_next = -1;
+            return nullptr;
+        }
+
+        int msg_sz = hdr_sz + static_cast<int>(body_length);
+        if (_read_buffer_occupied < msg_sz)
+        {
+            read_next = msg_sz - _read_buffer_occupied;
+            return nullptr;
+        }
+
+        auto body = _read_buffer.range(hdr_sz, static_cast<int>(body_length));
+        message_ptr msg = new message(body, false);
+        auto& h = msg->header();
+        if (flags & COMPACT_FLAG_HAS_BODY_CRC)
+        {
+            h.body_crc32 = *(int32_t*)ptr;
+        }
+        h.body_length = static_cast<int32_t>(body_length);
+        h.rpc_wire_code = static_cast<uint32_t>(code);
+        h.id = id;
+        h.rpc_id = rpc_id;
+        h.client.timeout_ms = zigzag_decode(timeout_or_error);
+        h.client.hash = zigzag_decode(hash);
+        h.client.port = static_cast<uint16_t>(port);
+        dassert(msg->is_right_body(), "body crc check failed");
+
+        _read_buffer = _read_buffer.range(msg_sz);
+        _read_buffer_occupied -= msg_sz;
+        read_next = MAX_HEADER_LENGTH;
+        return msg;
+    }
+
+    void compact_message_parser::prepare_buffers_for_send(message_ptr& msg, __out_param std::vector<blob>& buffers)
+    {
+        msg->writer().get_buffers(buffers);
+        if (!_peer_compact)
+            return;
+
+        auto& h = msg->header();
+        std::shared_ptr<char> buffer((char*)::malloc(MAX_HEADER_LENGTH));
+        char* ptr = buffer.get();
+
+        *(uint32_t*)ptr = MAGIC;
+        ptr += sizeof(uint32_t) + 1; // header length is filled later
+        *ptr++ = static_cast<char>(h.body_crc32 != (int32_t)CRC_INVALID ? COMPACT_FLAG_HAS_BODY_CRC : 0);
+        ptr = write_varint(ptr, static_cast<uint32_t>(h.body_length));
+        ptr = write_varint(ptr, h.rpc_wire_code);
+        ptr = write_varint(ptr, h.id);
+        ptr = write_varint(ptr, h.rpc_id);
+        ptr = write_varint(ptr, zigzag_encode(h.client.timeout_ms));
+        ptr = write_varint(ptr, zigzag_encode(h.client.hash));
+        ptr = write_varint(ptr, h.client.port);
+        if (h.body_crc32 != (int32_t)CRC_INVALID)
+        {
+            *(uint32_t*)ptr = static_cast<uint32_t>(h.body_crc32);
+            ptr += sizeof(uint32_t);
+        }
+
+        int hdr_sz = static_cast<int>(ptr - buffer.get());
+        dassert(hdr_sz <= MAX_HEADER_LENGTH, "compact header is too long");
+        buffer.get()[sizeof(uint32_t)] = static_cast<char>(hdr_sz);
+
+        // replace the placeholder for the dsn header in the first buffer
+        buffers[0] = buffers[0].range(MSG_HDR_SERIALIZED_SIZE);
+        buffers.insert(buffers.begin(), blob(buffer, 0, hdr_sz));
+    }
+}
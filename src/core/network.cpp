@@ -64,6 +64,13 @@ namespace dsn {
         {
             reply->header().from_address = remote_address();
             reply->header().to_address = _net.address();
+
+            // NET_HDR_COMPACT does not carry the rpc name
+            if (reply->header().rpc_name[0] == '\0' && reply->header().rpc_wire_code != 0)
+            {
+                strcpy(reply->header().rpc_name, 
+                    _net.engine()->get_rpc_name_by_wire_code(reply->header().rpc_wire_code));
+            }
         }
 
         return _matcher->on_recv_reply(key, reply, delay_ms);
@@ -61,6 +61,23 @@ namespace dsn {
             _matcher->on_rpc_timeout(_id);
         }
 
+        // reuse a cancelled timeout task for another call
+        void reset(rpc_client_matcher* matcher, uint64_t id)
+        {
+            _matcher = matcher;
+            _id = id;
+        }
+
+        // drop the ref to the matcher while the task is kept in its free list
+        bool reset_cancelled()
+        {
+            if (!task::reset_cancelled())
+                return false;
+
+            _matcher = nullptr;
+            return true;
+        }
+
     private:
         rpc_client_matcher_ptr _matcher;
         uint64_t               _id;
@@ -97,7 +114,10 @@ namespace dsn {
         {
             if (timeout_task != task::get_current_task())
             {
-                timeout_task->cancel(true);
+                if (timeout_task->cancel(true))
+                {
+                    reuse_timeout_task(timeout_task);
+                }
             }
             
             call->set_delay(delay_ms);
@@ -129,13 +149,44 @@ namespace dsn {
         call->enqueue(ERR_TIMEOUT, null_msg);
     }
     
+    void rpc_client_matcher::reuse_timeout_task(task_ptr& timeout_task)
+    {
+        if (!static_cast<rpc_timeout_task*>(timeout_task.get())->reset_cancelled())
+            return;
+
+        // keep about as many as the calls pending at once
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock);
+        if (_free_timeout_tasks.size() <= _requests.size())
+        {
+            _free_timeout_tasks.push_back(std::move(timeout_task));
+        }
+    }
+    
     void rpc_client_matcher::on_call(message_ptr& request, rpc_response_task_ptr& call)
     {
         message* msg = request.get();
-        task* timeout_task;
+        task_ptr timeout_task;
         message_header& hdr = msg->header();
 
-        timeout_task = (new rpc_timeout_task(this, hdr.id));
+        // the timeout task of an earlier call answered in time is reused, so that
+        // the common case allocates no task
+        {
+            utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock);
+            if (_free_timeout_tasks.size() > 0)
+            {
+                timeout_task = std::move(_free_timeout_tasks.back());
+                _free_timeout_tasks.pop_back();
+            }
+        }
+
+        if (timeout_task != nullptr)
+        {
+            static_cast<rpc_timeout_task*>(timeout_task.get())->reset(this, hdr.id);
+        }
+        else
+        {
+            timeout_task = new rpc_timeout_task(this, hdr.id);
+        }
 
         {
             utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock);
@@ -160,6 +211,7 @@ namespace dsn {
 
         _is_running = false;
         _local_primary_address = end_point::INVALID;
+        rebuild_code_table();
         _message_crc_required = config->get_value<bool>("network", "message_crc_required", false);
     }
     
@@ -296,6 +348,7 @@ namespace dsn {
         {
             _handlers[handler->code.to_string()] = handler;
             _handlers[handler->name] = handler;
+            rebuild_code_table();
             return true;
         }
         else
@@ -315,21 +368,159 @@ namespace dsn {
         std::string name = it->second->name;
         _handlers.erase(it);
         _handlers.erase(name);
+        rebuild_code_table();
         return true;
     }
 
-    void rpc_engine::on_recv_request(message_ptr& msg, int delay_ms)
+    void rpc_engine::rebuild_code_table()
+    {
+        // each handler is registered with both its code and name, 
+        // only the former one is used for wire codes
+        std::unordered_map<int, rpc_handler_ptr> handlers;
+        for (auto& kv : _handlers)
+        {
+            if (kv.first == kv.second->code.to_string())
+                handlers[kv.second->code] = kv.second;
+        }
+
+        // all rpc codes are kept so that names can also be resolved for responses
+        // and for rpcs which are not registered here
+        int max_task_code = task_code::max_value();
+        std::vector<int> codes;
+        for (int c = 0; c <= max_task_code; c++)
+        {
+            auto spec = task_spec::get(c);
+            if (spec != nullptr && (spec->type == TASK_TYPE_RPC_REQUEST || spec->type == TASK_TYPE_RPC_RESPONSE))
+                codes.push_back(c);
+        }
+
+        uint32_t sz = 16;
+        while (sz < codes.size() * 2)
+            sz *= 2;
+
+        std::shared_ptr<rpc_code_table> tbl(new rpc_code_table);
+        tbl->entries.resize(sz);
+        tbl->mask = sz - 1;
+        tbl->max_task_code = max_task_code;
+        for (auto& e : tbl->entries)
+        {
+            e.code = 0;
+            e.task_code = -1;
+        }
+
+        for (auto& c : codes)
+        {
+            uint32_t code = task_spec::get(c)->rpc_wire_code;
+            auto it = handlers.find(c);
+            for (uint32_t i = code & tbl->mask; ; i = (i + 1) & tbl->mask)
+            {
+                auto& e = tbl->entries[i];
+                if (e.code == 0)
+                {
+                    e.code = code;
+                    e.task_code = c;
+                    if (it != handlers.end())
+                        e.handler = it->second;
+                    break;
+                }
+                else if (e.code == code)
+                {
+                    if (e.task_code != -1)
+                    {
+                        dwarn("rpc %s and %s share the same wire code %x, fall back to name based dispatch",
+                            task_code::to_string(c),
+                            task_code::to_string(e.task_code),
+                            code
+                            );
+                    }
+                    e.task_code = -1;
+                    e.handler = nullptr;
+                    break;
+                }
+            }
+        }
+
+        std::atomic_store(&_code_table, rpc_code_table_ptr(tbl));
+    }
+
+    const rpc_engine::rpc_code_entry* rpc_engine::find_code_entry(const rpc_code_table_ptr& tbl, uint32_t code)
+    {
+        for (uint32_t i = code & tbl->mask; ; i = (i + 1) & tbl->mask)
+        {
+            auto& e = tbl->entries[i];
+            if (e.code == code)
+                return &e;
+            else if (e.code == 0)
+                return nullptr;
+        }
+    }
+
+    const char* rpc_engine::get_rpc_name_by_wire_code(uint32_t code)
+    {
+        auto tbl = std::atomic_load(&_code_table);
+        auto e = find_code_entry(tbl, code);
+
+        // rpc codes defined after the table is built
+        if (e == nullptr && tbl->max_task_code < task_code::max_value())
+        {
+            {
+                utils::auto_write_lock l(_handlers_lock);
+                rebuild_code_table();
+            }
+            tbl = std::atomic_load(&_code_table);
+            e = find_code_entry(tbl, code);
+        }
+
+        return (e != nullptr && e->task_code != -1) ? task_code::to_string(e->task_code) : "";
+    }
+
+    rpc_handler_ptr rpc_engine::find_handler(message_header& hdr)
     {
-        rpc_handler_ptr handler;
+        uint32_t code = hdr.rpc_wire_code;
+        if (code != 0)
         {
-            utils::auto_read_lock l(_handlers_lock);
-            auto it = _handlers.find(msg->header().rpc_name);
-            if (it != _handlers.end())
+            auto tbl = std::atomic_load(&_code_table);
+            auto e = find_code_entry(tbl, code);
+            if (e != nullptr && e->task_code != -1)
+            {
+                const char* name = task_code::to_string(e->task_code);
+
+                // NET_HDR_COMPACT does not carry the rpc name, see message_parser.h
+                if (hdr.rpc_name[0] == '\0')
+                {
+                    strcpy(hdr.rpc_name, name);
+                    return e->handler;
+                }
+
+                // the peer may use an rpc whose code collides with a local one
+                else if (e->handler != nullptr && strcmp(hdr.rpc_name, name) == 0)
+                {
+                    return e->handler;
+                }
+            }
+            else if (hdr.rpc_name[0] == '\0')
             {
-                handler = it->second;
+                strcpy(hdr.rpc_name, get_rpc_name_by_wire_code(code));
             }
         }
 
+        // foreign clients and unresolvable codes
+        utils::auto_read_lock l(_handlers_lock);
+        auto it = _handlers.find(hdr.rpc_name);
+        if (it != _handlers.end())
+        {
+            return it->second;
+        }
+        else
+        {
+            return nullptr;
+        }
+    }
+
+    void rpc_engine::on_recv_request(message_ptr& msg, int delay_ms)
+    {
+        rpc_handler_ptr handler = find_handler(msg->header());
+
         if (handler != nullptr)
         {
             msg->header().local_rpc_code = (uint16_t)handler->code;
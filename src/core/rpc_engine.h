@@ -29,6 +29,8 @@
 # include <dsn/internal/network.h>
 # include <dsn/internal/synchronize.h>
 # include <dsn/internal/global_config.h>
+# include <atomic>
+# include <memory>
 
 namespace dsn {
 
@@ -55,6 +57,9 @@ public:
     void call(message_ptr& request, rpc_response_task_ptr& call);
     void on_recv_request(message_ptr& msg, int delay_ms);
     static void reply(message_ptr& response);
+
+    // rpc name of the given wire code, "" when it is unknown or shared by several rpcs
+    const char* get_rpc_name_by_wire_code(uint32_t code);
     
     //
     // information inquery
@@ -64,6 +69,8 @@ public:
 
 private:
     network* create_network(const network_server_config& netcs, bool client_only);
+    rpc_handler_ptr find_handler(message_header& hdr);
+    void rebuild_code_table(); // under write lock of _handlers_lock
 
 private:
     configuration_ptr                     _config;    
@@ -75,6 +82,32 @@ private:
     typedef std::unordered_map<std::string, rpc_handler_ptr> rpc_handlers;
     rpc_handlers                  _handlers;
     utils::rw_lock_nr             _handlers_lock;
+
+    //
+    // flat open-addressing table from rpc_wire_code to rpc task code and handler for
+    // lock-free dispatch, immutable after published and replaced as a whole upon
+    // (un)registration; readers hold a reference so superseded tables are freed
+    // once the last one is done; _handlers remains the slow path for messages
+    // without a (known) wire code
+    //
+    struct rpc_code_entry
+    {
+        uint32_t        code;      // 0 for empty slot
+        int             task_code; // -1 when different rpc names share the same code
+        rpc_handler_ptr handler;   // null when the rpc is not registered here
+    };
+
+    struct rpc_code_table
+    {
+        std::vector<rpc_code_entry> entries; // size is power of 2
+        uint32_t                    mask;
+        int                         max_task_code; // task codes known when the table is built
+    };
+
+    typedef std::shared_ptr<const rpc_code_table> rpc_code_table_ptr;
+    const rpc_code_entry* find_code_entry(const rpc_code_table_ptr& tbl, uint32_t code);
+
+    rpc_code_table_ptr            _code_table; // accessed with std::atomic_load/store
     
     bool                          _is_running;
 
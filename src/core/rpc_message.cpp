@@ -77,10 +77,10 @@ void message_header::new_rpc_id()
 
 std::atomic<uint64_t> message::_id(0);
 
-message::message()
+message::message(int reserved_buffer_size)
 {
     _reader = nullptr;
-    _writer = new binary_writer();
+    _writer = new binary_writer(reserved_buffer_size);
 
     memset(&_msg_header, 0, MSG_HDR_SERIALIZED_SIZE);
     _msg_header.hdr_crc32 = _msg_header.body_crc32 = CRC_INVALID;
@@ -121,9 +121,9 @@ message::~message()
     }
 }
                 
-message_ptr message::create_request(task_code rpc_code, int timeout_milliseconds, int hash)
+message_ptr message::create_request(task_code rpc_code, int timeout_milliseconds, int hash, int reserved_buffer_size)
 {
-    message_ptr msg(new message());
+    message_ptr msg(new message(reserved_buffer_size));
     msg->header().local_rpc_code = (uint16_t)rpc_code;
     msg->header().client.hash = hash;
     if (timeout_milliseconds == 0)
@@ -136,6 +136,7 @@ message_ptr message::create_request(task_code rpc_code, int timeout_milliseconds
     }    
 
     strcpy(msg->header().rpc_name, rpc_code.to_string());
+    msg->header().rpc_wire_code = task_spec::get(rpc_code)->rpc_wire_code;
 
     msg->header().id = message::new_id();
     return msg;
@@ -153,6 +154,7 @@ message_ptr message::create_response()
     
     strcpy(msg->header().rpc_name, _msg_header.rpc_name);
     strcat(msg->header().rpc_name, "_ACK");
+    msg->header().rpc_wire_code = task_spec::get(msg->header().local_rpc_code)->rpc_wire_code;
 
     msg->header().from_address = _msg_header.to_address;
     msg->header().to_address = _msg_header.from_address;
@@ -254,8 +256,9 @@ bool message::is_right_body() const
     dassert  (is_read(), "message must be of read mode");
     if (_msg_header.body_crc32 != CRC_INVALID)
     {
+        // the body is at the end of the buffer, which may or may not start with a NET_HDR_DSN header
         blob bb = _reader->get_buffer();
-        return (uint32_t)_msg_header.body_crc32 == crc32::compute((char*)bb.data() + MSG_HDR_SERIALIZED_SIZE, _msg_header.body_length, 0);
+        return (uint32_t)_msg_header.body_crc32 == crc32::compute((char*)bb.data() + bb.length() - _msg_header.body_length, _msg_header.body_length, 0);
     }
 
     // crc is not enabled
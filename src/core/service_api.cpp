@@ -471,6 +471,69 @@ namespace dsn
                 tsk->node()->disk()->write(callback);
             }
 
+            static void prepare_vector(handle_t hFile, const file_buffer* buffers, int buffer_count, uint64_t offset, aio_task_ptr& callback)
+            {
+                auto aio = callback->aio();
+                aio->buffers.assign(buffers, buffers + buffer_count);
+                aio->buffer = nullptr;
+                aio->buffer_size = 0;
+                for (int i = 0; i < buffer_count; i++)
+                {
+                    aio->buffer_size += buffers[i].size;
+                }
+                aio->engine = nullptr;
+                aio->file = hFile;
+                aio->file_offset = offset;
+            }
+
+            void read_vector(handle_t hFile, const file_buffer* buffers, int buffer_count, uint64_t offset, aio_task_ptr& callback)
+            {
+                auto tsk = task::get_current_task();
+                dassert(tsk != nullptr, "this function can only be invoked inside tasks");
+
+                prepare_vector(hFile, buffers, buffer_count, offset, callback);
+                callback->aio()->type = AIO_Read;
+
+                tsk->node()->disk()->read_vector(callback);
+            }
+
+            void write_vector(handle_t hFile, const file_buffer* buffers, int buffer_count, uint64_t offset, aio_task_ptr& callback)
+            {
+                auto tsk = task::get_current_task();
+                dassert(tsk != nullptr, "this function can only be invoked inside tasks");
+
+                prepare_vector(hFile, buffers, buffer_count, offset, callback);
+                callback->aio()->type = AIO_Write;
+
+                tsk->node()->disk()->write_vector(callback);
+            }
+
+            void write_vector_and_sync(handle_t hFile, const file_buffer* buffers, int buffer_count, uint64_t offset, aio_task_ptr& callback)
+            {
+                auto tsk = task::get_current_task();
+                dassert(tsk != nullptr, "this function can only be invoked inside tasks");
+
+                prepare_vector(hFile, buffers, buffer_count, offset, callback);
+                callback->aio()->type = AIO_Write;
+
+                tsk->node()->disk()->write_vector_and_sync(callback);
+            }
+
+            void sync(handle_t hFile, aio_task_ptr& callback)
+            {
+                auto tsk = task::get_current_task();
+                dassert(tsk != nullptr, "this function can only be invoked inside tasks");
+
+                callback->aio()->buffer = nullptr;
+                callback->aio()->buffer_size = 0;
+                callback->aio()->engine = nullptr;
+                callback->aio()->file = hFile;
+                callback->aio()->file_offset = 0;
+                callback->aio()->type = AIO_Sync;
+
+                tsk->node()->disk()->sync(callback);
+            }
+
             error_code close(handle_t hFile)
             {
                 auto tsk = task::get_current_task();
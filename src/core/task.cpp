@@ -70,6 +70,8 @@ task::task(task_code code, int hash, service_node* node)
     _delay_milliseconds = 0;
     _wait_for_cancel = false;
     _is_null = false;
+    _task_queue_wheel = nullptr;
+    _task_queue_wheel_tick = 0;
     
     if (node != nullptr)
     {
@@ -295,6 +297,11 @@ bool task::cancel(bool wait_until_finished, /*out*/ bool* finished /*= nullptr*/
     {
         spec().on_task_cancelled.execute(this);
         signal_waiters();
+
+        // release the delayed task from the timer wheel right away instead of
+        // waiting for its expiration, this may drop the last ref so *this*
+        // must not be touched afterwards
+        _node->computation()->wheel()->cancel(this);
     }
 
     if (finished)
@@ -303,6 +310,19 @@ bool task::cancel(bool wait_until_finished, /*out*/ bool* finished /*= nullptr*/
     return succ;
 }
 
+bool task::reset_cancelled()
+{
+    if (_state.load() != TASK_STATE_CANCELLED
+        || ref_counter.load() != 1
+        || _wait_event.load() != nullptr
+        || _task_queue_wheel != nullptr)
+        return false;
+
+    _delay_milliseconds = 0;
+    _state.store(TASK_STATE_READY);
+    return true;
+}
+
 const char* task::node_name() const
 {
     return node()->name();
@@ -53,6 +53,18 @@ task_spec* task_spec::get(int code)
     return dsn::utils::singleton_vector_store<task_spec*, nullptr>::instance().get(code);
 }
 
+/*static*/ uint32_t task_spec::get_rpc_wire_code(const char* rpc_name)
+{
+    // FNV-1a, table-free as task specs are created during static initialization
+    uint32_t h = 2166136261u;
+    for (const char* p = rpc_name; *p != '\0'; p++)
+    {
+        h ^= static_cast<uint8_t>(*p);
+        h *= 16777619u;
+    }
+    return h == 0 ? 1 : h;
+}
+
 task_spec::task_spec(int code, const char* name, task_type type, threadpool_code pool, int paired_code, task_priority pri)
     : code(code), name(name), type(type), pool_code(pool), rpc_paired_code(paired_code), priority(pri),
     on_task_enqueue((std::string(name) + std::string(".enqueue")).c_str()), 
@@ -85,6 +97,8 @@ task_spec::task_spec(int code, const char* name, task_type type, threadpool_code
         );
 
     rejection_handler = nullptr;
+    allow_work_stealing = false;
+    rpc_wire_code = get_rpc_wire_code(name);
 
     // TODO: config for following values
     rpc_call_channel = RPC_CHANNEL_TCP;
@@ -156,6 +170,7 @@ bool task_spec::init(configuration_ptr config)
             spec->fast_execution_in_network_thread =
                 ((spec->type == TASK_TYPE_RPC_RESPONSE || spec->type == TASK_TYPE_RPC_REQUEST)
                 && default_spec.fast_execution_in_network_thread);
+            spec->allow_work_stealing = default_spec.allow_work_stealing;
             spec->rpc_call_channel = default_spec.rpc_call_channel;
             spec->rpc_call_header_format = default_spec.rpc_call_header_format;
             spec->rpc_timeout_milliseconds = default_spec.rpc_timeout_milliseconds;
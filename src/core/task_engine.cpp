@@ -216,6 +216,7 @@ void task_worker_pool::get_runtime_info(const std::string& indent, const std::ve
 }
 
 task_engine::task_engine(service_node* node)
+    : _wheel(service_engine::instance().spec().timer_wheel_tick_milliseconds)
 {
     _is_running = false;
     _node = node;
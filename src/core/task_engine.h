@@ -30,6 +30,7 @@
 # include <dsn/internal/admission_controller.h>
 # include <dsn/internal/perf_counter.h>
 # include <dsn/internal/task_worker.h>
+# include "timer_wheel.h"
 
 namespace dsn {
 
@@ -90,10 +91,12 @@ public:
     bool is_started() const { return _is_running; }
 
     service_node* node() const { return _node; }
+    timer_wheel* wheel() { return &_wheel; }
     void get_runtime_info(const std::string& indent, const std::vector<std::string>& args, __out_param std::stringstream& ss);
     
 private:
     std::vector<task_worker_pool*> _pools;
+    timer_wheel                  _wheel;
     volatile bool                _is_running;
     service_node*                 _node;
 };
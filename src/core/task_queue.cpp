@@ -41,4 +41,16 @@ task_queue::task_queue(task_worker_pool* pool, int index, task_queue* inner_prov
     _name = pool->spec().name + '.';
     _name.append(num);
 }
+
+int task_queue::dequeue_batch(task** tasks, int max_count)
+{
+    tasks[0] = dequeue();
+    return tasks[0] != nullptr ? 1 : 0;
+}
+
+void task_queue::enqueue_delayed(task* task)
+{
+    _pool->engine()->wheel()->add(task);
+}
+
 }
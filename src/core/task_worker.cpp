@@ -313,15 +313,32 @@ void task_worker::run_internal()
 void task_worker::loop()
 {
     task_queue* q = queue();
+    int batch_size = pool_spec().dequeue_batch_size;
 
     //try {
-        while (_is_running)
+        if (batch_size > 1)
         {
-            task* task = q->dequeue();
-            if (task != nullptr)
+            std::vector<task*> tasks(batch_size);
+            while (_is_running)
             {
-                task->exec_internal();
-                task->release_ref();
+                int count = q->dequeue_batch(&tasks[0], batch_size);
+                for (int i = 0; i < count; i++)
+                {
+                    tasks[i]->exec_internal();
+                    tasks[i]->release_ref();
+                }
+            }
+        }
+        else
+        {
+            while (_is_running)
+            {
+                task* task = q->dequeue();
+                if (task != nullptr)
+                {
+                    task->exec_internal();
+                    task->release_ref();
+                }
             }
         }
     /*}
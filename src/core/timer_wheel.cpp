@@ -0,0 +1,249 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+# include "timer_wheel.h"
+
+# ifdef __TITLE__
+# undef __TITLE__
+# endif
+# define __TITLE__ "timer_wheel"
+
+namespace dsn {
+
+timer_wheel::timer_wheel(int tick_milliseconds)
+    : _tick_milliseconds(tick_milliseconds > 0 ? tick_milliseconds : 1)
+{
+    _start = std::chrono::steady_clock::now();
+    _current_tick = 0;
+    _count = 0;
+    _thread = nullptr;
+    _is_running = false;
+}
+
+timer_wheel::~timer_wheel()
+{
+    stop();
+}
+
+void timer_wheel::stop()
+{
+    if (_thread != nullptr)
+    {
+        _is_running = false;
+        _not_empty.notify();
+        _thread->join();
+        delete _thread;
+        _thread = nullptr;
+    }
+}
+
+uint64_t timer_wheel::now_tick() const
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - _start
+        ).count();
+    return (uint64_t)elapsed / _tick_milliseconds;
+}
+
+void timer_wheel::add(task* t)
+{
+    dassert(t->delay_milliseconds() > 0, "only delayed tasks are put into the timer wheel");
+
+    uint64_t ticks = (t->delay_milliseconds() + _tick_milliseconds - 1) / _tick_milliseconds;
+    t->_task_queue_wheel_tick = now_tick() + ticks;
+    t->set_delay(0);
+
+    bool was_empty;
+    {
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
+        if (_thread == nullptr)
+        {
+            _is_running = true;
+            _thread = new std::thread([this](){ run(); });
+        }
+
+        was_empty = (_count == 0);
+        t->_task_queue_wheel = this;
+        insert(t);
+        _count++;
+    }
+
+    if (was_empty)
+    {
+        _not_empty.notify();
+    }
+}
+
+bool timer_wheel::cancel(task* t)
+{
+    {
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
+        if (t->_task_queue_wheel != this)
+            return false;
+
+        t->_task_queue_dl.remove();
+        t->_task_queue_wheel = nullptr;
+        _count--;
+    }
+
+    // to consume the added ref count by task::enqueue
+    t->release_ref();
+    return true;
+}
+
+void timer_wheel::insert(task* t)
+{
+    uint64_t expires = t->_task_queue_wheel_tick;
+    dlink* slot;
+
+    if (expires < _current_tick)
+    {
+        // already expired, fire on the next tick
+        slot = &_root[_current_tick & ROOT_MASK];
+    }
+    else if (expires - _current_tick < ROOT_SIZE)
+    {
+        slot = &_root[expires & ROOT_MASK];
+    }
+    else
+    {
+        uint64_t delta = expires - _current_tick;
+        int level = 0;
+        while (level < LEVEL_COUNT - 1 && delta >= (1ULL << (ROOT_BITS + (level + 1) * LEVEL_BITS)))
+        {
+            level++;
+        }
+
+        uint64_t max_delta = (1ULL << (ROOT_BITS + LEVEL_COUNT * LEVEL_BITS)) - 1;
+        if (delta > max_delta)
+        {
+            expires = _current_tick + max_delta;
+            t->_task_queue_wheel_tick = expires;
+        }
+
+        slot = &_levels[level][(expires >> (ROOT_BITS + level * LEVEL_BITS)) & LEVEL_MASK];
+    }
+
+    t->_task_queue_dl.insert_before(slot);
+}
+
+int timer_wheel::cascade(int level, int index)
+{
+    dlink pending;
+    dlink& slot = _levels[level][index];
+    while (!slot.is_alone())
+    {
+        dlink* n = slot.next();
+        n->remove();
+        n->insert_before(&pending);
+    }
+
+    while (!pending.is_alone())
+    {
+        dlink* n = pending.next();
+        n->remove();
+        insert(CONTAINING_RECORD(n, task, _task_queue_dl));
+    }
+
+    return index;
+}
+
+void timer_wheel::advance(uint64_t target_tick, dlink& expired)
+{
+    if (_count == 0)
+    {
+        if (_current_tick <= target_tick)
+            _current_tick = target_tick + 1;
+        return;
+    }
+
+    while (_current_tick <= target_tick)
+    {
+        int index = (int)(_current_tick & ROOT_MASK);
+        if (index == 0)
+        {
+            for (int level = 0; level < LEVEL_COUNT; level++)
+            {
+                int upper = (int)((_current_tick >> (ROOT_BITS + level * LEVEL_BITS)) & LEVEL_MASK);
+                if (cascade(level, upper) != 0)
+                    break;
+            }
+        }
+
+        _current_tick++;
+
+        dlink& slot = _root[index];
+        while (!slot.is_alone())
+        {
+            dlink* n = slot.next();
+            n->remove();
+            CONTAINING_RECORD(n, task, _task_queue_dl)->_task_queue_wheel = nullptr;
+            n->insert_before(&expired);
+            _count--;
+        }
+    }
+}
+
+void timer_wheel::run()
+{
+    while (_is_running)
+    {
+        bool is_empty;
+        {
+            utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
+            is_empty = (_count == 0);
+        }
+
+        if (is_empty)
+        {
+            _not_empty.wait();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(_tick_milliseconds));
+        }
+
+        dlink expired;
+        {
+            uint64_t target = now_tick();
+            utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
+            advance(target, expired);
+        }
+
+        while (!expired.is_alone())
+        {
+            dlink* n = expired.next();
+            n->remove();
+
+            task* t = CONTAINING_RECORD(n, task, _task_queue_dl);
+            t->enqueue();
+
+            // to consume the added ref count by another task::enqueue
+            t->release_ref();
+        }
+    }
+}
+
+} // end namespace
@@ -0,0 +1,102 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+# pragma once
+
+# include <dsn/internal/task.h>
+# include <dsn/internal/synchronize.h>
+# include <thread>
+# include <chrono>
+
+namespace dsn {
+
+//
+// a hierarchical timing wheel (as in the linux kernel) for delayed tasks
+// on one service node, so that a delayed enqueue and its cancellation
+// are both O(1) and allocation free. The tasks are linked through
+// task::_task_queue_dl, which is not used by any task queue until they
+// expire. The first level has 256 slots of one tick each, and the 4 upper
+// levels have 64 slots each, covering 2^32 ticks in total; larger delays
+// are clamped.
+//
+class timer_wheel
+{
+public:
+    timer_wheel(int tick_milliseconds);
+    virtual ~timer_wheel();
+
+    // the caller has added a ref to the task and set a positive delay;
+    // the delay is reset to 0 and task::enqueue is called again on
+    // expiration, after which the ref is released
+    void add(task* t);
+
+    // remove a cancelled task from the wheel and release the ref
+    // held by the wheel, return false when it is not in the wheel
+    bool cancel(task* t);
+
+    int  count() const { return _count; }
+
+    // stop the tick thread, tasks left in the wheel are not fired
+    void stop();
+
+protected:
+    // ticks since the wheel is created, virtual for tests
+    virtual uint64_t now_tick() const;
+
+private:
+    enum
+    {
+        ROOT_BITS   = 8,
+        ROOT_SIZE   = 1 << ROOT_BITS,
+        ROOT_MASK   = ROOT_SIZE - 1,
+        LEVEL_BITS  = 6,
+        LEVEL_SIZE  = 1 << LEVEL_BITS,
+        LEVEL_MASK  = LEVEL_SIZE - 1,
+        LEVEL_COUNT = 4
+    };
+
+    void     run();
+
+    // below are called with _lock held
+    void     insert(task* t);
+    int      cascade(int level, int index);
+    void     advance(uint64_t target_tick, dlink& expired);
+
+private:
+    int                               _tick_milliseconds;
+    std::chrono::steady_clock::time_point _start;
+
+    ::dsn::utils::ex_lock_nr_spin     _lock;
+    dlink                             _root[ROOT_SIZE];
+    dlink                             _levels[LEVEL_COUNT][LEVEL_SIZE];
+    uint64_t                          _current_tick; // next tick to be expired
+    int                               _count;
+
+    std::thread*                      _thread;
+    volatile bool                     _is_running;
+    ::dsn::utils::notify_event        _not_empty;
+};
+
+} // end namespace
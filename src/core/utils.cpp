@@ -210,6 +210,189 @@ namespace dsn {
 
             sprintf(str, "%02u:%02u:%02u.%03u", hr, min, sc, ms);
         }
+
+        //
+        // lz4 block format: a sequence of (token, literals, offset, match length),
+        // where the last sequence carries literals only
+        //
+        # define LZ4_MIN_MATCH      4
+        # define LZ4_LAST_LITERALS  5   // the last bytes are always literals
+        # define LZ4_MF_LIMIT       12  // no match may start in the last bytes
+        # define LZ4_MAX_DISTANCE   65535
+        # define LZ4_HASH_LOG       12
+
+        static inline uint32_t lz4_read32(const uint8_t* p)
+        {
+            uint32_t v;
+            memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        static inline uint32_t lz4_hash(uint32_t v)
+        {
+            return (v * 2654435761U) >> (32 - LZ4_HASH_LOG);
+        }
+
+        static inline uint8_t* lz4_write_length(uint8_t* op, int len)
+        {
+            while (len >= 255)
+            {
+                *op++ = 255;
+                len -= 255;
+            }
+            *op++ = static_cast<uint8_t>(len);
+            return op;
+        }
+
+        static inline uint8_t* lz4_write_literals(uint8_t* op, const uint8_t* literals, int len, uint8_t** token)
+        {
+            *token = op++;
+            **token = static_cast<uint8_t>((len >= 15 ? 15 : len) << 4);
+            if (len >= 15) op = lz4_write_length(op, len - 15);
+            memcpy(op, literals, len);
+            return op + len;
+        }
+
+        int lz4_compress_bound(int size)
+        {
+            return size + size / 255 + 16;
+        }
+
+        int lz4_compress(const char* src, int size, char* dst, int capacity)
+        {
+            if (size < 0 || capacity < lz4_compress_bound(size))
+                return 0;
+
+            const uint8_t* base = (const uint8_t*)src;
+            const uint8_t* end = base + size;
+            const uint8_t* ip = base;
+            const uint8_t* anchor = base;
+            uint8_t* op = (uint8_t*)dst;
+            uint8_t* token;
+
+            if (size >= LZ4_MF_LIMIT)
+            {
+                const uint8_t* mf_limit = end - LZ4_MF_LIMIT;
+                const uint8_t* match_limit = end - LZ4_LAST_LITERALS;
+                int table[1 << LZ4_HASH_LOG];
+                memset(table, 0xff, sizeof(table));
+
+                while (ip <= mf_limit)
+                {
+                    uint32_t h = lz4_hash(lz4_read32(ip));
+                    int ref = table[h];
+                    table[h] = static_cast<int>(ip - base);
+
+                    if (ref < 0 || ip - (base + ref) > LZ4_MAX_DISTANCE || lz4_read32(base + ref) != lz4_read32(ip))
+                    {
+                        ip++;
+                        continue;
+                    }
+
+                    const uint8_t* mp = base + ref;
+                    while (ip > anchor && mp > base && ip[-1] == mp[-1])
+                    {
+                        ip--;
+                        mp--;
+                    }
+
+                    const uint8_t* p = ip + LZ4_MIN_MATCH;
+                    const uint8_t* q = mp + LZ4_MIN_MATCH;
+                    while (p < match_limit && *p == *q)
+                    {
+                        p++;
+                        q++;
+                    }
+
+                    op = lz4_write_literals(op, anchor, static_cast<int>(ip - anchor), &token);
+
+                    int offset = static_cast<int>(ip - mp);
+                    *op++ = static_cast<uint8_t>(offset & 0xff);
+                    *op++ = static_cast<uint8_t>(offset >> 8);
+
+                    int match_len = static_cast<int>(p - ip) - LZ4_MIN_MATCH;
+                    *token |= static_cast<uint8_t>(match_len >= 15 ? 15 : match_len);
+                    if (match_len >= 15) op = lz4_write_length(op, match_len - 15);
+
+                    ip = p;
+                    anchor = p;
+                }
+            }
+
+            op = lz4_write_literals(op, anchor, static_cast<int>(end - anchor), &token);
+            return static_cast<int>(op - (uint8_t*)dst);
+        }
+
+        int lz4_decompress(const char* src, int size, char* dst, int capacity)
+        {
+            if (size <= 0 || capacity < 0)
+                return -1;
+
+            const uint8_t* ip = (const uint8_t*)src;
+            const uint8_t* iend = ip + size;
+            uint8_t* op = (uint8_t*)dst;
+            uint8_t* oend = op + capacity;
+
+            while (ip < iend)
+            {
+                uint8_t token = *ip++;
+
+                // lengths are bounded by the capacity before they may overflow
+                int len = token >> 4;
+                if (len == 15)
+                {
+                    uint8_t b;
+                    do
+                    {
+                        if (ip >= iend || len > capacity) return -1;
+                        b = *ip++;
+                        len += b;
+                    } while (b == 255);
+                }
+
+                if (len > iend - ip || len > oend - op)
+                    return -1;
+                memcpy(op, ip, len);
+                op += len;
+                ip += len;
+
+                // the last sequence has no match
+                if (ip == iend)
+                    break;
+
+                if (iend - ip < 2)
+                    return -1;
+                int offset = ip[0] | (ip[1] << 8);
+                ip += 2;
+                if (offset == 0 || offset > op - (uint8_t*)dst)
+                    return -1;
+
+                len = token & 15;
+                if (len == 15)
+                {
+                    uint8_t b;
+                    do
+                    {
+                        if (ip >= iend || len > capacity) return -1;
+                        b = *ip++;
+                        len += b;
+                    } while (b == 255);
+                }
+                len += LZ4_MIN_MATCH;
+
+                if (len > oend - op)
+                    return -1;
+
+                // byte by byte as the match may overlap the output
+                const uint8_t* mp = op - offset;
+                for (int i = 0; i < len; i++)
+                {
+                    *op++ = *mp++;
+                }
+            }
+
+            return static_cast<int>(op - (uint8_t*)dst);
+        }
     }
 }
 
@@ -249,7 +432,7 @@ namespace  dsn
         if (0 == read(len))
             return 0;
 
-        if (len <= get_remaining_size())
+        if (len >= 0 && len <= get_remaining_size())
         {
             blob = _blob.range(static_cast<int>(_ptr - _blob.data()), len);
             _ptr += len;
@@ -589,6 +772,48 @@ namespace  dsn
         _total_size += sz0;
     }
 
+    void binary_writer::write_shared(const blob& val)
+    {
+        if (val.length() < _reserved_size_per_buffer_static)
+        {
+            if (val.length() > 0) write(val.data(), val.length());
+            return;
+        }
+
+# ifdef _DEBUG
+        sanity_check();
+# endif
+
+        if (_cur_is_placeholder)
+        {
+            create_buffer_and_writer();
+            _cur_is_placeholder = false;
+        }
+
+        // cut the unused tail off the current buffer, and continue
+        // writing into it after the shared blob
+        blob tail = _buffers[_cur_pos].range(_data[_cur_pos].length());
+        _buffers[_cur_pos]._length = _data[_cur_pos].length();
+
+        _buffers.push_back(val);
+        _data.push_back(val);
+        ++_cur_pos;
+
+        if (tail.length() > 0)
+        {
+            _buffers.push_back(tail);
+            tail._length = 0;
+            _data.push_back(tail);
+            ++_cur_pos;
+        }
+
+# ifdef _DEBUG
+        sanity_check();
+# endif
+
+        _total_size += val.length();
+    }
+
     bool binary_writer::next(void** data, int* size)
     {
         int sz = _buffers[_cur_pos].length() - _data[_cur_pos].length();
@@ -175,6 +175,79 @@ namespace dsn {
                 return std::move(tsk);
             }
 
+            aio_task_ptr read_vector(
+                handle_t hFile,
+                const file_buffer* buffers,
+                int buffer_count,
+                uint64_t offset,
+                task_code callback_code,
+                servicelet* owner,
+                aio_handler callback,
+                int hash /*= 0*/
+                )
+            {
+                aio_task_ptr tsk(callback != nullptr ?
+                    static_cast<aio_task*>(new internal_use_only::service_aio_task(callback_code, owner, callback, hash))
+                    : static_cast<aio_task*>(new aio_task_empty(callback_code, hash))
+                    );
+                read_vector(hFile, buffers, buffer_count, offset, tsk);
+                return std::move(tsk);
+            }
+
+            aio_task_ptr write_vector(
+                handle_t hFile,
+                const file_buffer* buffers,
+                int buffer_count,
+                uint64_t offset,
+                task_code callback_code,
+                servicelet* owner,
+                aio_handler callback,
+                int hash /*= 0*/
+                )
+            {
+                aio_task_ptr tsk(callback != nullptr ?
+                    static_cast<aio_task*>(new internal_use_only::service_aio_task(callback_code, owner, callback, hash))
+                    : static_cast<aio_task*>(new aio_task_empty(callback_code, hash))
+                    );
+                write_vector(hFile, buffers, buffer_count, offset, tsk);
+                return std::move(tsk);
+            }
+
+            aio_task_ptr write_vector_and_sync(
+                handle_t hFile,
+                const file_buffer* buffers,
+                int buffer_count,
+                uint64_t offset,
+                task_code callback_code,
+                servicelet* owner,
+                aio_handler callback,
+                int hash /*= 0*/
+                )
+            {
+                aio_task_ptr tsk(callback != nullptr ?
+                    static_cast<aio_task*>(new internal_use_only::service_aio_task(callback_code, owner, callback, hash))
+                    : static_cast<aio_task*>(new aio_task_empty(callback_code, hash))
+                    );
+                write_vector_and_sync(hFile, buffers, buffer_count, offset, tsk);
+                return std::move(tsk);
+            }
+
+            aio_task_ptr sync(
+                handle_t hFile,
+                task_code callback_code,
+                servicelet* owner,
+                aio_handler callback,
+                int hash /*= 0*/
+                )
+            {
+                aio_task_ptr tsk(callback != nullptr ?
+                    static_cast<aio_task*>(new internal_use_only::service_aio_task(callback_code, owner, callback, hash))
+                    : static_cast<aio_task*>(new aio_task_empty(callback_code, hash))
+                    );
+                sync(hFile, tsk);
+                return std::move(tsk);
+            }
+
 
             aio_task_ptr copy_remote_files(
                 const end_point& remote,
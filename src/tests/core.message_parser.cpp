@@ -0,0 +1,319 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+# include <dsn/internal/message_parser.h>
+# include "rpc_engine.h"
+# include "service_engine.h"
+# include "test_harness.h"
+# include <gtest/gtest.h>
+# include <limits>
+# ifdef DSN_NOT_USE_DEFAULT_SERIALIZATION
+# include <dsn/thrift_helper.h>
+# endif
+
+using namespace ::dsn;
+
+DEFINE_TASK_CODE_RPC(RPC_TEST_MESSAGE_PARSER, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+TEST(core, compact_varint_codec)
+{
+    uint64_t values[] = { 0, 1, 127, 128, 300, 16383, 16384, 0xffffffffULL, 1ULL << 63, std::numeric_limits<uint64_t>::max() };
+    for (auto v : values)
+    {
+        char buffer[16];
+        char* end = compact_message_parser::write_varint(buffer, v);
+        EXPECT_TRUE(end - buffer <= 10);
+
+        uint64_t v2;
+        EXPECT_EQ(end, compact_message_parser::read_varint(buffer, end, v2));
+        EXPECT_EQ(v, v2);
+
+        // truncated input
+        EXPECT_TRUE(nullptr == compact_message_parser::read_varint(buffer, end - 1, v2));
+    }
+
+    // no terminating byte within 64 bits
+    char overlong[11];
+    memset(overlong, 0xff, sizeof(overlong));
+    uint64_t v;
+    EXPECT_TRUE(nullptr == compact_message_parser::read_varint(overlong, overlong + sizeof(overlong), v));
+
+    int32_t ivalues[] = { 0, 1, -1, 63, -64, 5000, std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::min() };
+    for (auto i : ivalues)
+    {
+        EXPECT_EQ(i, compact_message_parser::zigzag_decode(compact_message_parser::zigzag_encode(i)));
+    }
+    EXPECT_EQ(1u, compact_message_parser::zigzag_encode(-1));
+    EXPECT_EQ(2u, compact_message_parser::zigzag_encode(1));
+}
+
+// feed the data into the parser in chunks of at most chunk_size bytes
+static std::vector<message_ptr> feed_parser(message_parser& parser, const std::string& data, int chunk_size, __out_param int& read_next)
+{
+    std::vector<message_ptr> msgs;
+    size_t offset = 0;
+    read_next = 1;
+    while (offset < data.length() && read_next >= 0)
+    {
+        void* ptr = parser.read_buffer_ptr(read_next);
+        int sz = std::min(std::min(parser.read_buffer_capacity(), chunk_size), static_cast<int>(data.length() - offset));
+        memcpy(ptr, data.c_str() + offset, sz);
+        offset += sz;
+
+        message_ptr msg = parser.get_message_on_receive(sz, read_next);
+        while (msg != nullptr)
+        {
+            msgs.push_back(msg);
+            msg = parser.get_message_on_receive(0, read_next);
+        }
+    }
+    return msgs;
+}
+
+static std::string serialize(message_parser& parser, message_ptr& msg)
+{
+    std::vector<blob> buffers;
+    parser.prepare_buffers_for_send(msg, buffers);
+
+    std::string data;
+    for (auto& b : buffers)
+        data.append(b.data(), b.length());
+    return data;
+}
+
+TEST(core, compact_message_parser)
+{
+    message_ptr request = message::create_request(RPC_TEST_MESSAGE_PARSER, 1000, -3);
+    request->header().client.port = 34601;
+    request->writer().write(std::string("hello compact"));
+    request->seal(true);
+
+    compact_message_parser sender(4096);
+    std::string data = serialize(sender, request);
+    EXPECT_TRUE(data.length() < MSG_HDR_SERIALIZED_SIZE + request->header().body_length);
+
+    // two messages in a row, delivered in small pieces
+    data += data;
+    int chunk_sizes[] = { 1, 7, 4096 };
+    for (auto chunk_size : chunk_sizes)
+    {
+        compact_message_parser receiver(64);
+        int read_next;
+        auto msgs = feed_parser(receiver, data, chunk_size, read_next);
+        EXPECT_TRUE(read_next > 0);
+        ASSERT_EQ(2u, msgs.size());
+
+        for (auto& msg : msgs)
+        {
+            auto& h = msg->header();
+            EXPECT_EQ(request->header().rpc_wire_code, h.rpc_wire_code);
+            EXPECT_EQ(request->header().id, h.id);
+            EXPECT_EQ(request->header().rpc_id, h.rpc_id);
+            EXPECT_EQ(1000, h.client.timeout_ms);
+            EXPECT_EQ(-3, h.client.hash);
+            EXPECT_EQ(34601, h.client.port);
+            EXPECT_EQ(request->header().body_length, h.body_length);
+
+            // the name is resolved by the rpc engine upon dispatch
+            EXPECT_EQ(std::string(""), std::string(h.rpc_name));
+
+            std::string body;
+            msg->reader().read(body);
+            EXPECT_EQ(std::string("hello compact"), body);
+        }
+    }
+
+    // truncated message waits for more data
+    {
+        compact_message_parser receiver(64);
+        int read_next;
+        auto msgs = feed_parser(receiver, data.substr(0, data.length() / 2 - 1), 4096, read_next);
+        EXPECT_EQ(0u, msgs.size());
+        EXPECT_TRUE(read_next > 0);
+    }
+
+    // truncated header fields and oversized bodies are rejected
+    {
+        std::string bad = data.substr(0, sizeof(uint32_t));
+        bad.push_back(static_cast<char>(sizeof(uint32_t) + 3));
+        bad.push_back(0);
+        bad.push_back(static_cast<char>(0x80)); // body length never ends
+        compact_message_parser receiver(64);
+        int read_next;
+        EXPECT_EQ(0u, feed_parser(receiver, bad, 4096, read_next).size());
+        EXPECT_EQ(-1, read_next);
+
+        bad = data.substr(0, sizeof(uint32_t));
+        char hdr[16];
+        char* end = compact_message_parser::write_varint(hdr + 2, static_cast<uint64_t>(message_parser::MAX_BODY_LENGTH) + 1);
+        for (int i = 0; i < 6; i++)
+            *end++ = 0;
+        hdr[0] = static_cast<char>(sizeof(uint32_t) + (end - hdr));
+        hdr[1] = 0;
+        bad.append(hdr, end - hdr);
+        compact_message_parser receiver2(64);
+        EXPECT_EQ(0u, feed_parser(receiver2, bad, 4096, read_next).size());
+        EXPECT_EQ(-1, read_next);
+    }
+}
+
+TEST(core, dsn_message_parser)
+{
+    message_ptr request = message::create_request(RPC_TEST_MESSAGE_PARSER, 1000);
+    request->writer().write(std::string("hello dsn"));
+    request->seal(true);
+
+    dsn_message_parser sender(4096);
+    std::string data = serialize(sender, request);
+
+    dsn_message_parser receiver(64);
+    int read_next;
+    auto msgs = feed_parser(receiver, data, 5, read_next);
+    ASSERT_EQ(1u, msgs.size());
+    EXPECT_EQ(std::string(RPC_TEST_MESSAGE_PARSER.to_string()), std::string(msgs[0]->header().rpc_name));
+    EXPECT_EQ(request->header().rpc_wire_code, msgs[0]->header().rpc_wire_code);
+
+    // negative body length from the peer
+    ((message_header*)&data[0])->body_length = -MSG_HDR_SERIALIZED_SIZE;
+    dsn_message_parser receiver2(64);
+    EXPECT_EQ(0u, feed_parser(receiver2, data, 4096, read_next).size());
+    EXPECT_EQ(-1, read_next);
+}
+
+// prepare all the messages before copying any buffer out, as net_io does for
+// the messages it sends with one write
+static std::string serialize_batch(message_parser& parser, std::vector<message_ptr>& msgs)
+{
+    std::vector<blob> buffers, all_buffers;
+    for (auto& msg : msgs)
+    {
+        parser.prepare_buffers_for_send(msg, buffers);
+        all_buffers.insert(all_buffers.end(), buffers.begin(), buffers.end());
+    }
+
+    std::string data;
+    for (auto& b : all_buffers)
+        data.append(b.data(), b.length());
+    return data;
+}
+
+template<typename T>
+static void test_parser_batch(std::vector<message_ptr>& requests)
+{
+    T sender(4096);
+    std::string data = serialize_batch(sender, requests);
+
+    T receiver(64);
+    int read_next;
+    auto msgs = feed_parser(receiver, data, 4096, read_next);
+    EXPECT_TRUE(read_next > 0);
+    ASSERT_EQ(requests.size(), msgs.size());
+
+    for (size_t i = 0; i < msgs.size(); i++)
+    {
+        EXPECT_EQ(requests[i]->header().id, msgs[i]->header().id);
+        EXPECT_EQ(requests[i]->header().body_length, msgs[i]->header().body_length);
+    }
+}
+
+static std::vector<message_ptr> create_batch(int count)
+{
+    std::vector<message_ptr> requests;
+    for (int i = 0; i < count; i++)
+    {
+        message_ptr request = message::create_request(RPC_TEST_MESSAGE_PARSER, 1000, i);
+        request->writer().write(std::string(i * 10 + 1, 'a' + i));
+        request->seal(true);
+        requests.push_back(request);
+    }
+    return requests;
+}
+
+TEST(core, message_parser_batch)
+{
+    auto requests = create_batch(3);
+    test_parser_batch<dsn_message_parser>(requests);
+    test_parser_batch<compact_message_parser>(requests);
+
+    // the bodies of dsn and compact messages are intact as well
+    compact_message_parser sender(4096);
+    std::string data = serialize_batch(sender, requests);
+    compact_message_parser receiver(64);
+    int read_next;
+    auto msgs = feed_parser(receiver, data, 7, read_next);
+    ASSERT_EQ(requests.size(), msgs.size());
+    for (size_t i = 0; i < msgs.size(); i++)
+    {
+        std::string body;
+        msgs[i]->reader().read(body);
+        EXPECT_EQ(std::string(i * 10 + 1, static_cast<char>('a' + i)), body);
+    }
+}
+
+# ifdef DSN_NOT_USE_DEFAULT_SERIALIZATION
+
+TEST(core, thrift_message_parser_batch)
+{
+    // the thrift parser takes a message body to be a thrift struct, so
+    // the bodies are empty structs (T_STOP only)
+    std::vector<message_ptr> requests;
+    for (int i = 0; i < 3; i++)
+    {
+        message_ptr request = message::create_request(RPC_TEST_MESSAGE_PARSER, 1000, i);
+        char stop = static_cast<char>(::apache::thrift::protocol::T_STOP);
+        request->writer().write(&stop, 1);
+        request->seal(true);
+        requests.push_back(request);
+    }
+
+    thrift_binary_message_parser sender(4096);
+    std::string data = serialize_batch(sender, requests);
+
+    thrift_binary_message_parser receiver(64);
+    int read_next;
+    auto msgs = feed_parser(receiver, data, 4096, read_next);
+    ASSERT_EQ(requests.size(), msgs.size());
+    for (size_t i = 0; i < msgs.size(); i++)
+    {
+        // each message has its own header
+        EXPECT_EQ(requests[i]->header().id, msgs[i]->header().id);
+        EXPECT_EQ(std::string(RPC_TEST_MESSAGE_PARSER.to_string()), std::string(msgs[i]->header().rpc_name));
+    }
+}
+
+# endif
+
+TEST(core, rpc_name_by_wire_code)
+{
+    auto engine = dsn::test::test_node()->rpc();
+    auto code = task_spec::get(RPC_TEST_MESSAGE_PARSER)->rpc_wire_code;
+    EXPECT_EQ(std::string(RPC_TEST_MESSAGE_PARSER.to_string()), std::string(engine->get_rpc_name_by_wire_code(code)));
+
+    auto ack_code = task_spec::get(task_spec::get(RPC_TEST_MESSAGE_PARSER)->rpc_paired_code)->rpc_wire_code;
+    EXPECT_EQ(std::string(RPC_TEST_MESSAGE_PARSER.to_string()) + "_ACK", std::string(engine->get_rpc_name_by_wire_code(ack_code)));
+
+    EXPECT_EQ(std::string(""), std::string(engine->get_rpc_name_by_wire_code(task_spec::get_rpc_wire_code("RPC_NOT_DEFINED_ANYWHERE"))));
+}
@@ -0,0 +1,289 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+# include "timer_wheel.h"
+# include "test_harness.h"
+# include <gtest/gtest.h>
+# include <algorithm>
+# include <atomic>
+# include <thread>
+# include <chrono>
+
+using namespace ::dsn;
+
+DEFINE_TASK_CODE(LPC_TIMER_WHEEL_TEST, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+// the clock is driven by the test, so that delays of many ticks expire at once
+class test_timer_wheel : public timer_wheel
+{
+public:
+    test_timer_wheel() : timer_wheel(1), _now(0) {}
+    ~test_timer_wheel() { stop(); }
+
+    void set_now(uint64_t tick) { _now = tick; }
+
+protected:
+    virtual uint64_t now_tick() const { return _now.load(); }
+
+private:
+    std::atomic<uint64_t> _now;
+};
+
+// expired tasks are enqueued again by the wheel, which is recorded here
+// instead of being sent to a thread pool
+class wheel_test_task : public task
+{
+public:
+    wheel_test_task(int delay, std::vector<int>* fired, ::dsn::utils::ex_lock_nr_spin* lock)
+        : task(LPC_TIMER_WHEEL_TEST, 0, dsn::test::test_node()), _delay(delay), _fired(fired), _lock(lock), fire_count(0)
+    {
+    }
+
+    virtual void exec() {}
+
+    virtual void enqueue()
+    {
+        fire_count++;
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(*_lock);
+        _fired->push_back(_delay);
+    }
+
+    std::atomic<int> fire_count;
+
+private:
+    int                            _delay;
+    std::vector<int>*              _fired;
+    ::dsn::utils::ex_lock_nr_spin* _lock;
+};
+
+typedef ::boost::intrusive_ptr<wheel_test_task> wheel_test_task_ptr;
+
+static void add_task(timer_wheel& wheel, wheel_test_task_ptr& t, int delay)
+{
+    t->set_delay(delay);
+    t->add_ref(); // released by the wheel
+    wheel.add(t.get());
+}
+
+// wait for the tick thread to catch up with the clock
+static bool wait_fired(std::vector<int>& fired, ::dsn::utils::ex_lock_nr_spin& lock, size_t count)
+{
+    for (int i = 0; i < 2000; i++)
+    {
+        {
+            utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(lock);
+            if (fired.size() >= count)
+                return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+TEST(core, timer_wheel_expiry_order)
+{
+    // delays around the root level (256 ticks) and the first upper
+    // level (256 * 64 ticks), and one in the third level
+    int delays[] = { 70000, 16385, 5, 256, 16384, 255, 257, 300, 16383, 1, 20000, 1 << 20 };
+    const int count = static_cast<int>(sizeof(delays) / sizeof(delays[0]));
+
+    test_timer_wheel wheel;
+    std::vector<int> fired;
+    ::dsn::utils::ex_lock_nr_spin lock;
+    std::vector<wheel_test_task_ptr> tasks;
+    for (auto d : delays)
+    {
+        wheel_test_task_ptr t(new wheel_test_task(d, &fired, &lock));
+        add_task(wheel, t, d);
+        tasks.push_back(t);
+    }
+    EXPECT_EQ(count, wheel.count());
+
+    std::vector<int> sorted(delays, delays + count);
+    std::sort(sorted.begin(), sorted.end());
+
+    // nothing fires before its tick, everything fires at its tick
+    for (int i = 0; i < count; i++)
+    {
+        wheel.set_now(sorted[i] - 1);
+        ASSERT_TRUE(wait_fired(fired, lock, i));
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        {
+            utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(lock);
+            ASSERT_EQ(static_cast<size_t>(i), fired.size()) << "fired before tick " << sorted[i];
+        }
+
+        wheel.set_now(sorted[i]);
+        ASSERT_TRUE(wait_fired(fired, lock, i + 1)) << "not fired at tick " << sorted[i];
+    }
+
+    EXPECT_TRUE(sorted == fired);
+    EXPECT_EQ(0, wheel.count());
+    for (auto& t : tasks)
+    {
+        EXPECT_EQ(1, t->fire_count.load());
+        EXPECT_EQ(1, t->ref_counter.load());
+    }
+
+    // all at once, the order is kept while cascading in one step
+    fired.clear();
+    uint64_t now = 2 << 20;
+    wheel.set_now(now);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    tasks.clear();
+    for (auto d : delays)
+    {
+        wheel_test_task_ptr t(new wheel_test_task(d, &fired, &lock));
+        add_task(wheel, t, d);
+        tasks.push_back(t);
+    }
+    wheel.set_now(now + (1 << 20));
+    ASSERT_TRUE(wait_fired(fired, lock, count));
+    EXPECT_TRUE(sorted == fired);
+}
+
+TEST(core, timer_wheel_cancel)
+{
+    test_timer_wheel wheel;
+    std::vector<int> fired;
+    ::dsn::utils::ex_lock_nr_spin lock;
+
+    wheel_test_task_ptr t1(new wheel_test_task(10, &fired, &lock));
+    wheel_test_task_ptr t2(new wheel_test_task(20000, &fired, &lock));
+    wheel_test_task_ptr t3(new wheel_test_task(30, &fired, &lock));
+    add_task(wheel, t1, 10);
+    add_task(wheel, t2, 20000);
+    add_task(wheel, t3, 30);
+    EXPECT_EQ(3, wheel.count());
+
+    // the ref of the wheel is released on cancel
+    EXPECT_TRUE(wheel.cancel(t1.get()));
+    EXPECT_TRUE(wheel.cancel(t2.get()));
+    EXPECT_EQ(1, t1->ref_counter.load());
+    EXPECT_EQ(1, t2->ref_counter.load());
+    EXPECT_EQ(1, wheel.count());
+
+    // not in the wheel any more
+    EXPECT_FALSE(wheel.cancel(t1.get()));
+
+    wheel.set_now(100000);
+    ASSERT_TRUE(wait_fired(fired, lock, 1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ASSERT_EQ(1u, fired.size());
+    EXPECT_EQ(30, fired[0]);
+    EXPECT_EQ(0, t1->fire_count.load());
+    EXPECT_EQ(0, t2->fire_count.load());
+
+    // cannot cancel after fired
+    EXPECT_FALSE(wheel.cancel(t3.get()));
+    EXPECT_EQ(0, wheel.count());
+}
+
+TEST(core, timer_wheel_cancel_racing_with_fire)
+{
+    const int count = 10000;
+    test_timer_wheel wheel;
+    std::vector<int> fired;
+    ::dsn::utils::ex_lock_nr_spin lock;
+
+    std::vector<wheel_test_task_ptr> tasks;
+    for (int i = 0; i < count; i++)
+    {
+        wheel_test_task_ptr t(new wheel_test_task(i % 50 + 1, &fired, &lock));
+        add_task(wheel, t, i % 50 + 1);
+        tasks.push_back(t);
+    }
+
+    // fire in the tick thread while cancelling from here
+    std::thread clock([&wheel]()
+    {
+        for (int i = 1; i <= 50; i++)
+        {
+            wheel.set_now(i);
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    });
+
+    int cancelled = 0;
+    for (int i = count - 1; i >= 0; i--)
+    {
+        if (wheel.cancel(tasks[i].get()))
+            cancelled++;
+    }
+    clock.join();
+
+    // each task is either cancelled or fired, exactly once
+    ASSERT_TRUE(wait_fired(fired, lock, count - cancelled));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_EQ(static_cast<size_t>(count - cancelled), fired.size());
+    EXPECT_EQ(0, wheel.count());
+    for (auto& t : tasks)
+    {
+        EXPECT_TRUE(t->fire_count.load() <= 1);
+        EXPECT_EQ(1, t->ref_counter.load());
+    }
+}
+
+TEST(core, timer_wheel_rearm_after_idle)
+{
+    test_timer_wheel wheel;
+    std::vector<int> fired;
+    ::dsn::utils::ex_lock_nr_spin lock;
+
+    wheel_test_task_ptr t1(new wheel_test_task(5, &fired, &lock));
+    add_task(wheel, t1, 5);
+    wheel.set_now(5);
+    ASSERT_TRUE(wait_fired(fired, lock, 1));
+    EXPECT_EQ(0, wheel.count());
+
+    // the tick thread now waits for the next task
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    wheel.set_now(1000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    // delays count from the clock when added, and more than a whole root
+    // level may have passed while idle
+    wheel_test_task_ptr t2(new wheel_test_task(300, &fired, &lock));
+    wheel_test_task_ptr t3(new wheel_test_task(7, &fired, &lock));
+    add_task(wheel, t2, 300);
+    add_task(wheel, t3, 7);
+
+    wheel.set_now(1006);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    {
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(lock);
+        EXPECT_EQ(1u, fired.size());
+    }
+
+    wheel.set_now(1007);
+    ASSERT_TRUE(wait_fired(fired, lock, 2));
+    EXPECT_EQ(7, fired[1]);
+
+    wheel.set_now(1300);
+    ASSERT_TRUE(wait_fired(fired, lock, 3));
+    EXPECT_EQ(300, fired[2]);
+    EXPECT_EQ(0, wheel.count());
+}
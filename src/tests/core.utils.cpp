@@ -27,6 +27,7 @@
 # include <dsn/internal/utils.h>
 # include <dsn/internal/link.h>
 # include <gtest/gtest.h>
+# include <random>
 
 using namespace ::dsn;
 using namespace ::dsn::utils;
@@ -66,6 +67,37 @@ TEST(core, binary_io_with_pos)
     EXPECT_TRUE(value4 == value);
 }
 
+TEST(core, binary_io_with_shared_blob)
+{
+    std::shared_ptr<char> ptr((char*)malloc(1024));
+    memset(ptr.get(), 'x', 1024);
+    blob shared(ptr, 1024);
+
+    int value = 0xdeadbeef;
+    binary_writer writer(4096);
+    writer.write(value);
+    writer.write_shared(shared);
+    writer.write(value);
+
+    std::vector<blob> buffers;
+    writer.get_buffers(buffers);
+    EXPECT_EQ(buffers.size(), 3);
+    EXPECT_TRUE(buffers[1].data() == shared.data());
+    EXPECT_EQ(writer.total_size(), 1024 + 2 * (int)sizeof(int));
+
+    auto buf = writer.get_buffer();
+    binary_reader reader(buf);
+    int value2, value3;
+    char data[1024];
+    reader.read(value2);
+    reader.read(data, 1024);
+    reader.read(value3);
+
+    EXPECT_TRUE(value2 == value);
+    EXPECT_TRUE(value3 == value);
+    EXPECT_TRUE(memcmp(data, shared.data(), 1024) == 0);
+}
+
 TEST(core, split_args)
 {
     std::string value = "a ,b, c ";
@@ -93,6 +125,149 @@ TEST(core, trim_string)
     EXPECT_EQ(std::string(r), "x x x x");
 }
 
+TEST(core, lz4_compress)
+{
+    std::string inputs[] = {
+        "",
+        "abc",
+        std::string(1000, 'x'),
+        "the quick brown fox jumps over the lazy dog, the quick brown fox jumps over the lazy dog"
+    };
+
+    for (auto& input : inputs)
+    {
+        int size = static_cast<int>(input.length());
+        std::vector<char> compressed(lz4_compress_bound(size));
+        int csize = lz4_compress(input.c_str(), size, &compressed[0], static_cast<int>(compressed.size()));
+        EXPECT_TRUE(csize > 0);
+
+        std::vector<char> output(size + 1);
+        EXPECT_EQ(size, lz4_decompress(&compressed[0], csize, &output[0], size));
+        EXPECT_TRUE(std::string(&output[0], size) == input);
+
+        if (size > 0)
+        {
+            EXPECT_EQ(-1, lz4_decompress(&compressed[0], csize, &output[0], size - 1));
+        }
+    }
+
+    std::string repeated(1000, 'x');
+    std::vector<char> compressed(lz4_compress_bound(1000));
+    EXPECT_TRUE(lz4_compress(repeated.c_str(), 1000, &compressed[0], static_cast<int>(compressed.size())) < 100);
+}
+
+static void lz4_round_trip(const std::string& input)
+{
+    int size = static_cast<int>(input.length());
+    int bound = lz4_compress_bound(size);
+    std::vector<char> compressed(bound);
+    int csize = lz4_compress(input.data(), size, &compressed[0], bound);
+    ASSERT_TRUE(csize > 0 && csize <= bound) << "size = " << size;
+
+    std::vector<char> output(size + 1);
+    ASSERT_EQ(size, lz4_decompress(&compressed[0], csize, &output[0], size)) << "size = " << size;
+    EXPECT_TRUE(std::string(&output[0], size) == input) << "size = " << size;
+}
+
+TEST(core, lz4_compress_boundaries)
+{
+    std::mt19937 rng(20151017);
+
+    // around the minimal match and the last literals, 255 length steps and the 64KB window
+    int sizes[] = { 1, 4, 5, 11, 12, 13, 15, 16, 19, 254, 255, 256, 270, 271, 65535, 65536, 65537, 1024 * 1024 };
+    for (int size : sizes)
+    {
+        std::string random(size, '\0');
+        for (auto& c : random) c = static_cast<char>(rng());
+        lz4_round_trip(random);
+
+        std::string repeated(size, 'x');
+        lz4_round_trip(repeated);
+
+        // random segments repeated both within and beyond the 64KB window
+        std::string mixed(size, '\0');
+        for (int i = 0; i < size; i++)
+        {
+            mixed[i] = (i >= 4096 && (i / 1024) % 3 == 0) ? mixed[i - 4096 - (i / 65536) * 61440] : static_cast<char>(rng());
+        }
+        lz4_round_trip(mixed);
+    }
+
+    // incompressible input stays within the bound
+    std::string random(100000, '\0');
+    for (auto& c : random) c = static_cast<char>(rng());
+    std::vector<char> compressed(lz4_compress_bound(100000));
+    EXPECT_EQ(0, lz4_compress(random.data(), 100000, &compressed[0], lz4_compress_bound(100000) - 1));
+}
+
+TEST(core, lz4_decompress_corrupted)
+{
+    std::mt19937 rng(20151017);
+
+    std::string input;
+    for (int i = 0; i < 2000; i++)
+    {
+        input += "key" + std::to_string(rng() % 50) + "=value" + std::to_string(i % 7) + ";";
+    }
+    int size = static_cast<int>(input.length());
+    std::vector<char> compressed(lz4_compress_bound(size));
+    int csize = lz4_compress(input.data(), size, &compressed[0], static_cast<int>(compressed.size()));
+    ASSERT_TRUE(csize > 0 && csize < size);
+
+    // the guard after the capacity must never be written
+    const int guard = 64;
+    std::vector<char> output(size + guard);
+    auto check = [&](const char* src, int len, int capacity) -> int
+    {
+        memset(&output[0], 0x5a, output.size());
+        int r = lz4_decompress(src, len, &output[0], capacity);
+        EXPECT_TRUE(r >= -1 && r <= capacity);
+        int overrun = capacity;
+        while (overrun < static_cast<int>(output.size()) && output[overrun] == 0x5a)
+        {
+            overrun++;
+        }
+        EXPECT_EQ(static_cast<int>(output.size()), overrun) << "overrun at " << overrun;
+        return r;
+    };
+
+    // truncated input
+    for (int len = 0; len < csize; len++)
+    {
+        EXPECT_NE(size, check(&compressed[0], len, size));
+    }
+
+    // too small a capacity
+    EXPECT_EQ(-1, check(&compressed[0], csize, size / 2));
+
+    // random corruptions
+    for (int i = 0; i < 2000; i++)
+    {
+        std::vector<char> corrupted(compressed.begin(), compressed.begin() + csize);
+        int flips = 1 + rng() % 4;
+        for (int j = 0; j < flips; j++)
+        {
+            corrupted[rng() % csize] ^= static_cast<char>(1 + rng() % 255);
+        }
+        check(&corrupted[0], csize, size);
+    }
+
+    // a literal length growing past the capacity
+    std::vector<char> long_length(100000, static_cast<char>(0xff));
+    long_length[0] = static_cast<char>(0xf0);
+    EXPECT_EQ(-1, check(&long_length[0], static_cast<int>(long_length.size()), size));
+
+    // a zero offset, and an offset before the start of the output
+    char zero_offset[] = { 0x10, 'a', 0x00, 0x00, 0x00 };
+    EXPECT_EQ(-1, check(zero_offset, sizeof(zero_offset), size));
+    char far_offset[] = { 0x10, 'a', 0x02, 0x00, 0x00 };
+    EXPECT_EQ(-1, check(far_offset, sizeof(far_offset), size));
+
+    // an empty or negative input
+    EXPECT_EQ(-1, check(&compressed[0], 0, size));
+    EXPECT_EQ(-1, check(&compressed[0], -1, size));
+}
+
 TEST(core, dlink)
 {
     dlink links[10];
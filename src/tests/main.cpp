@@ -0,0 +1,77 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+# include "test_harness.h"
+# include <dsn/internal/synchronize.h>
+# include <dsn/tool/nativerun.h>
+# include <gtest/gtest.h>
+# include <stdlib.h>
+# ifndef _WIN32
+# include <unistd.h>
+# endif
+
+namespace dsn { namespace test {
+
+    static service_node* s_test_node = nullptr;
+    static utils::notify_event s_test_app_started;
+
+    class test_app : public ::dsn::service::service_app
+    {
+    public:
+        test_app(service_app_spec* s) : service_app(s) {}
+
+        virtual error_code start(int argc, char** argv)
+        {
+            s_test_node = node();
+            s_test_app_started.notify();
+            return ERR_OK;
+        }
+
+        virtual void stop(bool cleanup = false) {}
+    };
+
+    service_node* test_node()
+    {
+        return s_test_node;
+    }
+}}
+
+GTEST_API_ int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+
+    dsn::service::system::register_service<dsn::test::test_app>("test");
+    dsn::tools::register_tool<dsn::tools::nativerun>("nativerun");
+
+    if (!dsn::service::system::run("config-test.ini", false))
+        return 1;
+    dsn::test::s_test_app_started.wait();
+
+    int ret = RUN_ALL_TESTS();
+
+    // worker threads of the runtime are not joined
+    _exit(ret);
+}
@@ -0,0 +1,349 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+# pragma once
+
+# include "test_harness.h"
+# include "replica.h"
+# include "replica_stub.h"
+# include "mutation.h"
+# include "server_state.h"
+# include "meta_service.h"
+# include <dsn/dist/replication/replication_app_base.h>
+# include <dsn/dist/replication/replication_app_client_base.h>
+# include <boost/filesystem.hpp>
+
+//
+// replicas (and the stub they live in) set up without a cluster, where the
+// test bodies run in a single-thread pool as a replica is accessed by one
+// thread only, and the replicas run replication_test_app below
+//
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_TEST_REPLICA)
+DEFINE_TASK_CODE(LPC_REPLICA_TEST, ::dsn::TASK_PRIORITY_COMMON, THREAD_POOL_TEST_REPLICA)
+DEFINE_TASK_CODE_RPC(RPC_REPLICATION_TEST_APPEND, ::dsn::TASK_PRIORITY_COMMON, ::dsn::THREAD_POOL_DEFAULT)
+DEFINE_TASK_CODE_RPC(RPC_REPLICATION_TEST_READ, ::dsn::TASK_PRIORITY_COMMON, ::dsn::THREAD_POOL_DEFAULT)
+
+namespace dsn { namespace replication {
+
+// an app appending the values written to it in memory, and recording the
+// decrees its reads are served at
+class replication_test_app : public replication_app_base
+{
+public:
+    replication_test_app(replica* replica, configuration_ptr& config)
+        : replication_app_base(replica, config)
+    {
+        oldest_version = invalid_decree;
+        register_async_rpc_handler(RPC_REPLICATION_TEST_APPEND, "append", &replication_test_app::on_append);
+        register_async_rpc_handler(RPC_REPLICATION_TEST_READ, "read", &replication_test_app::on_read);
+    }
+
+    void on_append(const std::string& value, rpc_replier<int32_t>& reply)
+    {
+        values.push_back(value);
+        reply(0);
+    }
+
+    void on_read(const std::string& key, rpc_replier<std::string>& reply)
+    {
+        reads.push_back(read_decree());
+        reply(key);
+    }
+
+    // as if the versions since oldest_version were kept
+    virtual decree min_readable_decree() const 
+    {
+        return oldest_version == invalid_decree ? last_committed_decree() : oldest_version;
+    }
+
+    virtual int open(bool create_new) { return 0; }
+    virtual int close(bool clear_state) { return 0; }
+    virtual int flush(bool force) { _last_durable_decree.store(last_committed_decree()); return 0; }
+    virtual void on_empty_write() { values.push_back(std::string()); }
+
+    virtual int get_learn_state(decree start, const blob& learn_req, __out_param learn_state& state) { return 0; }
+    virtual int apply_learn_state(learn_state& state) { return 0; }
+
+public:
+    std::vector<std::string> values; // one per update, or an empty one for an empty write
+    std::vector<decree>      reads;  // read_decree() of each read served
+    decree                   oldest_version;
+};
+
+// with access to the internals of replicas and the stub
+class replication_tester
+{
+public:
+    static replica_stub_ptr create_stub(const std::string& dir, const replication_options& options)
+    {
+        static bool s_app_registered = false;
+        if (!s_app_registered)
+        {
+            register_replica_provider<replication_test_app>("test_app");
+            s_app_registered = true;
+        }
+
+        boost::filesystem::remove_all(dir);
+        boost::filesystem::create_directory(dir);
+
+        replica_stub_ptr stub(new replica_stub());
+        stub->set_options(options);
+        stub->_dir = dir;
+        return stub;
+    }
+
+    static replica_ptr create_replica(replica_stub_ptr& stub, global_partition_id gpid)
+    {
+        return replica::newr(stub.get(), "test_app", gpid, stub->options());
+    }
+
+    static replication_test_app* app(replica_ptr& r)
+    {
+        return static_cast<replication_test_app*>(r->get_app());
+    }
+
+    // a mutation as received from the primary, appending each of the values
+    static mutation_ptr create_mutation(global_partition_id gpid, ballot b, decree d, const std::vector<std::string>& values)
+    {
+        mutation_ptr mu(new mutation());
+        mu->data.header.gpid = gpid;
+        mu->data.header.log_offset = invalid_offset;
+        mu->data.header.last_committed_decree = d - 1;
+        mu->set_id(b, d);
+        for (auto& v : values)
+        {
+            message_ptr request = message::create_request(RPC_REPLICATION_TEST_APPEND);
+            marshall(request->writer(), v);
+            request->seal(false);
+
+            message_ptr received(new message(request->writer().get_buffer()));
+            mu->add_client_request(RPC_REPLICATION_TEST_APPEND, received);
+        }
+
+        binary_writer writer;
+        mu->write_to(writer);
+        message_ptr msg(new message(writer.get_buffer(), false));
+        return mutation::read_from(msg);
+    }
+
+    // commits [1, count] on an inactive replica as replay does
+    static void commit_mutations(replica_ptr& r, decree count, std::function<std::vector<std::string>(decree)> values)
+    {
+        for (decree d = 1; d <= count + 1; d++)
+        {
+            auto mu = create_mutation(r->get_gpid(), 1, d, d <= count ? values(d) : std::vector<std::string>());
+            r->replay_mutation(mu);
+        }
+    }
+
+    static void set_status(replica_ptr& r, partition_status status)
+    {
+        r->_config.status = status;
+
+        // a primary whose decrees prepared before it became the primary are all
+        // committed, as latest reads wait for them
+        if (status == PS_PRIMARY)
+        {
+            r->_primary_states.last_prepare_decree_on_new_primary = r->last_committed_decree();
+        }
+    }
+
+    static void set_ballot(replica_ptr& r, ballot b)
+    {
+        r->_config.ballot = b;
+    }
+
+    // a client read as dispatched by the stub
+    static void read(replica_ptr& r, read_semantic_t semantic, decree version_decree)
+    {
+        read_request_header meta;
+        meta.gpid = r->get_gpid();
+        meta.code = RPC_REPLICATION_TEST_READ;
+        meta.semantic = semantic;
+        meta.version_decree = version_decree;
+
+        message_ptr request = message::create_request(RPC_REPLICATION_TEST_READ);
+        marshall(request->writer(), std::string("key"));
+        request->seal(false);
+
+        message_ptr received(new message(request->writer().get_buffer()));
+        r->on_client_read(meta, received);
+    }
+
+    static void add_replica(replica_stub_ptr& stub, replica_ptr r)
+    {
+        stub->add_replica(r);
+    }
+
+    static bool remove_replica(replica_stub_ptr& stub, replica_ptr r)
+    {
+        return stub->remove_replica(r);
+    }
+
+    static replica_stub::replica_table_ptr replica_table(replica_stub_ptr& stub)
+    {
+        return std::atomic_load(&stub->_replica_table);
+    }
+
+    // a configuration query reply from the meta server
+    static void on_config_reply(replication_app_client_base& client, const configuration_query_by_index_response& resp, int pidx)
+    {
+        binary_writer writer;
+        marshall(writer, resp);
+        blob bb = writer.get_buffer();
+
+        message_ptr request = nullptr;
+        message_ptr response(new message(bb, false));
+        client.query_partition_configuration_reply(ERR_OK, request, response, pidx);
+    }
+
+    static error_code get_address(replication_app_client_base& client, int pidx, bool to_primary, __out_param end_point& addr, read_semantic_t semantic)
+    {
+        int app_id;
+        return client.get_address(pidx, to_primary, addr, app_id, semantic);
+    }
+
+    static void invalidate(replication_app_client_base& client, int pidx)
+    {
+        client.invalidate_partition_configuration(pidx);
+    }
+
+    static std::shared_ptr<const void> routing_table(replication_app_client_base& client)
+    {
+        return std::atomic_load(&client._routing_table);
+    }
+
+    static uint64_t routing_version(replication_app_client_base& client)
+    {
+        return std::atomic_load(&client._routing_table)->version;
+    }
+
+    static const end_point& routed_primary(const std::shared_ptr<const void>& table, int pidx)
+    {
+        return static_cast<const replication_app_client_base::routing_table*>(table.get())->partitions[pidx].primary;
+    }
+
+    // a single app of the given partitions, as init_app creates from the config
+    static void init_server_state(server_state& state, int partition_count)
+    {
+        app_state app;
+        app.app_id = 1;
+        app.app_name = "test_app";
+        app.app_type = "test_app";
+        app.partition_count = partition_count;
+        for (int i = 0; i < partition_count; i++)
+        {
+            partition_configuration pc;
+            pc.app_type = app.app_type;
+            pc.ballot = 0;
+            pc.gpid.app_id = app.app_id;
+            pc.gpid.pidx = i;
+            pc.last_committed_decree = 0;
+            pc.max_replica_count = 3;
+            app.partitions.push_back(pc);
+            app.partition_versions.push_back(state._config_version);
+        }
+        state._apps.push_back(app);
+    }
+
+    static size_t removed_partition_count(server_state& state, const end_point& node)
+    {
+        return state._nodes[node].removed.size();
+    }
+
+    static void load_meta_state(meta_service& service, const std::string& dir, bool clean_state)
+    {
+        service._data_dir = dir;
+        service.load_state(clean_state);
+    }
+
+    static void replay_meta_log(meta_service& service, const std::string& log)
+    {
+        service.replay_log(log.c_str());
+    }
+
+    // the log as start opens it, with the given group commit options
+    static void open_meta_log(meta_service& service, const std::string& dir, int batch_window_ms, bool durable_write)
+    {
+        service._data_dir = dir;
+        service._opts.meta_log_batch_window_ms = batch_window_ms;
+        service._opts.meta_log_durable_write = durable_write;
+        service._log = file::open(service.log_path(0).c_str(), O_RDWR | O_CREAT, 0666);
+    }
+
+    static void close_meta_log(meta_service& service)
+    {
+        auto err = file::close(service._log);
+        err.end_tracking();
+    }
+
+    static std::string meta_log_path(meta_service& service)
+    {
+        return service.log_path(service._log_gen);
+    }
+
+    // no update is being logged or waiting to be
+    static bool meta_log_idle(meta_service& service)
+    {
+        zauto_lock l(service._log_lock);
+        return !service._log_writing && service._log_updates.empty();
+    }
+
+    // a configuration update as dispatched by on_request
+    static void update_meta_configuration(meta_service& service, message_ptr& request, message_ptr& response)
+    {
+        service.update_configuration(request, response);
+    }
+
+    static bool get_learn_mutations(replica_ptr& r, decree start, __out_param std::vector<blob>& mutations)
+    {
+        return r->get_learn_mutations(start, mutations);
+    }
+
+    static int apply_learn_mutations(replica_ptr& r, const std::vector<blob>& mutations)
+    {
+        return r->apply_learn_mutations(mutations);
+    }
+};
+
+class replica_test_task : public task
+{
+public:
+    replica_test_task(std::function<void()> body) : task(LPC_REPLICA_TEST, 0, ::dsn::test::test_node()), _body(body) {}
+    virtual void exec() { _body(); }
+
+private:
+    std::function<void()> _body;
+};
+
+inline void run_replica_test(std::function<void()> body)
+{
+    task_ptr t(new replica_test_task(body));
+    t->enqueue();
+    t->wait();
+}
+
+}} // namespace
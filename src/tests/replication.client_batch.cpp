@@ -0,0 +1,167 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+# include "replication_common.h"
+# include <gtest/gtest.h>
+
+using namespace ::dsn;
+using namespace ::dsn::replication;
+
+static blob client_batch_body(std::function<void(binary_writer&)> write_body)
+{
+    binary_writer writer;
+    write_body(writer);
+    return writer.get_buffer();
+}
+
+TEST(replication, client_batch)
+{
+    // client side: whole request messages, as the replica dispatches each on its own
+    std::vector<blob> requests;
+    for (int i = 0; i < 3; i++)
+    {
+        message_ptr msg = message::create_request(RPC_REPLICATION_CLIENT_WRITE, 1000, 0);
+        msg->writer().write(i);
+        msg->seal(false);
+        requests.push_back(msg->writer().get_buffer());
+    }
+
+    blob body = client_batch_body([&](binary_writer& writer) { client_batch_helper::write(writer, requests); });
+
+    // replica side
+    std::vector<blob> received;
+    binary_reader reader(body);
+    ASSERT_TRUE(client_batch_helper::read(reader, received));
+    ASSERT_EQ(requests.size(), received.size());
+    for (size_t i = 0; i < received.size(); i++)
+    {
+        message_ptr msg(new message(received[i]));
+        EXPECT_TRUE(msg->is_right_header());
+        EXPECT_STREQ(RPC_REPLICATION_CLIENT_WRITE.to_string(), msg->header().rpc_name);
+
+        int v = -1;
+        msg->reader().read(v);
+        EXPECT_EQ(static_cast<int>(i), v);
+    }
+
+    // the second request is dropped by the replica, and its reply is left empty
+    std::vector<blob> replies(received.size());
+    for (size_t i = 0; i < replies.size(); i++)
+    {
+        if (i == 1) continue;
+        replies[i] = client_batch_body([&](binary_writer& writer) { writer.write(static_cast<int>(i) * 10); });
+    }
+    body = client_batch_body([&](binary_writer& writer) { client_batch_helper::write_reply(writer, ERR_OK, replies); });
+
+    // client side again
+    std::vector<blob> received_replies;
+    error_code err = ERR_INVALID_DATA;
+    binary_reader reply_reader(body);
+    ASSERT_TRUE(client_batch_helper::read_reply(reply_reader, err, received_replies));
+    EXPECT_TRUE(err == ERR_OK);
+    ASSERT_EQ(requests.size(), received_replies.size());
+    EXPECT_EQ(0, received_replies[1].length());
+    for (size_t i = 0; i < received_replies.size(); i++)
+    {
+        if (i == 1) continue;
+        binary_reader r(received_replies[i]);
+        int v = -1;
+        r.read(v);
+        EXPECT_EQ(static_cast<int>(i) * 10, v);
+    }
+}
+
+TEST(replication, client_batch_invalid)
+{
+    int counts[] = { 0, -1, CLIENT_BATCH_MAX_COUNT + 1, 0x7fffffff, 3 };
+    for (auto count : counts)
+    {
+        // two requests whatever the count tells
+        blob body = client_batch_body([&](binary_writer& writer)
+        {
+            writer.write(count);
+            writer.write(blob());
+            writer.write(blob());
+        });
+
+        std::vector<blob> msgs;
+        binary_reader reader(body);
+        EXPECT_FALSE(client_batch_helper::read(reader, msgs));
+    }
+
+    // a message longer than the body
+    blob body = client_batch_body([&](binary_writer& writer)
+    {
+        writer.write(1);
+        writer.write(100);
+    });
+    std::vector<blob> msgs;
+    binary_reader reader(body);
+    EXPECT_FALSE(client_batch_helper::read(reader, msgs));
+
+    // a negative message length
+    body = client_batch_body([&](binary_writer& writer)
+    {
+        writer.write(1);
+        writer.write(-8);
+        writer.write(0);
+        writer.write(0);
+    });
+    msgs.clear();
+    binary_reader reader2(body);
+    EXPECT_FALSE(client_batch_helper::read(reader2, msgs));
+}
+
+TEST(replication, client_batch_rejected)
+{
+    // a rejected batch carries its error and no replies
+    blob body = client_batch_body([&](binary_writer& writer)
+    {
+        client_batch_helper::write_reply(writer, ERR_INVALID_DATA, std::vector<blob>());
+    });
+
+    std::vector<blob> replies(2);
+    error_code err = ERR_OK;
+    binary_reader reader(body);
+    ASSERT_TRUE(client_batch_helper::read_reply(reader, err, replies));
+    EXPECT_TRUE(err == ERR_INVALID_DATA);
+    EXPECT_TRUE(replies.empty());
+    EXPECT_EQ(0, reader.get_remaining_size());
+
+    // a reply without even its error
+    blob empty;
+    binary_reader empty_reader(empty);
+    EXPECT_FALSE(client_batch_helper::read_reply(empty_reader, err, replies));
+
+    // an accepted batch with a malformed count
+    body = client_batch_body([&](binary_writer& writer)
+    {
+        writer.write(ERR_OK.get());
+        writer.write(CLIENT_BATCH_MAX_COUNT + 1);
+    });
+    binary_reader bad_reader(body);
+    EXPECT_FALSE(client_batch_helper::read_reply(bad_reader, err, replies));
+}
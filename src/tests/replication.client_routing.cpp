@@ -0,0 +1,115 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+# include "replica_test_harness.h"
+# include <gtest/gtest.h>
+
+using namespace ::dsn;
+using namespace ::dsn::replication;
+
+static configuration_query_by_index_response routing_test_reply(int pidx, ballot b, const end_point& primary, const std::vector<end_point>& secondaries)
+{
+    partition_configuration config;
+    config.gpid.app_id = 1;
+    config.gpid.pidx = pidx;
+    config.ballot = b;
+    config.max_replica_count = 3;
+    config.primary = primary;
+    config.secondaries = secondaries;
+    config.last_committed_decree = 0;
+
+    configuration_query_by_index_response resp;
+    resp.err = ERR_OK;
+    resp.app_id = 1;
+    resp.partition_count = 4;
+    resp.partitions.push_back(config);
+    return resp;
+}
+
+static end_point routing_test_node(uint32_t ip)
+{
+    end_point ep;
+    ep.ip = ip;
+    ep.port = 34801;
+    return ep;
+}
+
+TEST(replication, client_routing_table)
+{
+    run_replica_test([&]()
+    {
+        end_point a = routing_test_node(1), b = routing_test_node(2), c = routing_test_node(3);
+        replication_app_client_base client(std::vector<end_point>(), "test");
+
+        // nothing to route to before the configuration is known
+        end_point addr;
+        EXPECT_TRUE(replication_tester::get_address(client, 1, true, addr, read_semantic_t::ReadLastUpdate) == ERR_IO_PENDING);
+        EXPECT_EQ(0u, replication_tester::routing_version(client));
+
+        replication_tester::on_config_reply(client, routing_test_reply(1, 2, a, std::vector<end_point>(1, b)), 1);
+        EXPECT_EQ(1u, replication_tester::routing_version(client));
+        EXPECT_TRUE(replication_tester::get_address(client, 1, true, addr, read_semantic_t::ReadLastUpdate) == ERR_OK);
+        EXPECT_TRUE(addr == a);
+        EXPECT_TRUE(replication_tester::get_address(client, 0, true, addr, read_semantic_t::ReadLastUpdate) == ERR_IO_PENDING);
+        EXPECT_TRUE(replication_tester::get_address(client, 4, true, addr, read_semantic_t::ReadLastUpdate) == ERR_IO_PENDING);
+
+        // a stale reply publishes nothing
+        auto snapshot = replication_tester::routing_table(client);
+        replication_tester::on_config_reply(client, routing_test_reply(1, 1, b, std::vector<end_point>(1, c)), 1);
+        EXPECT_EQ(1u, replication_tester::routing_version(client));
+        EXPECT_EQ(snapshot.get(), replication_tester::routing_table(client).get());
+
+        // a newer one publishes a new table, while the one held is unchanged
+        std::vector<end_point> secondaries;
+        secondaries.push_back(a);
+        secondaries.push_back(c);
+        replication_tester::on_config_reply(client, routing_test_reply(1, 3, b, secondaries), 1);
+        EXPECT_EQ(2u, replication_tester::routing_version(client));
+        EXPECT_TRUE(replication_tester::get_address(client, 1, true, addr, read_semantic_t::ReadLastUpdate) == ERR_OK);
+        EXPECT_TRUE(addr == b);
+        EXPECT_TRUE(replication_tester::routed_primary(snapshot, 1) == a);
+
+        // other reads go to any member of the group
+        for (int i = 0; i < 20; i++)
+        {
+            EXPECT_TRUE(replication_tester::get_address(client, 1, false, addr, read_semantic_t::ReadOutdated) == ERR_OK);
+            EXPECT_TRUE(addr == a || addr == b || addr == c);
+        }
+
+        // an invalidated partition waits for the next query
+        replication_tester::invalidate(client, 1);
+        EXPECT_EQ(3u, replication_tester::routing_version(client));
+        EXPECT_TRUE(replication_tester::get_address(client, 1, true, addr, read_semantic_t::ReadLastUpdate) == ERR_IO_PENDING);
+        replication_tester::invalidate(client, 1);
+        replication_tester::invalidate(client, 5);
+        EXPECT_EQ(3u, replication_tester::routing_version(client));
+
+        replication_tester::on_config_reply(client, routing_test_reply(1, 3, b, secondaries), 1);
+        EXPECT_EQ(4u, replication_tester::routing_version(client));
+        EXPECT_TRUE(replication_tester::get_address(client, 1, true, addr, read_semantic_t::ReadLastUpdate) == ERR_OK);
+        EXPECT_TRUE(addr == b);
+    });
+}
@@ -0,0 +1,427 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+# include "replica_test_harness.h"
+# include <gtest/gtest.h>
+# include <dsn/internal/network.h>
+# include <fstream>
+# include <thread>
+# include <chrono>
+
+using namespace ::dsn;
+using namespace ::dsn::replication;
+
+static end_point meta_test_node(uint32_t ip)
+{
+    end_point ep;
+    ep.ip = ip;
+    ep.port = 34601;
+    return ep;
+}
+
+static configuration_update_request meta_test_update(int pidx, ballot b, config_type type, const end_point& node, const end_point& primary, const std::vector<end_point>& secondaries)
+{
+    configuration_update_request request;
+    request.type = type;
+    request.node = node;
+    request.config.app_type = "test_app";
+    request.config.gpid.app_id = 1;
+    request.config.gpid.pidx = pidx;
+    request.config.ballot = b;
+    request.config.last_committed_decree = 0;
+    request.config.max_replica_count = 3;
+    request.config.primary = primary;
+    request.config.secondaries = secondaries;
+    return request;
+}
+
+// the records as meta_service logs them, i.e., [length][request]
+static std::string meta_test_log_records(const std::vector<configuration_update_request>& requests)
+{
+    std::string records;
+    for (auto& request : requests)
+    {
+        binary_writer writer;
+        int32_t len = 0;
+        marshall(writer, len);
+        marshall(writer, request);
+
+        blob bb = writer.get_buffer();
+        *(int32_t*)bb.data() = bb.length() - sizeof(int32_t);
+        records.append(bb.data(), bb.length());
+    }
+    return records;
+}
+
+static void meta_test_write_file(const std::string& path, const std::string& content)
+{
+    std::ofstream os(path, std::ios::binary | std::ios::trunc);
+    os.write(content.data(), content.length());
+}
+
+static partition_configuration meta_test_config(server_state& state, int pidx)
+{
+    global_partition_id gpid;
+    gpid.app_id = 1;
+    gpid.pidx = pidx;
+
+    partition_configuration config;
+    state.query_configuration_by_gpid(gpid, config);
+    return config;
+}
+
+static std::string meta_test_dir(const char* name)
+{
+    std::string dir = std::string("./") + name;
+    boost::filesystem::remove_all(dir);
+    boost::filesystem::create_directory(dir);
+    return dir;
+}
+
+TEST(replication, meta_log_torn_tail)
+{
+    run_replica_test([]()
+    {
+        std::string dir = meta_test_dir("meta_log_torn_tail");
+        end_point a = meta_test_node(1), b = meta_test_node(2), c = meta_test_node(3);
+
+        // a chain of updates to partition 0, each on the ballot of the previous one
+        std::vector<configuration_update_request> updates;
+        updates.push_back(meta_test_update(0, 1, CT_ASSIGN_PRIMARY, a, a, std::vector<end_point>()));
+        updates.push_back(meta_test_update(0, 2, CT_ADD_SECONDARY, b, a, std::vector<end_point>({ b })));
+        updates.push_back(meta_test_update(0, 3, CT_ADD_SECONDARY, c, a, std::vector<end_point>({ b, c })));
+
+        std::string records = meta_test_log_records(updates);
+        size_t last_len = meta_test_log_records(std::vector<configuration_update_request>(1, updates[2])).length();
+
+        // all complete
+        std::string log = dir + "/oplog.0";
+        meta_test_write_file(log, records);
+        {
+            server_state state;
+            replication_tester::init_server_state(state, 4);
+            meta_service service(&state);
+            replication_tester::replay_meta_log(service, log);
+
+            auto config = meta_test_config(state, 0);
+            EXPECT_EQ(3, config.ballot);
+            EXPECT_EQ(2u, config.secondaries.size());
+        }
+
+        // the last record torn in its body, right after its length, and in its length
+        size_t torn_lens[] = { last_len - 1, last_len - sizeof(int32_t), last_len - 2 };
+        for (auto torn_len : torn_lens)
+        {
+            meta_test_write_file(log, records.substr(0, records.length() - torn_len));
+
+            server_state state;
+            replication_tester::init_server_state(state, 4);
+            meta_service service(&state);
+            replication_tester::replay_meta_log(service, log);
+
+            auto config = meta_test_config(state, 0);
+            EXPECT_EQ(2, config.ballot);
+            EXPECT_TRUE(config.primary == a);
+            ASSERT_EQ(1u, config.secondaries.size());
+            EXPECT_TRUE(config.secondaries[0] == b);
+        }
+
+        boost::filesystem::remove_all(dir);
+    });
+}
+
+TEST(replication, meta_checkpoint_restart)
+{
+    run_replica_test([]()
+    {
+        std::string dir = meta_test_dir("meta_checkpoint_restart");
+        end_point a = meta_test_node(1), b = meta_test_node(2);
+
+        // a checkpoint where a is the primary of 0 and 1
+        {
+            server_state state;
+            replication_tester::init_server_state(state, 4);
+            node_states nodes;
+            nodes.push_back(std::make_pair(a, true));
+            nodes.push_back(std::make_pair(b, true));
+            state.set_node_state(nodes, nullptr);
+
+            for (int pidx = 0; pidx < 2; pidx++)
+            {
+                auto request = meta_test_update(pidx, 1, CT_ASSIGN_PRIMARY, a, a, std::vector<end_point>());
+                configuration_update_response response;
+                state.update_configuration(request, response);
+                ASSERT_TRUE(response.err == ERR_OK);
+            }
+            state.save((dir + "/checkpoint").c_str());
+        }
+
+        // the logs since, starting with an update already in the checkpoint as the log
+        // rolls over before the snapshot is taken, and a checkpoint.tmp left by a crash
+        std::vector<configuration_update_request> log0, log1;
+        log0.push_back(meta_test_update(0, 1, CT_ASSIGN_PRIMARY, a, a, std::vector<end_point>()));
+        log0.push_back(meta_test_update(0, 2, CT_ADD_SECONDARY, b, a, std::vector<end_point>({ b })));
+        log1.push_back(meta_test_update(2, 1, CT_ASSIGN_PRIMARY, b, b, std::vector<end_point>()));
+        meta_test_write_file(dir + "/oplog.0", meta_test_log_records(log0));
+        meta_test_write_file(dir + "/oplog.1", meta_test_log_records(log1));
+        meta_test_write_file(dir + "/checkpoint.tmp", "torn");
+
+        auto check = [&](server_state& state)
+        {
+            auto config = meta_test_config(state, 0);
+            EXPECT_EQ(2, config.ballot);
+            EXPECT_TRUE(config.primary == a);
+            ASSERT_EQ(1u, config.secondaries.size());
+            EXPECT_TRUE(config.secondaries[0] == b);
+
+            config = meta_test_config(state, 1);
+            EXPECT_EQ(1, config.ballot);
+            EXPECT_TRUE(config.primary == a);
+
+            config = meta_test_config(state, 2);
+            EXPECT_EQ(1, config.ballot);
+            EXPECT_TRUE(config.primary == b);
+
+            config = meta_test_config(state, 3);
+            EXPECT_EQ(0, config.ballot);
+            EXPECT_TRUE(config.primary == end_point::INVALID);
+        };
+
+        // the logs are replayed on the checkpoint, and folded into a new one
+        {
+            server_state state;
+            meta_service service(&state);
+            replication_tester::load_meta_state(service, dir, false);
+            check(state);
+        }
+        EXPECT_TRUE(boost::filesystem::exists(dir + "/checkpoint"));
+        EXPECT_FALSE(boost::filesystem::exists(dir + "/checkpoint.tmp"));
+        EXPECT_FALSE(boost::filesystem::exists(dir + "/oplog.0"));
+        EXPECT_FALSE(boost::filesystem::exists(dir + "/oplog.1"));
+
+        // and restarting from the new checkpoint alone
+        {
+            server_state state;
+            meta_service service(&state);
+            replication_tester::load_meta_state(service, dir, false);
+            check(state);
+
+            configuration_query_by_node_request request;
+            request.node = a;
+            request.known_epoch = 0;
+            request.known_version = 0;
+            configuration_query_by_node_response response;
+            state.query_configuration_by_node(request, response);
+            EXPECT_TRUE(response.err == ERR_OK);
+            EXPECT_EQ(2u, response.partitions.size());
+        }
+
+        // a clean start removes all of them
+        meta_test_write_file(dir + "/oplog.2", meta_test_log_records(log1));
+        meta_test_write_file(dir + "/checkpoint.tmp", "torn");
+        {
+            server_state state;
+            meta_service service(&state);
+            replication_tester::load_meta_state(service, dir, true);
+        }
+        EXPECT_FALSE(boost::filesystem::exists(dir + "/checkpoint"));
+        EXPECT_FALSE(boost::filesystem::exists(dir + "/checkpoint.tmp"));
+        EXPECT_FALSE(boost::filesystem::exists(dir + "/oplog.2"));
+
+        boost::filesystem::remove_all(dir);
+    });
+}
+
+// a network only for the sessions below, which never connects
+class meta_test_network : public connection_oriented_network
+{
+public:
+    meta_test_network() : connection_oriented_network(nullptr, nullptr) {}
+    virtual error_code start(rpc_channel channel, int port, bool client_only) { return ERR_OK; }
+    virtual const end_point& address() { return end_point::INVALID; }
+    virtual rpc_client_session_ptr create_client_session(const end_point& server_addr) { return nullptr; }
+};
+
+// records each reply of the meta service with what is in the log and the state by then
+class meta_test_session : public rpc_server_session
+{
+public:
+    struct reply
+    {
+        configuration_update_response response;
+        uint64_t                      log_size;
+        ballot                        applied_ballot;
+    };
+
+    meta_test_session(meta_test_network& net, server_state& state, const std::string& log)
+        : rpc_server_session(net, end_point::INVALID), _state(state), _log(log)
+    {
+    }
+
+    virtual void send(message_ptr& reply_msg)
+    {
+        message_ptr msg(new message(reply_msg->writer().get_buffer()));
+        meta_response_header rhdr;
+        reply r;
+        unmarshall(msg, rhdr);
+        unmarshall(msg, r.response);
+        r.log_size = boost::filesystem::file_size(_log);
+        r.applied_ballot = meta_test_config(_state, r.response.config.gpid.pidx).ballot;
+
+        zauto_lock l(_lock);
+        _replies.push_back(r);
+    }
+
+    std::vector<reply> replies()
+    {
+        zauto_lock l(_lock);
+        return _replies;
+    }
+
+private:
+    server_state&      _state;
+    std::string        _log;
+    zlock              _lock;
+    std::vector<reply> _replies;
+};
+
+// sends the updates to the meta service one after another, as from clients
+static std::vector<meta_test_session::reply> meta_test_group_commit(const char* name, int batch_window_ms, const std::vector<configuration_update_request>& updates)
+{
+    std::string dir = meta_test_dir(name);
+    end_point a = meta_test_node(1), b = meta_test_node(2);
+
+    server_state state;
+    replication_tester::init_server_state(state, 4);
+    node_states nodes;
+    nodes.push_back(std::make_pair(a, true));
+    nodes.push_back(std::make_pair(b, true));
+    state.set_node_state(nodes, nullptr);
+
+    meta_service service(&state);
+    replication_tester::open_meta_log(service, dir, batch_window_ms, true);
+
+    meta_test_network net;
+    std::string log = replication_tester::meta_log_path(service);
+    rpc_server_session_ptr session(new meta_test_session(net, state, log));
+    for (auto& update : updates)
+    {
+        message_ptr request = message::create_request(RPC_CM_CALL);
+        marshall(request, update);
+        request->seal(false);
+
+        message_ptr received(new message(request->writer().get_buffer()));
+        received->header().local_rpc_code = (uint16_t)(RPC_CM_CALL);
+        received->server_session() = session;
+        message_ptr response = received->create_response();
+        replication_tester::update_meta_configuration(service, received, response);
+    }
+
+    auto recorder = static_cast<meta_test_session*>(session.get());
+    for (int i = 0; i < 5000; i++)
+    {
+        if (recorder->replies().size() == updates.size() && replication_tester::meta_log_idle(service))
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    replication_tester::close_meta_log(service);
+
+    // the log has the updates in the order they arrived
+    std::ifstream is(log, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    EXPECT_TRUE(content == meta_test_log_records(updates));
+    is.close();
+
+    auto replies = recorder->replies();
+    boost::filesystem::remove_all(dir);
+    return replies;
+}
+
+// a chain of updates to partition 0 interleaved with ones to partition 1, so that
+// each is only accepted when applied after the previous ones to its partition
+static std::vector<configuration_update_request> meta_test_chained_updates(int count)
+{
+    end_point a = meta_test_node(1), b = meta_test_node(2);
+    std::vector<configuration_update_request> updates;
+    for (int i = 0; i < count; i++)
+    {
+        int pidx = i % 2;
+        ballot bt = i / 2 + 1;
+        end_point primary = (bt % 2) ? a : b;
+        updates.push_back(meta_test_update(pidx, bt, CT_ASSIGN_PRIMARY, primary, primary, std::vector<end_point>()));
+    }
+    return updates;
+}
+
+static void meta_test_check_replies(const std::vector<configuration_update_request>& updates, const std::vector<meta_test_session::reply>& replies)
+{
+    ASSERT_EQ(updates.size(), replies.size());
+
+    std::string records;
+    for (size_t i = 0; i < replies.size(); i++)
+    {
+        auto r = replies[i];
+
+        // in the order they arrived, and all accepted as applied in that order
+        EXPECT_TRUE(r.response.err == ERR_OK);
+        EXPECT_EQ(updates[i].config.gpid.pidx, r.response.config.gpid.pidx);
+        EXPECT_EQ(updates[i].config.ballot, r.response.config.ballot);
+
+        // replied only once logged and applied
+        records += meta_test_log_records(std::vector<configuration_update_request>(1, updates[i]));
+        EXPECT_GE(r.log_size, records.length());
+        EXPECT_GE(r.applied_ballot, updates[i].config.ballot);
+    }
+}
+
+TEST(replication, meta_log_group_commit)
+{
+    run_replica_test([]()
+    {
+        // the updates arriving while a write is in flight go with the next write
+        auto updates = meta_test_chained_updates(64);
+        auto replies = meta_test_group_commit("meta_log_group_commit", 0, updates);
+        meta_test_check_replies(updates, replies);
+    });
+}
+
+TEST(replication, meta_log_group_commit_window)
+{
+    run_replica_test([]()
+    {
+        // the updates arriving within the window go with the same write, so none
+        // is replied before the last of them is logged
+        auto updates = meta_test_chained_updates(16);
+        auto replies = meta_test_group_commit("meta_log_group_commit_window", 200, updates);
+        meta_test_check_replies(updates, replies);
+
+        auto size = meta_test_log_records(updates).length();
+        for (auto& r : replies)
+        {
+            EXPECT_EQ(size, r.log_size);
+        }
+    });
+}
@@ -0,0 +1,388 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+# include "test_harness.h"
+# include "mutation_log.h"
+# include <boost/filesystem.hpp>
+# include <fstream>
+# include <gtest/gtest.h>
+
+using namespace ::dsn;
+using namespace ::dsn::replication;
+
+// the test body waits for the log tasks, so it runs in a pool of its own
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_TEST_LOG)
+DEFINE_TASK_CODE(LPC_MUTATION_LOG_TEST, ::dsn::TASK_PRIORITY_COMMON, THREAD_POOL_TEST_LOG)
+
+class log_test_task : public task
+{
+public:
+    log_test_task(std::function<void()> body) : task(LPC_MUTATION_LOG_TEST, 0, dsn::test::test_node()), _body(body) {}
+    virtual void exec() { _body(); }
+
+private:
+    std::function<void()> _body;
+};
+
+static void run_log_test(std::function<void()> body)
+{
+    task_ptr t(new log_test_task(body));
+    t->enqueue();
+    t->wait();
+}
+
+static mutation_log* open_log(const std::string& dir)
+{
+    auto log = new mutation_log(1, 0, 32, false);
+    EXPECT_TRUE(log->initialize(dir.c_str()) == ERR_OK);
+    return log;
+}
+
+static void append_mutation(mutation_log* log, global_partition_id gpid, ballot b, decree d)
+{
+    mutation_ptr mu(new mutation());
+    mu->data.header.gpid = gpid;
+    mu->data.header.log_offset = invalid_offset;
+    mu->data.header.last_committed_decree = d - 1;
+    mu->set_id(b, d);
+
+    auto tsk = log->append(mu, LPC_WRITE_REPLICATION_LOG, log, [](error_code err, uint32_t){ EXPECT_TRUE(err == ERR_OK); });
+    tsk->wait();
+}
+
+static void close_logs(std::vector<mutation_log*>& logs)
+{
+    for (auto& log : logs)
+    {
+        log->close();
+        delete log;
+    }
+    logs.clear();
+}
+
+TEST(replication, mutation_log_replay_shards)
+{
+    std::string dir = "./test_log_shards";
+    boost::filesystem::remove_all(dir);
+    boost::filesystem::create_directory(dir);
+
+    global_partition_id p0, p1;
+    p0.app_id = 1; p0.pidx = 0;
+    p1.app_id = 1; p1.pidx = 1;
+
+    // p0 was in shard 1 before the shard count shrinks and is in shard 0 since
+    // then, where it re-prepares decree 4 and 5 with a new ballot
+    std::vector<mutation_log*> shards;
+    run_log_test([&]()
+    {
+        shards.push_back(open_log(dir + "/log"));
+        shards.push_back(open_log(dir + "/log.1"));
+        multi_partition_decrees init_decrees;
+        for (auto& log : shards)
+        {
+            EXPECT_TRUE(log->start_write_service(init_decrees, 20) == ERR_OK);
+        }
+
+        for (decree d = 1; d <= 5; d++)
+        {
+            append_mutation(shards[1], p0, 1, d);
+        }
+        for (decree d = 4; d <= 7; d++)
+        {
+            append_mutation(shards[0], p0, 2, d);
+        }
+        for (decree d = 1; d <= 3; d++)
+        {
+            append_mutation(shards[0], p1, 1, d);
+        }
+        close_logs(shards);
+    });
+
+    multi_partition_decrees committed_decrees;
+    committed_decrees[p0] = 2;
+    committed_decrees[p1] = 0;
+
+    // as after a crash, so the shards are indexed before the replay
+    std::vector<boost::filesystem::path> index_files;
+    for (boost::filesystem::recursive_directory_iterator it(dir), end; it != end; it++)
+    {
+        if (it->path().extension() == ".index")
+        {
+            index_files.push_back(it->path());
+        }
+    }
+    EXPECT_FALSE(index_files.empty());
+    for (auto& path : index_files)
+    {
+        boost::filesystem::remove(path);
+    }
+
+    std::vector<mutation_ptr> mutations;
+    run_log_test([&]()
+    {
+        shards.push_back(open_log(dir + "/log"));
+        shards.push_back(open_log(dir + "/log.1"));
+        EXPECT_TRUE(mutation_log::replay_shards(shards, [&](mutation_ptr& mu) { mutations.push_back(mu); }, committed_decrees) == ERR_OK);
+        close_logs(shards);
+    });
+    boost::filesystem::remove_all(dir);
+
+    // p1 is only in shard 0 and streamed with it, while p0's mutations there
+    // are held until its leftover shard is replayed, and merged into them
+    std::vector<std::pair<ballot, decree>> expected = { {1, 1}, {1, 2}, {1, 3}, {1, 3}, {1, 4}, {1, 5}, {2, 4}, {2, 5}, {2, 6}, {2, 7} };
+    ASSERT_EQ(expected.size(), mutations.size());
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        EXPECT_TRUE(mutations[i]->data.header.gpid == (i < 3 ? p1 : p0));
+        EXPECT_EQ(expected[i].first, mutations[i]->data.header.ballot);
+        EXPECT_EQ(expected[i].second, mutations[i]->data.header.decree);
+    }
+}
+
+TEST(replication, mutation_log_decree_index)
+{
+    std::string dir = "./test_log_index";
+    boost::filesystem::remove_all(dir);
+
+    global_partition_id p0;
+    p0.app_id = 1; p0.pidx = 0;
+
+    // each append is written as a log block of its own
+    std::vector<mutation_log*> logs;
+    run_log_test([&]()
+    {
+        logs.push_back(open_log(dir));
+        multi_partition_decrees init_decrees;
+        EXPECT_TRUE(logs[0]->start_write_service(init_decrees, 20) == ERR_OK);
+        for (decree d = 1; d <= 10; d++)
+        {
+            append_mutation(logs[0], p0, 1, d);
+        }
+        close_logs(logs);
+    });
+
+    std::string file_path;
+    run_log_test([&]()
+    {
+        logs.push_back(open_log(dir));
+        auto& files = logs[0]->get_logfiles_for_test();
+        ASSERT_EQ(1u, files.size());
+        auto file = files.begin()->second;
+        file_path = file->path();
+
+        // the index saved on close is loaded with the file
+        ASSERT_TRUE(file->has_decree_index());
+        auto& index = file->get_decree_index();
+        ASSERT_EQ(1u, index.size());
+        auto& pi = index.find(p0)->second;
+        EXPECT_EQ(1, pi.min_decree);
+        EXPECT_EQ(10, pi.max_decree);
+        ASSERT_EQ(10u, pi.points.size());
+        for (size_t i = 0; i < pi.points.size(); i++)
+        {
+            EXPECT_EQ(static_cast<decree>(i + 1), pi.points[i].max_decree);
+            if (i > 0)
+            {
+                EXPECT_LT(pi.points[i - 1].offset, pi.points[i].offset);
+            }
+        }
+
+        multi_partition_decrees committed_decrees;
+        EXPECT_EQ(file->start_offset(), file->replay_start_offset(committed_decrees));
+        committed_decrees[p0] = 4;
+        EXPECT_EQ(pi.points[4].offset, file->replay_start_offset(committed_decrees));
+        committed_decrees[p0] = 10;
+        EXPECT_EQ(file->end_offset(), file->replay_start_offset(committed_decrees));
+
+        // replay starts from the block of decree 5
+        std::vector<decree> decrees;
+        committed_decrees[p0] = 4;
+        EXPECT_TRUE(logs[0]->replay([&](mutation_ptr& mu) { decrees.push_back(mu->data.header.decree); }, committed_decrees) == ERR_OK);
+        ASSERT_EQ(6u, decrees.size());
+        for (size_t i = 0; i < decrees.size(); i++)
+        {
+            EXPECT_EQ(static_cast<decree>(i + 5), decrees[i]);
+        }
+        close_logs(logs);
+    });
+
+    // a file not matching its index (e.g., losing its tail in a crash) is fully replayed
+    boost::filesystem::resize_file(file_path, boost::filesystem::file_size(file_path) - 1);
+    run_log_test([&]()
+    {
+        logs.push_back(open_log(dir));
+        auto& files = logs[0]->get_logfiles_for_test();
+        ASSERT_EQ(1u, files.size());
+        EXPECT_FALSE(files.begin()->second->has_decree_index());
+        close_logs(logs);
+    });
+
+    boost::filesystem::remove_all(dir);
+}
+
+static std::string read_file(const std::string& path)
+{
+    std::ifstream is(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string& path, const std::string& content)
+{
+    std::ofstream os(path, std::ios::binary | std::ios::trunc);
+    os.write(content.data(), content.size());
+}
+
+TEST(replication, mutation_log_decree_index_corrupt)
+{
+    std::string dir = "./test_log_index_corrupt";
+    boost::filesystem::remove_all(dir);
+
+    global_partition_id p0;
+    p0.app_id = 1; p0.pidx = 0;
+
+    std::vector<mutation_log*> logs;
+    run_log_test([&]()
+    {
+        logs.push_back(open_log(dir));
+        multi_partition_decrees init_decrees;
+        EXPECT_TRUE(logs[0]->start_write_service(init_decrees, 20) == ERR_OK);
+        for (decree d = 1; d <= 10; d++)
+        {
+            append_mutation(logs[0], p0, 1, d);
+        }
+        close_logs(logs);
+    });
+
+    std::string index_path;
+    int64_t start_offset = 0, end_offset = 0;
+    run_log_test([&]()
+    {
+        logs.push_back(open_log(dir));
+        auto& files = logs[0]->get_logfiles_for_test();
+        ASSERT_EQ(1u, files.size());
+        ASSERT_TRUE(files.begin()->second->has_decree_index());
+        index_path = files.begin()->second->path() + ".index";
+        start_offset = files.begin()->second->start_offset();
+        end_offset = files.begin()->second->end_offset();
+        close_logs(logs);
+    });
+    std::string index = read_file(index_path);
+    ASSERT_LT(static_cast<size_t>(MSG_HDR_SERIALIZED_SIZE), index.size());
+
+    // forged indexes are sealed properly so that only the checks on their content reject them
+    auto forge_index = [&](std::function<void(binary_writer&)> write_body)
+    {
+        std::string content;
+        run_log_test([&]()
+        {
+            message_ptr msg = message::create_request(RPC_PREPARE, 0, LOG_BLOCK_CODEC_NONE);
+            msg->writer().write(LOG_DECREE_INDEX_MAGIC);
+            msg->writer().write(end_offset);
+            write_body(msg->writer());
+            msg->seal(true);
+
+            std::vector<blob> bbs;
+            msg->writer().get_buffers(bbs);
+            for (auto& bb : bbs)
+            {
+                content.append(bb.data(), bb.length());
+            }
+        });
+        return content;
+    };
+
+    std::vector<std::string> corrupts;
+
+    // truncated
+    corrupts.push_back(index.substr(0, index.size() - 8));
+    corrupts.push_back(index.substr(0, MSG_HDR_SERIALIZED_SIZE / 2));
+
+    // a bit flipped in the body
+    corrupts.push_back(index);
+    corrupts.back()[MSG_HDR_SERIALIZED_SIZE + 12] ^= 0x10;
+
+    // huge or negative counts
+    corrupts.push_back(forge_index([](binary_writer& writer) { writer.write(0x7fffffff); }));
+    corrupts.push_back(forge_index([](binary_writer& writer) { writer.write(-1); }));
+    corrupts.push_back(forge_index([&](binary_writer& writer)
+    {
+        writer.write(1);
+        writer.write_pod(p0);
+        writer.write(static_cast<decree>(1));
+        writer.write(static_cast<decree>(10));
+        writer.write(0x7fffffff);
+    }));
+
+    // points out of the file
+    int64_t bad_offsets[] = { end_offset, end_offset + 4096, start_offset - 1 };
+    for (auto offset : bad_offsets)
+    {
+        corrupts.push_back(forge_index([&](binary_writer& writer)
+        {
+            writer.write(1);
+            writer.write_pod(p0);
+            writer.write(static_cast<decree>(1));
+            writer.write(static_cast<decree>(10));
+            writer.write(1);
+            writer.write(offset);
+            writer.write(static_cast<decree>(10));
+        }));
+    }
+
+    // each is ignored and the file is fully scanned
+    for (size_t i = 0; i < corrupts.size(); i++)
+    {
+        write_file(index_path, corrupts[i]);
+        run_log_test([&]()
+        {
+            logs.push_back(open_log(dir));
+            auto& files = logs[0]->get_logfiles_for_test();
+            ASSERT_EQ(1u, files.size());
+            EXPECT_FALSE(files.begin()->second->has_decree_index()) << "corrupt index " << i;
+
+            std::vector<decree> decrees;
+            multi_partition_decrees committed_decrees;
+            committed_decrees[p0] = 4;
+            EXPECT_TRUE(logs[0]->replay([&](mutation_ptr& mu) { decrees.push_back(mu->data.header.decree); }, committed_decrees) == ERR_OK);
+            ASSERT_EQ(10u, decrees.size()) << "corrupt index " << i;
+            for (size_t j = 0; j < decrees.size(); j++)
+            {
+                EXPECT_EQ(static_cast<decree>(j + 1), decrees[j]);
+            }
+            close_logs(logs);
+        });
+    }
+
+    // the full scan saves a valid index again
+    run_log_test([&]()
+    {
+        logs.push_back(open_log(dir));
+        EXPECT_TRUE(logs[0]->get_logfiles_for_test().begin()->second->has_decree_index());
+        close_logs(logs);
+    });
+
+    boost::filesystem::remove_all(dir);
+}
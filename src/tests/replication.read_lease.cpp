@@ -0,0 +1,116 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+# include "replica_test_harness.h"
+# include <gtest/gtest.h>
+
+using namespace ::dsn;
+using namespace ::dsn::replication;
+
+TEST(replication, read_lease)
+{
+    secondary_context ctx;
+    EXPECT_FALSE(ctx.check_read_lease(1, 10, 0));
+
+    // valid for its ballot until it expires, once the primary's commit point is applied
+    ctx.renew_read_lease(1, 5, 1000);
+    EXPECT_TRUE(ctx.check_read_lease(1, 5, 999));
+    EXPECT_TRUE(ctx.check_read_lease(1, 6, 0));
+    EXPECT_FALSE(ctx.check_read_lease(1, 5, 1000));
+    EXPECT_FALSE(ctx.check_read_lease(1, 4, 500));
+    EXPECT_FALSE(ctx.check_read_lease(2, 5, 500));
+
+    // renewals extend it, and never lower the commit point
+    ctx.renew_read_lease(1, 3, 2000);
+    EXPECT_TRUE(ctx.check_read_lease(1, 5, 1500));
+    EXPECT_FALSE(ctx.check_read_lease(1, 4, 1500));
+
+    // a new ballot starts over
+    ctx.renew_read_lease(2, 3, 3000);
+    EXPECT_TRUE(ctx.check_read_lease(2, 3, 2500));
+    EXPECT_FALSE(ctx.check_read_lease(1, 5, 2500));
+
+    ctx.cleanup();
+    EXPECT_FALSE(ctx.check_read_lease(2, 3, 2500));
+}
+
+TEST(replication, replica_lease_read)
+{
+    replication_options options;
+    options.read_lease_ms = 3600 * 1000;
+
+    run_replica_test([&]()
+    {
+        auto stub = replication_tester::create_stub("./test_replica_lease", options);
+
+        global_partition_id gpid;
+        gpid.app_id = 1; gpid.pidx = 0;
+        auto r = replication_tester::create_replica(stub, gpid);
+        ASSERT_TRUE(r != nullptr);
+        replication_tester::commit_mutations(r, 5, [](decree d) { return std::vector<std::string>(1, "v"); });
+        auto& reads = replication_tester::app(r)->reads;
+
+        // a secondary without a lease refuses, and the client goes to the primary
+        replication_tester::set_ballot(r, 1);
+        replication_tester::set_status(r, PS_SECONDARY);
+        replication_tester::read(r, read_semantic_t::ReadLastUpdate, invalid_decree);
+        EXPECT_TRUE(reads.empty());
+
+        // a group check from the primary grants the lease
+        group_check_request request;
+        request.config.gpid = gpid;
+        request.config.ballot = 1;
+        request.config.status = PS_SECONDARY;
+        request.last_committed_decree = 5;
+        request.learner_signature = 0;
+        group_check_response response;
+        r->on_group_check(request, response);
+        EXPECT_TRUE(response.err == ERR_OK);
+
+        replication_tester::read(r, read_semantic_t::ReadLastUpdate, invalid_decree);
+        ASSERT_EQ(1u, reads.size());
+        EXPECT_EQ(invalid_decree, reads[0]);
+
+        // a lease of an older ballot is void, and the older primary cannot renew it
+        replication_tester::set_ballot(r, 2);
+        request.last_committed_decree = 6;
+        r->on_group_check(request, response);
+        EXPECT_TRUE(response.err == ERR_VERSION_OUTDATED);
+        replication_tester::read(r, read_semantic_t::ReadLastUpdate, invalid_decree);
+        EXPECT_EQ(1u, reads.size());
+
+        // primaries serve them without a lease
+        replication_tester::set_status(r, PS_PRIMARY);
+        replication_tester::read(r, read_semantic_t::ReadLastUpdate, invalid_decree);
+        EXPECT_EQ(2u, reads.size());
+
+        replication_tester::set_status(r, PS_INACTIVE);
+        r->close();
+        stub->close();
+    });
+
+    boost::filesystem::remove_all("./test_replica_lease");
+}
@@ -0,0 +1,133 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+# include "replica_test_harness.h"
+# include <gtest/gtest.h>
+
+using namespace ::dsn;
+using namespace ::dsn::replication;
+
+// values large enough for a learning round to carry three of them only
+static std::vector<std::string> learn_test_values(decree d)
+{
+    return std::vector<std::string>(1, std::string(400 * 1024, static_cast<char>('a' + d)));
+}
+
+TEST(replication, replica_learn_mutations)
+{
+    replication_options options;
+    options.learn_mutation_max_size_mb = 1;
+
+    run_replica_test([&]()
+    {
+        auto stub = replication_tester::create_stub("./test_replica_learn", options);
+
+        global_partition_id gpid;
+        gpid.app_id = 1; gpid.pidx = 0;
+        auto primary = replication_tester::create_replica(stub, gpid);
+        ASSERT_TRUE(primary != nullptr);
+        replication_tester::commit_mutations(primary, 5, learn_test_values);
+        ASSERT_EQ(5, primary->last_committed_decree());
+
+        gpid.pidx = 1;
+        auto learner = replication_tester::create_replica(stub, gpid);
+        ASSERT_TRUE(learner != nullptr);
+
+        // the first round stops at the size limit
+        std::vector<blob> mutations;
+        ASSERT_TRUE(replication_tester::get_learn_mutations(primary, 1, mutations));
+        ASSERT_EQ(3u, mutations.size());
+        EXPECT_EQ(0, replication_tester::apply_learn_mutations(learner, mutations));
+        EXPECT_EQ(3, learner->get_app()->last_committed_decree());
+
+        // the next round starts after what the learner has applied, and a round
+        // applied again (e.g., a retried round) changes nothing
+        std::vector<blob> mutations2;
+        ASSERT_TRUE(replication_tester::get_learn_mutations(primary, learner->get_app()->last_committed_decree() + 1, mutations2));
+        ASSERT_EQ(2u, mutations2.size());
+        EXPECT_EQ(0, replication_tester::apply_learn_mutations(learner, mutations2));
+        EXPECT_EQ(0, replication_tester::apply_learn_mutations(learner, mutations));
+        EXPECT_EQ(5, learner->get_app()->last_committed_decree());
+
+        auto& values = replication_tester::app(learner)->values;
+        ASSERT_EQ(5u, values.size());
+        for (decree d = 1; d <= 5; d++)
+        {
+            EXPECT_EQ(learn_test_values(d)[0], values[d - 1]);
+        }
+
+        primary->close();
+        learner->close();
+        stub->close();
+    });
+
+    boost::filesystem::remove_all("./test_replica_learn");
+}
+
+TEST(replication, replica_learn_mutations_empty)
+{
+    replication_options options;
+
+    run_replica_test([&]()
+    {
+        auto stub = replication_tester::create_stub("./test_replica_learn_empty", options);
+
+        global_partition_id gpid;
+        gpid.app_id = 1; gpid.pidx = 0;
+        auto primary = replication_tester::create_replica(stub, gpid);
+        ASSERT_TRUE(primary != nullptr);
+
+        // nothing committed yet
+        std::vector<blob> mutations;
+        EXPECT_FALSE(replication_tester::get_learn_mutations(primary, 1, mutations));
+        EXPECT_TRUE(mutations.empty());
+
+        // nothing beyond the commit point, so the learner gets the app state instead
+        replication_tester::commit_mutations(primary, 3, [](decree d) { return std::vector<std::string>(1, "v"); });
+        EXPECT_FALSE(replication_tester::get_learn_mutations(primary, 4, mutations));
+        EXPECT_TRUE(mutations.empty());
+
+        // applying an empty round changes nothing
+        gpid.pidx = 1;
+        auto learner = replication_tester::create_replica(stub, gpid);
+        ASSERT_TRUE(learner != nullptr);
+        EXPECT_EQ(0, replication_tester::apply_learn_mutations(learner, mutations));
+        EXPECT_EQ(0, learner->get_app()->last_committed_decree());
+        EXPECT_TRUE(replication_tester::app(learner)->values.empty());
+
+        // and a round not continuous with the learner is refused
+        ASSERT_TRUE(replication_tester::get_learn_mutations(primary, 2, mutations));
+        ASSERT_EQ(2u, mutations.size());
+        EXPECT_EQ(ERR_INVALID_DATA.get(), replication_tester::apply_learn_mutations(learner, mutations));
+        EXPECT_EQ(0, learner->get_app()->last_committed_decree());
+
+        primary->close();
+        learner->close();
+        stub->close();
+    });
+
+    boost::filesystem::remove_all("./test_replica_learn_empty");
+}
@@ -0,0 +1,98 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+# include "replica_test_harness.h"
+# include <gtest/gtest.h>
+
+using namespace ::dsn;
+using namespace ::dsn::replication;
+
+TEST(replication, replica_snapshot_read)
+{
+    replication_options options;
+
+    run_replica_test([&]()
+    {
+        auto stub = replication_tester::create_stub("./test_replica_read", options);
+
+        global_partition_id gpid;
+        gpid.app_id = 1; gpid.pidx = 0;
+        auto r = replication_tester::create_replica(stub, gpid);
+        ASSERT_TRUE(r != nullptr);
+        replication_tester::commit_mutations(r, 5, [](decree d) { return std::vector<std::string>(1, "v"); });
+        auto app = replication_tester::app(r);
+        auto& reads = app->reads;
+
+        // not served before the replica joins the group
+        replication_tester::read(r, read_semantic_t::ReadSnapshot, 5);
+        replication_tester::set_status(r, PS_POTENTIAL_SECONDARY);
+        replication_tester::read(r, read_semantic_t::ReadSnapshot, 5);
+        EXPECT_TRUE(reads.empty());
+
+        // served on secondaries and primaries alike, at the decree asked or at
+        // the latest committed one when none is given
+        replication_tester::set_status(r, PS_SECONDARY);
+        replication_tester::read(r, read_semantic_t::ReadSnapshot, 5);
+        replication_tester::read(r, read_semantic_t::ReadSnapshot, invalid_decree);
+        replication_tester::set_status(r, PS_PRIMARY);
+        replication_tester::read(r, read_semantic_t::ReadSnapshot, 5);
+        ASSERT_EQ(3u, reads.size());
+        EXPECT_EQ(5, reads[0]);
+        EXPECT_EQ(5, reads[1]);
+        EXPECT_EQ(5, reads[2]);
+        EXPECT_EQ(invalid_decree, replication_app_base::read_decree());
+
+        // an app without versions is readable at its latest decree only, and
+        // none is readable beyond it
+        reads.clear();
+        replication_tester::set_status(r, PS_SECONDARY);
+        replication_tester::read(r, read_semantic_t::ReadSnapshot, 4);
+        replication_tester::read(r, read_semantic_t::ReadSnapshot, 6);
+        EXPECT_TRUE(reads.empty());
+
+        // with versions kept, any retained decree is readable
+        app->oldest_version = 2;
+        replication_tester::read(r, read_semantic_t::ReadSnapshot, 1);
+        replication_tester::read(r, read_semantic_t::ReadSnapshot, 2);
+        replication_tester::read(r, read_semantic_t::ReadSnapshot, 4);
+        replication_tester::read(r, read_semantic_t::ReadSnapshot, 6);
+        ASSERT_EQ(2u, reads.size());
+        EXPECT_EQ(2, reads[0]);
+        EXPECT_EQ(4, reads[1]);
+
+        // other reads are served at the latest state
+        reads.clear();
+        replication_tester::read(r, read_semantic_t::ReadOutdated, invalid_decree);
+        ASSERT_EQ(1u, reads.size());
+        EXPECT_EQ(invalid_decree, reads[0]);
+
+        replication_tester::set_status(r, PS_INACTIVE);
+        r->close();
+        stub->close();
+    });
+
+    boost::filesystem::remove_all("./test_replica_read");
+}
@@ -0,0 +1,98 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+# include "replica_test_harness.h"
+# include <gtest/gtest.h>
+
+using namespace ::dsn;
+using namespace ::dsn::replication;
+
+TEST(replication, replica_stub_lookup)
+{
+    replication_options options;
+
+    run_replica_test([&]()
+    {
+        auto stub = replication_tester::create_stub("./test_replica_stub", options);
+
+        global_partition_id gpid;
+        gpid.app_id = 1; gpid.pidx = 0;
+        EXPECT_TRUE(stub->get_replica(gpid) == nullptr);
+
+        // created on demand, and found by the lookups afterwards
+        auto r = stub->get_replica(gpid, true, "test_app");
+        ASSERT_TRUE(r != nullptr);
+        EXPECT_EQ(r.get(), stub->get_replica(gpid).get());
+        EXPECT_EQ(r.get(), stub->get_replica(gpid, true, "test_app").get());
+
+        // enough replicas for the table to grow several times
+        std::vector<replica_ptr> rs;
+        for (int app_id = 1; app_id <= 4; app_id++)
+        {
+            for (int pidx = 0; pidx < 16; pidx++)
+            {
+                if (app_id == 1 && pidx == 0)
+                    continue;
+
+                global_partition_id gpid2;
+                gpid2.app_id = app_id; gpid2.pidx = pidx;
+                rs.push_back(replication_tester::create_replica(stub, gpid2));
+                ASSERT_TRUE(rs.back() != nullptr);
+                replication_tester::add_replica(stub, rs.back());
+            }
+        }
+
+        for (auto& r2 : rs)
+        {
+            EXPECT_EQ(r2.get(), stub->get_replica(r2->get_gpid().app_id, r2->get_gpid().pidx).get());
+        }
+        EXPECT_TRUE(stub->get_replica(5, 0) == nullptr);
+        EXPECT_TRUE(stub->get_replica(1, 16) == nullptr);
+
+        // a removed replica is no longer found, but stays alive while a
+        // lookup still holds the table it was found in
+        auto old_table = replication_tester::replica_table(stub);
+        long refs = r->ref_counter.load();
+        EXPECT_TRUE(replication_tester::remove_replica(stub, r));
+        EXPECT_FALSE(replication_tester::remove_replica(stub, r));
+        EXPECT_TRUE(stub->get_replica(gpid) == nullptr);
+        EXPECT_EQ(refs - 1, r->ref_counter.load());
+
+        old_table = nullptr;
+        EXPECT_EQ(refs - 2, r->ref_counter.load());
+
+        for (auto& r2 : rs)
+        {
+            EXPECT_EQ(r2.get(), stub->get_replica(r2->get_gpid()).get());
+        }
+
+        r->close();
+        stub->close();
+        EXPECT_TRUE(stub->get_replica(rs[0]->get_gpid()) == nullptr);
+    });
+
+    boost::filesystem::remove_all("./test_replica_stub");
+}
@@ -0,0 +1,168 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+# include "replica_test_harness.h"
+# include <gtest/gtest.h>
+
+using namespace ::dsn;
+using namespace ::dsn::replication;
+
+static end_point server_state_test_node(uint32_t ip)
+{
+    end_point ep;
+    ep.ip = ip;
+    ep.port = 34801;
+    return ep;
+}
+
+static void server_state_test_update(server_state& state, const end_point& node, config_type type, int pidx, std::function<void(partition_configuration&)> change)
+{
+    configuration_update_request request;
+    request.node = node;
+    request.type = type;
+
+    global_partition_id gpid;
+    gpid.app_id = 1;
+    gpid.pidx = pidx;
+    state.query_configuration_by_gpid(gpid, request.config);
+    request.config.ballot++;
+    change(request.config);
+
+    configuration_update_response response;
+    state.update_configuration(request, response);
+    ASSERT_TRUE(response.err == ERR_OK);
+}
+
+static configuration_query_by_node_response server_state_test_query(server_state& state, const end_point& node, int64_t epoch, int64_t version)
+{
+    configuration_query_by_node_request request;
+    request.node = node;
+    request.known_epoch = epoch;
+    request.known_version = version;
+
+    configuration_query_by_node_response response;
+    state.query_configuration_by_node(request, response);
+    return response;
+}
+
+static std::set<int> server_state_test_pidxs(const configuration_query_by_node_response& response)
+{
+    std::set<int> pidxs;
+    for (auto& pc : response.partitions)
+        pidxs.insert(pc.gpid.pidx);
+    return pidxs;
+}
+
+TEST(replication, server_state_query_by_node)
+{
+    server_state state;
+    replication_tester::init_server_state(state, 4);
+
+    end_point a = server_state_test_node(1), b = server_state_test_node(2), c = server_state_test_node(3);
+    node_states nodes;
+    nodes.push_back(std::make_pair(a, true));
+    nodes.push_back(std::make_pair(b, true));
+    state.set_node_state(nodes, nullptr);
+
+    EXPECT_TRUE(server_state_test_query(state, c, 0, 0).err == ERR_OBJECT_NOT_FOUND);
+
+    // a is the primary of 0 and 1
+    for (int pidx = 0; pidx < 2; pidx++)
+    {
+        server_state_test_update(state, a, CT_ASSIGN_PRIMARY, pidx, [&](partition_configuration& pc) { pc.primary = a; });
+    }
+
+    // full sync
+    auto full = server_state_test_query(state, a, 0, 0);
+    EXPECT_TRUE(full.err == ERR_OK);
+    EXPECT_FALSE(full.is_delta);
+    EXPECT_EQ(std::set<int>({ 0, 1 }), server_state_test_pidxs(full));
+    EXPECT_TRUE(full.removed_partitions.empty());
+
+    // nothing changed since
+    auto delta = server_state_test_query(state, a, full.epoch, full.version);
+    EXPECT_TRUE(delta.is_delta);
+    EXPECT_EQ(full.version, delta.version);
+    EXPECT_TRUE(delta.partitions.empty());
+    EXPECT_TRUE(delta.removed_partitions.empty());
+
+    // a version of another meta server instance, or one never handed out, gets a full sync
+    EXPECT_FALSE(server_state_test_query(state, a, full.epoch + 1, full.version).is_delta);
+    EXPECT_FALSE(server_state_test_query(state, a, full.epoch, full.version + 1).is_delta);
+
+    // a delta after a config change: b is added to 0, which a is told about as its primary
+    server_state_test_update(state, b, CT_ADD_SECONDARY, 0, [&](partition_configuration& pc) { pc.secondaries.push_back(b); });
+    delta = server_state_test_query(state, a, full.epoch, full.version);
+    EXPECT_TRUE(delta.is_delta);
+    EXPECT_GT(delta.version, full.version);
+    ASSERT_EQ(1u, delta.partitions.size());
+    EXPECT_EQ(0, delta.partitions[0].gpid.pidx);
+    ASSERT_EQ(1u, delta.partitions[0].secondaries.size());
+    EXPECT_TRUE(delta.partitions[0].secondaries[0] == b);
+    EXPECT_TRUE(delta.removed_partitions.empty());
+
+    auto delta_b = server_state_test_query(state, b, 0, 0);
+    EXPECT_EQ(std::set<int>({ 0 }), server_state_test_pidxs(delta_b));
+
+    // a delta after a partition is removed from a
+    int64_t version = delta.version;
+    server_state_test_update(state, a, CT_REMOVE, 1, [&](partition_configuration& pc) { pc.primary = end_point::INVALID; });
+    delta = server_state_test_query(state, a, full.epoch, version);
+    EXPECT_TRUE(delta.is_delta);
+    EXPECT_GT(delta.version, version);
+    EXPECT_TRUE(delta.partitions.empty());
+    ASSERT_EQ(1u, delta.removed_partitions.size());
+    EXPECT_EQ(1, delta.removed_partitions[0].pidx);
+
+    // kept until a acknowledges the delta by querying with its version, e.g., when the reply is lost
+    EXPECT_EQ(1u, replication_tester::removed_partition_count(state, a));
+    auto retried = server_state_test_query(state, a, full.epoch, version);
+    EXPECT_EQ(1u, retried.removed_partitions.size());
+
+    // pruned on a full sync, which lists what a hosts
+    full = server_state_test_query(state, a, 0, 0);
+    EXPECT_EQ(std::set<int>({ 0 }), server_state_test_pidxs(full));
+    EXPECT_EQ(0u, replication_tester::removed_partition_count(state, a));
+
+    // and on delta acknowledgement
+    server_state_test_update(state, a, CT_DOWNGRADE_TO_INACTIVE, 0, [&](partition_configuration& pc) { pc.primary = end_point::INVALID; });
+    delta = server_state_test_query(state, a, full.epoch, full.version);
+    ASSERT_EQ(1u, delta.removed_partitions.size());
+    EXPECT_EQ(0, delta.removed_partitions[0].pidx);
+    EXPECT_EQ(1u, replication_tester::removed_partition_count(state, a));
+
+    auto acked = server_state_test_query(state, a, delta.epoch, delta.version);
+    EXPECT_TRUE(acked.is_delta);
+    EXPECT_TRUE(acked.partitions.empty());
+    EXPECT_TRUE(acked.removed_partitions.empty());
+    EXPECT_EQ(0u, replication_tester::removed_partition_count(state, a));
+
+    // a partition that comes back is no longer removed
+    server_state_test_update(state, a, CT_ASSIGN_PRIMARY, 1, [&](partition_configuration& pc) { pc.primary = a; });
+    delta = server_state_test_query(state, a, acked.epoch, acked.version);
+    EXPECT_EQ(std::set<int>({ 1 }), server_state_test_pidxs(delta));
+    EXPECT_TRUE(delta.removed_partitions.empty());
+}
@@ -0,0 +1,231 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+# include "task_engine.h"
+# include "simple_task_queue.h"
+# include "hpc_task_queue.h"
+# include "lockfree_task_queue.h"
+# include "work_stealing_task_queue.h"
+# include "test_harness.h"
+# include <gtest/gtest.h>
+# include <thread>
+# include <memory>
+
+using namespace ::dsn;
+using namespace ::dsn::tools;
+
+DEFINE_TASK_CODE(LPC_TASK_QUEUE_CONCURRENT, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+DEFINE_TASK_CODE(LPC_TASK_QUEUE_WORK_STEALING, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+DEFINE_TASK_CODE(LPC_TASK_QUEUE_NO_STEALING, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+class concurrent_task : public task
+{
+public:
+    concurrent_task() : task(LPC_TASK_QUEUE_CONCURRENT, 0, dsn::test::test_node()) {}
+    virtual void exec() {}
+};
+
+static const int CONCURRENT_TASK_COUNT = 20000;
+static const int CONCURRENT_CONSUMER_COUNT = 2;
+static const int CONCURRENT_DEQUEUE_BATCH_SIZE = 8;
+
+// consumer i dequeues from queue i % queue_count, and producers all enqueue to the first
+// queue; every task must be consumed exactly once and the queues left empty
+template<typename TQueue>
+static void test_concurrent_task_queue(int producer_count, int queue_count = 1)
+{
+    threadpool_spec spec(THREAD_POOL_DEFAULT);
+    task_engine engine(nullptr);
+    task_worker_pool pool(spec, &engine);
+    std::vector<std::unique_ptr<TQueue>> queues;
+    for (int i = 0; i < queue_count; i++)
+        queues.push_back(std::unique_ptr<TQueue>(new TQueue(&pool, i, nullptr)));
+    TQueue& q = *queues[0];
+
+    // tasks are never executed nor released, so keep them out of the tools allocator
+    std::vector<concurrent_task> tasks(CONCURRENT_TASK_COUNT + CONCURRENT_CONSUMER_COUNT);
+    task* sentinels = &tasks[CONCURRENT_TASK_COUNT];
+    std::vector<std::atomic<int>> consumed(CONCURRENT_TASK_COUNT);
+    for (auto& c : consumed)
+        c = 0;
+
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < CONCURRENT_CONSUMER_COUNT; i++)
+    {
+        consumers.push_back(std::thread([&, i]()
+        {
+            TQueue& q = *queues[i % queue_count];
+            task* ts[CONCURRENT_DEQUEUE_BATCH_SIZE];
+            bool stop = false;
+            while (!stop)
+            {
+                int c = q.dequeue_batch(ts, CONCURRENT_DEQUEUE_BATCH_SIZE);
+                for (int j = 0; j < c; j++)
+                {
+                    if (ts[j] < sentinels)
+                        consumed[static_cast<concurrent_task*>(ts[j]) - &tasks[0]]++;
+
+                    // one sentinel per consumer, give back the extra ones taken in the same batch
+                    else if (stop)
+                        q.enqueue(ts[j]);
+                    else
+                        stop = true;
+                }
+            }
+        }));
+    }
+
+    std::vector<std::thread> producers;
+    for (int i = 0; i < producer_count; i++)
+    {
+        producers.push_back(std::thread([&, i]()
+        {
+            for (int j = i; j < CONCURRENT_TASK_COUNT; j += producer_count)
+            {
+                q.enqueue(&tasks[j]);
+            }
+        }));
+    }
+    for (auto& t : producers)
+        t.join();
+
+    for (int i = 0; i < CONCURRENT_CONSUMER_COUNT; i++)
+        queues[i % queue_count]->enqueue(&sentinels[i]);
+    for (auto& t : consumers)
+        t.join();
+
+    int lost = 0, duplicated = 0;
+    for (auto& c : consumed)
+    {
+        if (c == 0) lost++;
+        else if (c > 1) duplicated++;
+    }
+    EXPECT_EQ(0, lost);
+    EXPECT_EQ(0, duplicated);
+    for (auto& qi : queues)
+        EXPECT_EQ(0, qi->count());
+}
+
+TEST(tools, task_queue_concurrent)
+{
+    // the tasks are hash-free, and the second consumer of the work
+    // stealing queues only gets tasks by stealing them from the first one
+    task_spec::get(LPC_TASK_QUEUE_CONCURRENT)->allow_work_stealing = true;
+
+    int producer_counts[] = { 1, 8 };
+    for (auto p : producer_counts)
+    {
+        test_concurrent_task_queue<simple_task_queue>(p);
+        test_concurrent_task_queue<hpc_task_queue>(p);
+        test_concurrent_task_queue<lockfree_task_queue>(p);
+        test_concurrent_task_queue<work_stealing_task_queue>(p, CONCURRENT_CONSUMER_COUNT);
+    }
+}
+
+class queue_test_task : public task
+{
+public:
+    queue_test_task(task_code code, int hash) : task(code, hash, dsn::test::test_node()) {}
+    virtual void exec() {}
+};
+
+TEST(tools, work_stealing_task_queue)
+{
+    task_spec::get(LPC_TASK_QUEUE_WORK_STEALING)->allow_work_stealing = true;
+
+    threadpool_spec spec(THREAD_POOL_DEFAULT);
+    task_engine engine(nullptr);
+    task_worker_pool pool(spec, &engine);
+    work_stealing_task_queue q0(&pool, 0, nullptr);
+    work_stealing_task_queue q1(&pool, 1, nullptr);
+    work_stealing_task_queue q2(&pool, 2, nullptr);
+
+    std::vector<task_ptr> tasks;
+    for (int i = 0; i < 5; i++)
+        tasks.push_back(new queue_test_task(LPC_TASK_QUEUE_WORK_STEALING, 0));
+    std::vector<task_ptr> pinned;
+    pinned.push_back(new queue_test_task(LPC_TASK_QUEUE_WORK_STEALING, 1));
+    pinned.push_back(new queue_test_task(LPC_TASK_QUEUE_WORK_STEALING, 2));
+    pinned.push_back(new queue_test_task(LPC_TASK_QUEUE_NO_STEALING, 0));
+
+    // the owner runs its pinned tasks before the stealable ones, both in fifo order
+    q0.enqueue(tasks[0].get());
+    q0.enqueue(pinned[0].get());
+    q0.enqueue(tasks[1].get());
+    q0.enqueue(pinned[1].get());
+    q0.enqueue(tasks[2].get());
+    EXPECT_TRUE(pinned[0] == q0.dequeue());
+    EXPECT_TRUE(pinned[1] == q0.dequeue());
+    EXPECT_TRUE(tasks[0] == q0.dequeue());
+    EXPECT_TRUE(tasks[1] == q0.dequeue());
+    EXPECT_TRUE(tasks[2] == q0.dequeue());
+    EXPECT_EQ(0, q0.count());
+
+    // siblings steal the oldest stealable tasks, but never the hashed ones
+    // nor those whose spec does not allow work stealing
+    for (auto& t : pinned)
+        q0.enqueue(t.get());
+    for (int i = 0; i < 3; i++)
+        q0.enqueue(tasks[i].get());
+    EXPECT_TRUE(tasks[0] == q1.dequeue());
+    EXPECT_TRUE(tasks[1] == q2.dequeue());
+    EXPECT_TRUE(tasks[2] == q1.dequeue());
+    EXPECT_TRUE(nullptr == q1.dequeue());
+    EXPECT_TRUE(nullptr == q2.dequeue());
+    EXPECT_EQ(static_cast<int>(pinned.size()), q0.count());
+    for (auto& t : pinned)
+        EXPECT_TRUE(t == q0.dequeue());
+    EXPECT_EQ(0, q0.count());
+
+    // the thief picks the sibling with the most stealable tasks
+    q0.enqueue(tasks[0].get());
+    q1.enqueue(tasks[1].get());
+    q1.enqueue(tasks[2].get());
+    q1.enqueue(tasks[3].get());
+    EXPECT_TRUE(tasks[1] == q2.dequeue());
+    EXPECT_TRUE(tasks[2] == q2.dequeue());
+    EXPECT_TRUE(tasks[0] == q0.dequeue());
+    EXPECT_TRUE(tasks[3] == q1.dequeue());
+
+    // an idle sibling is woken up to steal when the owner already has queued tasks
+    task* stolen = nullptr;
+    std::thread idle_worker([&]()
+    {
+        while (stolen == nullptr)
+        {
+            stolen = q1.dequeue();
+        }
+    });
+    q0.enqueue(tasks[0].get());
+    q0.enqueue(tasks[1].get());
+    idle_worker.join();
+    EXPECT_TRUE(tasks[0] == stolen);
+    EXPECT_TRUE(tasks[1] == q0.dequeue());
+
+    EXPECT_EQ(0, q0.count());
+    EXPECT_EQ(0, q1.count());
+    EXPECT_EQ(0, q2.count());
+}
@@ -134,6 +134,7 @@ namespace dsn {
                 }
                 break;
             case AIO_Write:
+            case AIO_Sync:
                 if (service::env::probability() < s_fj_opts[callee->spec().code].disk_write_fail_ratio)
                 {
                     callee->set_error_code(ERR_FILE_OPERATION_FAILED);
@@ -25,7 +25,6 @@
  */
 
 # include "hpc_task_queue.h"
-# include "shared_io_service.h"
 
 # ifdef __TITLE__
 # undef __TITLE__
@@ -56,25 +55,7 @@ namespace dsn {
             }
             else
             {
-                std::shared_ptr<boost::asio::deadline_timer> timer(new boost::asio::deadline_timer(shared_io_service::instance().ios));
-                timer->expires_from_now(boost::posix_time::milliseconds(task->delay_milliseconds()));
-                task->set_delay(0);
-
-                timer->async_wait([this, task, timer](const boost::system::error_code& ec)
-                {
-                    if (!ec)
-                    {
-                        task->enqueue();
-                    }
-                    else
-                    {
-                        dfatal("delayed execution failed for task %s, err = %u",
-                            task->spec().name, ec.value());
-                    }
-
-                    // to consume the added ref count by another task::enqueue
-                    task->release_ref();
-                });
+                enqueue_delayed(task);
             }
         }
 
@@ -0,0 +1,112 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+# include "lockfree_task_queue.h"
+
+# ifdef __TITLE__
+# undef __TITLE__
+# endif
+# define __TITLE__ "task.queue.lockfree"
+
+namespace dsn {
+    namespace tools {
+
+        // initial node capacity of each queue, more are allocated on demand
+        static const int LOCKFREE_QUEUE_RESERVED_NODES = 1024;
+
+        lockfree_task_queue::lockfree_task_queue(task_worker_pool* pool, int index, task_queue* inner_provider)
+            : task_queue(pool, index, inner_provider)
+        {
+            _count = 0;
+            for (auto& q : _queues)
+            {
+                q = new task_queue_t(LOCKFREE_QUEUE_RESERVED_NODES);
+            }
+        }
+
+        lockfree_task_queue::~lockfree_task_queue()
+        {
+            for (auto& q : _queues)
+            {
+                delete q;
+            }
+        }
+
+        void lockfree_task_queue::enqueue(task* task)
+        {
+            if (task->delay_milliseconds() != 0)
+            {
+                enqueue_delayed(task);
+                return;
+            }
+
+            bool r = _queues[task->spec().priority]->push(task);
+            dassert(r, "push to lock-free queue failed, out of memory?");
+
+            _count.fetch_add(1, std::memory_order_release);
+            _sema.signal();
+        }
+
+        task* lockfree_task_queue::dequeue()
+        {
+            _sema.wait();
+            return pop();
+        }
+
+        int lockfree_task_queue::dequeue_batch(task** tasks, int max_count)
+        {
+            _sema.wait();
+
+            int count = 1;
+            while (count < max_count && _sema.try_wait())
+            {
+                count++;
+            }
+
+            for (int i = 0; i < count; i++)
+            {
+                tasks[i] = pop();
+            }
+            return count;
+        }
+
+        task* lockfree_task_queue::pop()
+        {
+            // a count is taken from the semaphore, so at least one task is there
+            task* t;
+            while (true)
+            {
+                for (int p = TASK_PRIORITY_COUNT - 1; p >= 0; p--)
+                {
+                    if (_queues[p]->pop(t))
+                    {
+                        _count.fetch_sub(1, std::memory_order_release);
+                        return t;
+                    }
+                }
+            }
+        }
+    }
+}
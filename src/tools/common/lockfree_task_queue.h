@@ -0,0 +1,62 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+# include <dsn/tool_api.h>
+# include <boost/lockfree/queue.hpp>
+# include <atomic>
+
+namespace dsn {
+    namespace tools {
+
+        //
+        // task queue backed by lock-free MPMC queues, one per priority level.
+        // The semaphore count is the number of queued tasks, so a worker that
+        // takes a count is guaranteed to find a task in one of the queues.
+        //
+        class lockfree_task_queue : public task_queue
+        {
+        public:
+            lockfree_task_queue(task_worker_pool* pool, int index, task_queue* inner_provider);
+            ~lockfree_task_queue();
+
+            virtual void     enqueue(task* task);
+            virtual task*    dequeue();
+            virtual int      dequeue_batch(task** tasks, int max_count);
+            virtual int      count() const { return _count.load(); }
+
+        private:
+            task* pop();
+
+        private:
+            typedef ::boost::lockfree::queue<task*> task_queue_t;
+
+            std::atomic<int>              _count;
+            task_queue_t                  *_queues[TASK_PRIORITY_COUNT];
+            ::dsn::utils::semaphore       _sema;
+        };
+    }
+}
@@ -30,6 +30,7 @@
 
 # include <fcntl.h>
 # include <cstdlib>
+# include <algorithm>
 
 # ifdef __TITLE__
 # undef __TITLE__
@@ -42,18 +43,42 @@ namespace dsn {
         native_linux_aio_provider::native_linux_aio_provider(disk_engine* disk, aio_provider* inner_provider)
             : aio_provider(disk, inner_provider)
         {
+            _queue_depth = config()->get_value<int>("aio.native", "queue_depth", 128);
+            _submit_batch_size = config()->get_value<int>("aio.native", "submit_batch_size", 64);
+            _reap_batch_size = config()->get_value<int>("aio.native", "reap_batch_size", 64);
+            int context_count = config()->get_value<int>("aio.native", "context_count", 1);
 
-            memset(&_ctx, 0, sizeof(_ctx));
-            auto ret = io_setup(128, &_ctx); // 128 concurrent events
-            dassert(ret == 0, "io_setup error, ret = %d", ret);
+            if (_queue_depth < 1) _queue_depth = 1;
+            if (_submit_batch_size < 1) _submit_batch_size = 1;
+            if (_reap_batch_size < 1) _reap_batch_size = 1;
+            if (context_count < 1) context_count = 1;
 
-            new std::thread(std::bind(&native_linux_aio_provider::get_event, this));
+            _fdsync_unsupported = false;
+
+            _iocbs_per_submit = utils::perf_counters::instance().get_counter(
+                "aio.native.iocbs_per_submit", COUNTER_TYPE_NUMBER_PERCENTILES, true);
+
+            for (int i = 0; i < context_count; i++)
+            {
+                auto ctx = new io_context();
+                memset(&ctx->ctx, 0, sizeof(ctx->ctx));
+                ctx->is_submitting = false;
+
+                auto ret = io_setup(_queue_depth, &ctx->ctx);
+                dassert(ret == 0, "io_setup error, ret = %d", ret);
+
+                _contexts.push_back(ctx);
+                new std::thread(std::bind(&native_linux_aio_provider::get_event, this, ctx));
+            }
         }
 
         native_linux_aio_provider::~native_linux_aio_provider()
         {
-            auto ret = io_destroy(_ctx);
-            dassert(ret == 0, "io_destroy error, ret = %d", ret);
+            for (auto& ctx : _contexts)
+            {
+                auto ret = io_destroy(ctx->ctx);
+                dassert(ret == 0, "io_destroy error, ret = %d", ret);
+            }
         }
 
         handle_t native_linux_aio_provider::open(const char* file_name, int flag, int pmode)
@@ -82,20 +107,83 @@ namespace dsn {
             aio_internal(aio_tsk, true);
         }
 
-        void native_linux_aio_provider::get_event()
+        void native_linux_aio_provider::get_event(io_context* ctx)
         {
-            struct io_event events[1];
+            std::vector<struct io_event> events(_reap_batch_size);
             int ret;
-            linux_disk_aio_context * aio;
 
             while (true)
             {
-                ret = io_getevents(_ctx, 1, 1, events, NULL);
-                if (ret > 0) // should be 1
+                ret = io_getevents(ctx->ctx, 1, _reap_batch_size, &events[0], NULL);
+                for (int i = 0; i < ret; i++)
+                {
+                    struct iocb *io = events[i].obj;
+                    int res = static_cast<int>(events[i].res);
+                    if (res < 0)
+                    {
+                        complete_aio(io, 0, -res);
+                    }
+                    else
+                    {
+                        complete_aio(io, res, static_cast<int>(events[i].res2));
+                    }
+                }
+            }
+        }
+
+        void native_linux_aio_provider::submit(io_context* ctx, struct iocb* cb)
+        {
+            std::vector<struct iocb*> cbs;
+            {
+                utils::auto_lock<::dsn::utils::ex_lock_nr> l(ctx->lock);
+                ctx->pending.push_back(cb);
+
+                // the current submitter will pick it up
+                if (ctx->is_submitting)
+                    return;
+                ctx->is_submitting = true;
+            }
+
+            while (true)
+            {
+                {
+                    utils::auto_lock<::dsn::utils::ex_lock_nr> l(ctx->lock);
+                    if (ctx->pending.empty())
+                    {
+                        ctx->is_submitting = false;
+                        return;
+                    }
+                    cbs.swap(ctx->pending);
+                }
+
+                submit_batch(ctx, cbs);
+                cbs.clear();
+            }
+        }
+
+        void native_linux_aio_provider::submit_batch(io_context* ctx, std::vector<struct iocb*>& cbs)
+        {
+            size_t offset = 0;
+            while (offset < cbs.size())
+            {
+                int count = static_cast<int>(std::min(cbs.size() - offset, (size_t)_submit_batch_size));
+                int ret = io_submit(ctx->ctx, count, &cbs[offset]);
+                if (ret > 0)
+                {
+                    _iocbs_per_submit->set(ret);
+                    offset += ret;
+                }
+
+                // the io context is full, wait for some completions
+                else if (ret == -EAGAIN || ret == 0)
+                {
+                    std::this_thread::yield();
+                }
+                else
                 {
-                    dassert(ret == 1, "");
-                    struct iocb *io = events[0].obj;
-                    complete_aio(io, static_cast<int>(events[0].res), static_cast<int>(events[0].res2));
+                    derror("io_submit error, ret = %d", ret);
+                    complete_aio(cbs[offset], 0, -ret);
+                    offset++;
                 }
             }
         }
@@ -103,6 +191,13 @@ namespace dsn {
         void native_linux_aio_provider::complete_aio(struct iocb* io, int bytes, int err)
         {
             linux_disk_aio_context* aio = CONTAINING_RECORD(io, linux_disk_aio_context, cb);
+            if (err == EINVAL && io->aio_lio_opcode == IO_CMD_FDSYNC)
+            {
+                // asynchronous fdatasync is not supported on this file, do it inline from now on
+                _fdsync_unsupported = true;
+                err = (::fdatasync(io->aio_fildes) == 0) ? 0 : errno;
+            }
+
             if (err != 0)
             {
                 derror("aio error, err = %d", err);
@@ -123,9 +218,7 @@ namespace dsn {
 
         error_code native_linux_aio_provider::aio_internal(aio_task_ptr& aio_tsk, bool async, __out_param uint32_t* pbytes /*= nullptr*/)
         {
-            struct iocb *cbs[1];
             linux_disk_aio_context * aio;
-            int ret;
 
             aio = (linux_disk_aio_context *)aio_tsk->aio().get();
 
@@ -133,13 +226,41 @@ namespace dsn {
 
             aio->this_ = this;
 
+            bool vectored = false;
+            if (!aio->buffers.empty() && aio->type != AIO_Sync)
+            {
+                if (aio->buffers.size() <= IOV_MAX)
+                {
+                    aio->iovs.resize(aio->buffers.size());
+                    for (size_t i = 0; i < aio->buffers.size(); i++)
+                    {
+                        aio->iovs[i].iov_base = aio->buffers[i].buffer;
+                        aio->iovs[i].iov_len = aio->buffers[i].size;
+                    }
+                    vectored = true;
+                }
+                else
+                {
+                    gather_buffers(aio);
+                }
+            }
+
             switch (aio->type)
             {
             case AIO_Read:
-                io_prep_pread(&aio->cb, static_cast<int>((ssize_t)aio->file), aio->buffer, aio->buffer_size, aio->file_offset);
+                if (vectored)
+                    io_prep_preadv(&aio->cb, static_cast<int>((ssize_t)aio->file), &aio->iovs[0], static_cast<int>(aio->iovs.size()), aio->file_offset);
+                else
+                    io_prep_pread(&aio->cb, static_cast<int>((ssize_t)aio->file), aio->buffer, aio->buffer_size, aio->file_offset);
                 break;
             case AIO_Write:
-                io_prep_pwrite(&aio->cb, static_cast<int>((ssize_t)aio->file), aio->buffer, aio->buffer_size, aio->file_offset);
+                if (vectored)
+                    io_prep_pwritev(&aio->cb, static_cast<int>((ssize_t)aio->file), &aio->iovs[0], static_cast<int>(aio->iovs.size()), aio->file_offset);
+                else
+                    io_prep_pwrite(&aio->cb, static_cast<int>((ssize_t)aio->file), aio->buffer, aio->buffer_size, aio->file_offset);
+                break;
+            case AIO_Sync:
+                io_prep_fdsync(&aio->cb, static_cast<int>((ssize_t)aio->file));
                 break;
             default:
                 derror("unknown aio type %u", static_cast<int>(aio->type));
@@ -152,41 +273,26 @@ namespace dsn {
                 aio->bytes = 0;
             }
 
-            cbs[0] = &aio->cb;
-            ret = io_submit(_ctx, 1, cbs);
-
-            if (ret != 1)
+            if (aio->type == AIO_Sync && _fdsync_unsupported)
             {
-                if (ret < 0)
-                    derror("io_submit error, ret = %d", ret);
-                else
-                    derror("could not sumbit IOs, ret = %d", ret);
+                complete_aio(&aio->cb, 0, (::fdatasync(aio->cb.aio_fildes) == 0) ? 0 : errno);
+            }
+            else
+            {
+                submit(_contexts[static_cast<int>((ssize_t)aio->file) % _contexts.size()], &aio->cb);
+            }
 
-                if (async)
-                {
-                    complete_io(aio_tsk, ERR_FILE_OPERATION_FAILED, 0);
-                }
-                else
-                {
-                    delete aio->evt;
-                    aio->evt = nullptr;
-                }
-                return ERR_FILE_OPERATION_FAILED;
+            if (async)
+            {
+                return ERR_IO_PENDING;
             }
-            else 
+            else
             {
-                if (async)
-                {
-                    return ERR_IO_PENDING;
-                }
-                else
-                {
-                    aio->evt->wait();
-                    delete aio->evt;
-                    aio->evt = nullptr;
-                    *pbytes = aio->bytes;
-                    return aio->err;
-                }
+                aio->evt->wait();
+                delete aio->evt;
+                aio->evt = nullptr;
+                *pbytes = aio->bytes;
+                return aio->err;
             }
         }
     }
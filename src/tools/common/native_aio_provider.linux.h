@@ -31,16 +31,30 @@
 # include <dsn/tool_api.h>
 # include <dsn/internal/synchronize.h>
 # include <queue>
+# include <atomic>
+# include <vector>
+# include <dsn/internal/perf_counters.h>
 # include <stdio.h>        /* for perror() */
 # include <sys/syscall.h>    /* for __NR_* definitions */
 # include <libaio.h>
 # include <fcntl.h>        /* O_RDWR */
 # include <string.h>        /* memset() */
 # include <inttypes.h>    /* uint64_t */
+# include <limits.h>        /* IOV_MAX */
+# include <sys/uio.h>        /* struct iovec */
 
 namespace dsn {
     namespace tools {
 
+        //
+        // aio provider on linux libaio. Submissions are queued per io context
+        // and flushed with multi-iocb io_submit calls by whichever thread finds
+        // the queue idle, and completions are reaped in batches. Files are
+        // sharded over multiple io contexts by their descriptor (see [aio.native]).
+        // Vectored io is issued as preadv/pwritev iocbs.
+        // AIO_Sync is issued as IO_CMD_FDSYNC, and falls back to an inline
+        // fdatasync on kernels or file systems that reject it.
+        //
         class native_linux_aio_provider : public aio_provider
         {
         public:
@@ -55,6 +69,7 @@ namespace dsn {
             struct linux_disk_aio_context : public disk_aio
             {
                 struct iocb cb;
+                std::vector<struct iovec> iovs; // for vectored io
                 aio_task* tsk;
                 native_linux_aio_provider* this_;
                 utils::notify_event* evt;
@@ -63,12 +78,27 @@ namespace dsn {
             };
 
         protected:
+            struct io_context
+            {
+                io_context_t                  ctx;
+                ::dsn::utils::ex_lock_nr      lock;
+                std::vector<struct iocb*>     pending; // queued but not submitted yet
+                bool                          is_submitting;
+            };
+
             error_code aio_internal(aio_task_ptr& aio, bool async, __out_param uint32_t* pbytes = nullptr);
             void complete_aio(struct iocb* io, int bytes, int err);
-            void get_event();
+            void get_event(io_context* ctx);
+            void submit(io_context* ctx, struct iocb* cb);
+            void submit_batch(io_context* ctx, std::vector<struct iocb*>& cbs);
 
         private:
-            io_context_t _ctx;
+            std::vector<io_context*> _contexts;
+            int                      _queue_depth;
+            int                      _submit_batch_size;
+            int                      _reap_batch_size;
+            perf_counter_ptr         _iocbs_per_submit;
+            std::atomic<bool>        _fdsync_unsupported; // IO_CMD_FDSYNC rejected by the kernel
         };
     }
 }
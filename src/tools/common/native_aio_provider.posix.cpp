@@ -118,6 +118,13 @@ namespace dsn {
             int r;
 
             aio->this_ = this;
+
+            // no scatter/gather in posix aio
+            if (!aio->buffers.empty() && aio->type != AIO_Sync)
+            {
+                gather_buffers(aio);
+            }
+
             aio->cb.aio_fildes = static_cast<int>((ssize_t)aio->file);
             aio->cb.aio_buf = aio->buffer;
             aio->cb.aio_nbytes = aio->buffer_size;
@@ -144,6 +151,13 @@ namespace dsn {
             case AIO_Write:
                 r = aio_write(&aio->cb);
                 break;
+            case AIO_Sync:
+# ifdef O_DSYNC
+                r = aio_fsync(O_DSYNC, &aio->cb);
+# else
+                r = aio_fsync(O_SYNC, &aio->cb);
+# endif
+                break;
             default:
                 dassert (false, "unknown aio type %u", static_cast<int>(aio->type));
                 break;
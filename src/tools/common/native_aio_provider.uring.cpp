@@ -0,0 +1,565 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+# ifdef __linux__
+
+# include "native_aio_provider.uring.h"
+
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+# include <errno.h>
+
+# ifdef __TITLE__
+# undef __TITLE__
+# endif
+# define __TITLE__ "aio.provider.uring"
+
+namespace dsn {
+    namespace tools {
+
+        static int io_uring_setup(unsigned entries, struct io_uring_params* p)
+        {
+            return (int)::syscall(__NR_io_uring_setup, entries, p);
+        }
+
+        static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+        {
+            return (int)::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+        }
+
+        static int io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args)
+        {
+            return (int)::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+        }
+
+        native_uring_aio_provider::native_uring_aio_provider(disk_engine* disk, aio_provider* inner_provider)
+            : aio_provider(disk, inner_provider)
+        {
+            _ring_fd = -1;
+            _sq_ring = _cq_ring = nullptr;
+            _sqes = nullptr;
+            _inflight = 0;
+            _sq_unsubmitted = 0;
+            _is_submitting = false;
+
+            int queue_depth = config()->get_value<int>("aio.uring", "queue_depth", 128);
+            bool sq_poll = config()->get_value<bool>("aio.uring", "sq_poll", false);
+            int sq_thread_idle = config()->get_value<int>("aio.uring", "sq_thread_idle_milliseconds", 1000);
+            int max_fixed_files = config()->get_value<int>("aio.uring", "max_fixed_files", 1024);
+
+            if (setup(queue_depth > 0 ? queue_depth : 1, sq_poll, sq_thread_idle, max_fixed_files))
+            {
+                new std::thread(std::bind(&native_uring_aio_provider::get_event, this));
+            }
+            else
+            {
+                dwarn("io_uring is not available, fall back to the libaio provider");
+                _fallback.reset(new native_linux_aio_provider(disk, inner_provider));
+            }
+        }
+
+        native_uring_aio_provider::~native_uring_aio_provider()
+        {
+            if (_ring_fd >= 0)
+            {
+                ::close(_ring_fd);
+            }
+            if (_sqes != nullptr)
+            {
+                munmap(_sqes, _sqes_size);
+            }
+            if (_cq_ring != nullptr && _cq_ring != _sq_ring)
+            {
+                munmap(_cq_ring, _cq_ring_size);
+            }
+            if (_sq_ring != nullptr)
+            {
+                munmap(_sq_ring, _sq_ring_size);
+            }
+        }
+
+        bool native_uring_aio_provider::setup(int queue_depth, bool sq_poll, int sq_thread_idle_milliseconds, int max_fixed_files)
+        {
+            struct io_uring_params p;
+            memset(&p, 0, sizeof(p));
+            if (sq_poll)
+            {
+                p.flags |= IORING_SETUP_SQPOLL;
+                p.sq_thread_idle = sq_thread_idle_milliseconds;
+            }
+
+            _ring_fd = io_uring_setup(queue_depth, &p);
+            if (_ring_fd < 0 && sq_poll)
+            {
+                // SQPOLL needs privileges on older kernels
+                dwarn("io_uring_setup with SQPOLL failed, errno = %d, retry without it", errno);
+                p.flags &= ~IORING_SETUP_SQPOLL;
+                sq_poll = false;
+                _ring_fd = io_uring_setup(queue_depth, &p);
+            }
+            if (_ring_fd < 0)
+            {
+                dwarn("io_uring_setup failed, errno = %d", errno);
+                return false;
+            }
+            _sq_poll = sq_poll;
+
+            _sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+            _cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+            bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (single_mmap)
+            {
+                _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+            }
+
+            _sq_ring = mmap(nullptr, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQ_RING);
+            if (_sq_ring == MAP_FAILED)
+            {
+                _sq_ring = nullptr;
+                return false;
+            }
+
+            if (single_mmap)
+            {
+                _cq_ring = _sq_ring;
+            }
+            else
+            {
+                _cq_ring = mmap(nullptr, _cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_CQ_RING);
+                if (_cq_ring == MAP_FAILED)
+                {
+                    _cq_ring = nullptr;
+                    return false;
+                }
+            }
+
+            _sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+            _sqes = (struct io_uring_sqe*)mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQES);
+            if (_sqes == MAP_FAILED)
+            {
+                _sqes = nullptr;
+                return false;
+            }
+
+            char* sq = (char*)_sq_ring;
+            _sq_head = (unsigned*)(sq + p.sq_off.head);
+            _sq_tail = (unsigned*)(sq + p.sq_off.tail);
+            _sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+            _sq_flags = (unsigned*)(sq + p.sq_off.flags);
+            _sq_array = (unsigned*)(sq + p.sq_off.array);
+            _sq_entries = p.sq_entries;
+
+            char* cq = (char*)_cq_ring;
+            _cq_head = (unsigned*)(cq + p.cq_off.head);
+            _cq_tail = (unsigned*)(cq + p.cq_off.tail);
+            _cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+            _cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+            // never have more requests in flight than the completion queue can hold
+            _inflight_limit = std::min(p.sq_entries, p.cq_entries);
+
+            // a sparse fixed file table, filled on open
+            if (max_fixed_files > 0)
+            {
+                _fixed_files.resize(max_fixed_files, -1);
+                if (io_uring_register(_ring_fd, IORING_REGISTER_FILES, &_fixed_files[0], max_fixed_files) != 0)
+                {
+                    dwarn("io_uring fixed files are not supported, errno = %d", errno);
+                    _fixed_files.clear();
+                }
+            }
+
+            return true;
+        }
+
+        handle_t native_uring_aio_provider::open(const char* file_name, int flag, int pmode)
+        {
+            if (_fallback)
+                return _fallback->open(file_name, flag, pmode);
+
+            int fd = ::open(file_name, flag, pmode);
+            if (fd < 0 || _fixed_files.empty())
+                return (handle_t)fd;
+
+            utils::auto_lock<::dsn::utils::ex_lock_nr> l(_lock);
+            for (int slot = 0; slot < (int)_fixed_files.size(); slot++)
+            {
+                if (_fixed_files[slot] != -1)
+                    continue;
+
+                struct io_uring_files_update up;
+                memset(&up, 0, sizeof(up));
+                up.offset = slot;
+                up.fds = (__u64)(uintptr_t)&fd;
+                if (io_uring_register(_ring_fd, IORING_REGISTER_FILES_UPDATE, &up, 1) == 1)
+                {
+                    _fixed_files[slot] = fd;
+                    _fixed_file_slots[fd] = slot;
+                }
+                break;
+            }
+
+            // the raw descriptor is still used when the table is full
+            return (handle_t)fd;
+        }
+
+        error_code native_uring_aio_provider::close(handle_t hFile)
+        {
+            if (_fallback)
+                return _fallback->close(hFile);
+
+            int fd = static_cast<int>((ssize_t)hFile);
+            {
+                utils::auto_lock<::dsn::utils::ex_lock_nr> l(_lock);
+                auto it = _fixed_file_slots.find(fd);
+                if (it != _fixed_file_slots.end())
+                {
+                    int none = -1;
+                    struct io_uring_files_update up;
+                    memset(&up, 0, sizeof(up));
+                    up.offset = it->second;
+                    up.fds = (__u64)(uintptr_t)&none;
+                    io_uring_register(_ring_fd, IORING_REGISTER_FILES_UPDATE, &up, 1);
+
+                    _fixed_files[it->second] = -1;
+                    _fixed_file_slots.erase(it);
+                }
+            }
+
+            if (::close(fd) != 0)
+            {
+                derror("close file failed, err = %d", errno);
+                return ERR_FILE_OPERATION_FAILED;
+            }
+            return ERR_OK;
+        }
+
+        disk_aio_ptr native_uring_aio_provider::prepare_aio_context(aio_task* tsk)
+        {
+            if (_fallback)
+                return _fallback->prepare_aio_context(tsk);
+
+            auto r = new uring_disk_aio_context;
+            r->tsk = tsk;
+            r->evt = nullptr;
+            return disk_aio_ptr(r);
+        }
+
+        void native_uring_aio_provider::aio(aio_task_ptr& aio_tsk)
+        {
+            if (_fallback)
+                _fallback->aio(aio_tsk);
+            else
+                aio_internal(aio_tsk, true);
+        }
+
+        error_code native_uring_aio_provider::aio_internal(aio_task_ptr& aio_tsk, bool async, __out_param uint32_t* pbytes /*= nullptr*/)
+        {
+            auto aio = (uring_disk_aio_context *)aio_tsk->aio().get();
+            aio->iovs.clear();
+            if (!aio->buffers.empty() && aio->type != AIO_Sync)
+            {
+                if (aio->buffers.size() <= IOV_MAX)
+                {
+                    aio->iovs.resize(aio->buffers.size());
+                    for (size_t i = 0; i < aio->buffers.size(); i++)
+                    {
+                        aio->iovs[i].iov_base = aio->buffers[i].buffer;
+                        aio->iovs[i].iov_len = aio->buffers[i].size;
+                    }
+                }
+                else
+                {
+                    gather_buffers(aio);
+                }
+            }
+
+            aio->iov.iov_base = aio->buffer;
+            aio->iov.iov_len = aio->buffer_size;
+
+            if (!async)
+            {
+                aio->evt = new utils::notify_event();
+                aio->err = ERR_OK;
+                aio->bytes = 0;
+            }
+
+            if (aio->type == AIO_Read || aio->type == AIO_Write || aio->type == AIO_Sync)
+            {
+                submit(aio);
+            }
+            else
+            {
+                derror("unknown aio type %u", static_cast<int>(aio->type));
+                complete_aio(aio, -EINVAL);
+            }
+
+            if (async)
+            {
+                return ERR_IO_PENDING;
+            }
+            else
+            {
+                aio->evt->wait();
+                delete aio->evt;
+                aio->evt = nullptr;
+                *pbytes = aio->bytes;
+                return aio->err;
+            }
+        }
+
+        // the completion of a write linked to a fsync is tagged in the low bit of
+        // user_data, the aio is completed by the fsync that follows it
+        static const __u64 LINKED_WRITE_TAG = 1;
+
+        void native_uring_aio_provider::submit(uring_disk_aio_context* aio)
+        {
+            bool linked = (aio->type == AIO_Write && aio->sync_after_write);
+            unsigned count = linked ? 2 : 1;
+
+            // wait for room in both rings
+            while (_inflight.fetch_add(count, std::memory_order_acquire) + count > _inflight_limit)
+            {
+                _inflight.fetch_sub(count, std::memory_order_release);
+                std::this_thread::yield();
+            }
+
+            int fd = static_cast<int>((ssize_t)aio->file);
+
+            _lock.lock();
+            unsigned tail = *_sq_tail;
+            while (tail + count - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) > _sq_entries)
+            {
+                // the kernel has not consumed the previous submissions yet
+                _lock.unlock();
+                std::this_thread::yield();
+                _lock.lock();
+                tail = *_sq_tail;
+            }
+
+            unsigned index = tail & *_sq_mask;
+            struct io_uring_sqe* sqe = &_sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+
+            switch (aio->type)
+            {
+            case AIO_Read:
+                sqe->opcode = IORING_OP_READV;
+                break;
+            case AIO_Write:
+                sqe->opcode = IORING_OP_WRITEV;
+                break;
+            case AIO_Sync:
+                sqe->opcode = IORING_OP_FSYNC;
+                sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+                break;
+            default:
+                dassert(false, "unknown aio type %u", static_cast<int>(aio->type));
+                break;
+            }
+
+            auto it = _fixed_file_slots.find(fd);
+            if (it != _fixed_file_slots.end())
+            {
+                sqe->fd = it->second;
+                sqe->flags |= IOSQE_FIXED_FILE;
+            }
+            else
+            {
+                sqe->fd = fd;
+            }
+
+            // fsync must carry no buffer
+            if (aio->type != AIO_Sync)
+            {
+                if (aio->iovs.empty())
+                {
+                    sqe->addr = (__u64)(uintptr_t)&aio->iov;
+                    sqe->len = 1;
+                }
+                else
+                {
+                    sqe->addr = (__u64)(uintptr_t)&aio->iovs[0];
+                    sqe->len = static_cast<__u32>(aio->iovs.size());
+                }
+                sqe->off = aio->file_offset;
+            }
+            sqe->user_data = (__u64)(uintptr_t)aio;
+            _sq_array[index] = index;
+
+            // the fsync starts only after the write completes in full, a failed or
+            // short write cancels it
+            if (linked)
+            {
+                sqe->flags |= IOSQE_IO_LINK;
+                sqe->user_data |= LINKED_WRITE_TAG;
+                aio->write_res = 0;
+
+                unsigned sync_index = (tail + 1) & *_sq_mask;
+                struct io_uring_sqe* sync_sqe = &_sqes[sync_index];
+                memset(sync_sqe, 0, sizeof(*sync_sqe));
+                sync_sqe->opcode = IORING_OP_FSYNC;
+                sync_sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+                sync_sqe->fd = sqe->fd;
+                sync_sqe->flags = sqe->flags & IOSQE_FIXED_FILE;
+                sync_sqe->user_data = (__u64)(uintptr_t)aio;
+                _sq_array[sync_index] = sync_index;
+            }
+
+            __atomic_store_n(_sq_tail, tail + count, __ATOMIC_RELEASE);
+
+            if (_sq_poll)
+            {
+                bool need_wakeup = (__atomic_load_n(_sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP) != 0;
+                _lock.unlock();
+
+                if (need_wakeup)
+                {
+                    io_uring_enter(_ring_fd, 0, 0, IORING_ENTER_SQ_WAKEUP);
+                }
+                return;
+            }
+
+            _sq_unsubmitted += count;
+
+            // the current submitter will pick it up
+            if (_is_submitting)
+            {
+                _lock.unlock();
+                return;
+            }
+
+            _is_submitting = true;
+            _lock.unlock();
+
+            enter_submissions();
+        }
+
+        void native_uring_aio_provider::enter_submissions()
+        {
+            while (true)
+            {
+                unsigned count;
+                {
+                    utils::auto_lock<::dsn::utils::ex_lock_nr> l(_lock);
+                    if (_sq_unsubmitted == 0)
+                    {
+                        _is_submitting = false;
+                        return;
+                    }
+                    count = _sq_unsubmitted;
+                }
+
+                int ret = io_uring_enter(_ring_fd, count, 0, 0);
+                if (ret < 0)
+                {
+                    dassert(errno == EAGAIN || errno == EBUSY || errno == EINTR,
+                        "io_uring_enter failed, errno = %d", errno);
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                utils::auto_lock<::dsn::utils::ex_lock_nr> l(_lock);
+                _sq_unsubmitted -= ret;
+            }
+        }
+
+        void native_uring_aio_provider::get_event()
+        {
+            while (true)
+            {
+                unsigned head = *_cq_head;
+                unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+                if (head == tail)
+                {
+                    io_uring_enter(_ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+                    continue;
+                }
+
+                for (; head != tail; head++)
+                {
+                    struct io_uring_cqe* cqe = &_cqes[head & *_cq_mask];
+                    auto aio = (uring_disk_aio_context*)(uintptr_t)(cqe->user_data & ~LINKED_WRITE_TAG);
+                    bool linked_write = (cqe->user_data & LINKED_WRITE_TAG) != 0;
+                    int res = cqe->res;
+
+                    // release the slot before the callback may submit again
+                    __atomic_store_n(_cq_head, head + 1, __ATOMIC_RELEASE);
+                    _inflight.fetch_sub(1, std::memory_order_release);
+
+                    // a linked request is started only when the one before it has
+                    // completed, so the write is always seen before its fsync
+                    if (linked_write)
+                    {
+                        aio->write_res = res;
+                        continue;
+                    }
+
+                    if (aio->type == AIO_Write && aio->sync_after_write)
+                    {
+                        // the fsync is cancelled (-ECANCELED) when the write fails
+                        if (aio->write_res < 0)
+                            res = aio->write_res;
+                        else if (res >= 0)
+                            res = aio->write_res;
+                    }
+
+                    complete_aio(aio, res);
+                }
+            }
+        }
+
+        void native_uring_aio_provider::complete_aio(uring_disk_aio_context* aio, int res)
+        {
+            error_code err = ERR_OK;
+            uint32_t bytes = 0;
+            if (res < 0)
+            {
+                derror("aio error, err = %d", -res);
+                err = ERR_FILE_OPERATION_FAILED;
+            }
+            else
+            {
+                bytes = static_cast<uint32_t>(res);
+            }
+
+            if (!aio->evt)
+            {
+                aio_task_ptr aio_ptr(aio->tsk);
+                complete_io(aio_ptr, err, bytes);
+            }
+            else
+            {
+                aio->err = err;
+                aio->bytes = bytes;
+                aio->evt->notify();
+            }
+        }
+    }
+} // end namespace dsn::tools
+
+# endif
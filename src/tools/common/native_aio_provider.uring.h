@@ -0,0 +1,114 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+# pragma once
+
+# ifdef __linux__
+
+# include "native_aio_provider.linux.h"
+# include <linux/io_uring.h>
+# include <sys/uio.h>
+# include <unordered_map>
+# include <memory>
+
+namespace dsn {
+    namespace tools {
+
+        //
+        // aio provider on linux io_uring, talking to the kernel through the raw
+        // syscalls and the mmap-ed rings. Files are registered as fixed files
+        // when the kernel allows, and the submission queue may be polled by a
+        // kernel thread (SQPOLL) so that submitting costs no syscall at all.
+        // Vectored io maps to READV/WRITEV with the iovecs of the buffers.
+        // AIO_Sync is issued as IORING_OP_FSYNC with IORING_FSYNC_DATASYNC, and
+        // a write with sync_after_write is linked to such a fsync (IOSQE_IO_LINK)
+        // so that both go in one submission and complete the aio once.
+        // When io_uring is not available, all calls go to the libaio provider.
+        //
+        class native_uring_aio_provider : public aio_provider
+        {
+        public:
+            native_uring_aio_provider(disk_engine* disk, aio_provider* inner_provider);
+            ~native_uring_aio_provider();
+
+            virtual handle_t open(const char* file_name, int flag, int pmode);
+            virtual error_code close(handle_t hFile);
+            virtual void    aio(aio_task_ptr& aio);
+            virtual disk_aio_ptr prepare_aio_context(aio_task* tsk);
+            virtual bool    links_sync_to_write() const { return !_fallback && _inflight_limit >= 2; }
+
+            struct uring_disk_aio_context : public disk_aio
+            {
+                struct iovec         iov;
+                std::vector<struct iovec> iovs; // for vectored io
+                aio_task*            tsk;
+                utils::notify_event* evt;
+                error_code           err;
+                uint32_t             bytes;
+                int                  write_res; // of the write linked to a fsync
+            };
+
+        protected:
+            bool setup(int queue_depth, bool sq_poll, int sq_thread_idle_milliseconds, int max_fixed_files);
+            error_code aio_internal(aio_task_ptr& aio, bool async, __out_param uint32_t* pbytes = nullptr);
+            void submit(uring_disk_aio_context* aio);
+            void enter_submissions();
+            void complete_aio(uring_disk_aio_context* aio, int res);
+            void get_event();
+
+        private:
+            std::unique_ptr<native_linux_aio_provider> _fallback; // when io_uring is unavailable
+
+            int                      _ring_fd;
+            bool                     _sq_poll;
+            unsigned                 _inflight_limit;
+            std::atomic<unsigned>    _inflight;
+
+            // submission queue ring
+            void*                    _sq_ring;
+            size_t                   _sq_ring_size;
+            unsigned                 *_sq_head, *_sq_tail, *_sq_mask, *_sq_flags, *_sq_array;
+            unsigned                 _sq_entries;
+            struct io_uring_sqe      *_sqes;
+            size_t                   _sqes_size;
+
+            // completion queue ring
+            void*                    _cq_ring;
+            size_t                   _cq_ring_size;
+            unsigned                 *_cq_head, *_cq_tail, *_cq_mask;
+            struct io_uring_cqe      *_cqes;
+
+            // guards the sq ring and the fixed file table
+            ::dsn::utils::ex_lock_nr _lock;
+            unsigned                 _sq_unsubmitted;
+            bool                     _is_submitting;
+
+            std::vector<int>             _fixed_files; // slot => fd, -1 when free
+            std::unordered_map<int, int> _fixed_file_slots; // fd => slot
+        };
+    }
+}
+
+# endif
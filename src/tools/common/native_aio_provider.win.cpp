@@ -215,6 +215,12 @@ error_code native_win_aio_provider::aio_internal(aio_task_ptr& aio_tsk, bool asy
     auto aio = (windows_disk_aio_context*)aio_tsk->aio().get();
     BOOL r = FALSE;
 
+    // ReadFileScatter/WriteFileGather require page-sized buffers, so gather them here
+    if (!aio->buffers.empty() && aio->type != AIO_Sync)
+    {
+        gather_buffers(aio);
+    }
+
     aio->olp.Offset = (uint32_t)aio->file_offset;
     aio->olp.OffsetHigh = (uint32_t)(aio->file_offset >> 32);
 
@@ -233,6 +239,26 @@ error_code native_win_aio_provider::aio_internal(aio_task_ptr& aio_tsk, bool asy
     case AIO_Write:
         r = ::WriteFile(aio->file, aio->buffer, aio->buffer_size, NULL, &aio->olp);
         break;
+    case AIO_Sync:
+        // there is no overlapped flush on windows, so it is done inline and
+        // completed without going through the completion port
+        r = ::FlushFileBuffers(aio->file);
+        if (r)
+        {
+            if (async)
+            {
+                complete_io(aio_tsk, ERR_OK, 0);
+                return ERR_IO_PENDING;
+            }
+            else
+            {
+                delete aio->evt;
+                aio->evt = nullptr;
+                *pbytes = 0;
+                return ERR_OK;
+            }
+        }
+        break;
     default:
         dassert (false, "unknown aio type %u", static_cast<int>(aio->type));
         break;
@@ -42,7 +42,7 @@ namespace dsn {
             : 
             _net(net),
             rpc_client_session(net, remote_addr, matcher),
-            client_net_io(remote_addr, socket, parser)
+            client_net_io(remote_addr, socket, parser, net.send_options())
         {   
         }
         
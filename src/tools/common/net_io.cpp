@@ -38,14 +38,16 @@ namespace dsn {
         net_io::net_io(
             const end_point& remote_addr,
             boost::asio::ip::tcp::socket& socket,
-            std::shared_ptr<dsn::message_parser>& parser
+            std::shared_ptr<dsn::message_parser>& parser,
+            const net_io_send_options& send_options
             )
             :
             _io_service(shared_io_service::instance().ios),
             _socket(std::move(socket)),
             _sq("net_io.send.queue"),
             _remote_addr(remote_addr),
-            _parser(parser)
+            _parser(parser),
+            _send_options(send_options)
         {
             set_options();
         }
@@ -130,8 +132,16 @@ namespace dsn {
                         this->on_message_read(msg);
                         msg = _parser->get_message_on_receive(0, read_next);
                     }
-                     
-                    do_read(read_next);
+
+                    if (read_next < 0)
+                    {
+                        derror("malformed message stream, close the session");
+                        on_failure();
+                    }
+                    else
+                    {
+                        do_read(read_next);
+                    }
                 }
 
                 release_reference();
@@ -140,22 +150,38 @@ namespace dsn {
 
         void net_io::do_write()
         {
-            auto msg = _sq.peek();
-            if (nullptr == msg.get())
+            // drain up to max_message_count/max_bytes messages in priority order,
+            // so that they are sent with one scatter-gather write
+            std::vector<message_ptr> msgs;
+            int count = _sq.peek_batch(msgs, _send_options.max_message_count, 
+                static_cast<size_t>(_send_options.max_bytes),
+                [](const message_ptr& msg) { return static_cast<size_t>(msg->total_size()); }
+                );
+            if (0 == count)
                 return;
 
-            std::vector<blob> buffers;
-            _parser->prepare_buffers_for_send(msg, buffers);
-
+            std::vector<blob> buffers, all_buffers;
             std::vector<boost::asio::const_buffer> buffers2;
-            for (auto& b : buffers)
+            for (auto& msg : msgs)
+            {
+                _parser->prepare_buffers_for_send(msg, buffers);
+                all_buffers.insert(all_buffers.end(), buffers.begin(), buffers.end());
+            }
+
+            for (auto& b : all_buffers)
             {
                 buffers2.push_back(boost::asio::const_buffer(b.data(), b.length()));
             }
 
+            if (_send_options.messages_per_write != nullptr)
+                _send_options.messages_per_write->set(count);
+
             add_reference();
+
+            // buffers are captured to keep them alive until the write completes, as
+            // the parser may add buffers not owned by the messages (e.g., headers)
             boost::asio::async_write(_socket, buffers2,
-                [this, msg](boost::system::error_code ec, std::size_t length)
+                [this, count, all_buffers](boost::system::error_code ec, std::size_t length)
             {
                 if (!!ec)
                 {
@@ -163,8 +189,8 @@ namespace dsn {
                 }
                 else
                 {
-                    auto smsg = _sq.dequeue_peeked();
-                    dassert(smsg == msg, "sent msg must be the first msg in send queue");
+                    auto c = _sq.dequeue_peeked_batch();
+                    dassert(c == count, "sent msgs must be the peeked msgs in send queue");
                     //dinfo("network message sent, rpc_id = %016llx", msg->header().rpc_id);
 
                     do_write();
@@ -184,9 +210,10 @@ namespace dsn {
         
         client_net_io::client_net_io(const end_point& remote_addr,
             boost::asio::ip::tcp::socket& socket,
-            std::shared_ptr<dsn::message_parser>& parser)
+            std::shared_ptr<dsn::message_parser>& parser,
+            const net_io_send_options& send_options)
             :
-            net_io(remote_addr, socket, parser), 
+            net_io(remote_addr, socket, parser, send_options), 
             _state(SS_CLOSED),
             _reconnect_count(0)
         {
@@ -28,17 +28,35 @@
 # include <dsn/internal/rpc_message.h>
 # include <dsn/internal/priority_queue.h>
 # include <dsn/internal/message_parser.h>
+# include <dsn/internal/perf_counter.h>
 # include <boost/asio.hpp>
 
 namespace dsn {
     namespace tools {
 
+        //
+        // send batching options, see asio_network_provider for the config keys
+        //   max_message_count - at most this many queued messages are sent in one async_write,
+        //                       1 means no batching
+        //   max_bytes - a batch stops growing before its total size exceeds this value
+        //               (the first message is always sent)
+        //
+        struct net_io_send_options
+        {
+            int              max_message_count;
+            int              max_bytes;
+            perf_counter_ptr messages_per_write; // can be null
+
+            net_io_send_options() : max_message_count(1), max_bytes(64 * 1024) {}
+        };
+
         class net_io
         {
         public:
             net_io(const end_point& remote_addr,
                 boost::asio::ip::tcp::socket& socket,
-                std::shared_ptr<dsn::message_parser>& parser);
+                std::shared_ptr<dsn::message_parser>& parser,
+                const net_io_send_options& send_options);
             virtual ~net_io();
 
             virtual void write(message_ptr& msg);
@@ -62,6 +80,7 @@ namespace dsn {
             boost::asio::ip::tcp::socket _socket;
             end_point                    _remote_addr;
             std::shared_ptr<dsn::message_parser> _parser;
+            net_io_send_options          _send_options;
             
             // TODO: expose the queue to be customizable
             typedef utils::priority_queue<message_ptr, TASK_PRIORITY_COUNT> send_queue;
@@ -73,7 +92,8 @@ namespace dsn {
         public:
             client_net_io(const end_point& remote_addr,
                 boost::asio::ip::tcp::socket& socket,
-                std::shared_ptr<dsn::message_parser>& parser);
+                std::shared_ptr<dsn::message_parser>& parser,
+                const net_io_send_options& send_options);
 
             void connect();
             virtual void write(message_ptr& msg);
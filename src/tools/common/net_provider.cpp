@@ -27,6 +27,7 @@
 #include "net_provider.h"
 #include "net_client_session.h"
 #include "net_server_session.h"
+#include <dsn/internal/perf_counters.h>
 
 namespace dsn {
     namespace tools{
@@ -47,6 +48,26 @@ namespace dsn {
 
             _address = end_point(boost::asio::ip::host_name().c_str(), port);
 
+            //
+            // send batching, configured in [network] and optionally overriden per port, e.g.,
+            //   [network.34801]
+            //   send_batch_max_message_count = 64
+            //   send_batch_max_bytes = 65536
+            //
+            char section[32];
+            sprintf(section, "network.%d", port);
+            _send_options.max_message_count = config()->get_value<int>(section, "send_batch_max_message_count",
+                config()->get_value<int>("network", "send_batch_max_message_count", 32));
+            _send_options.max_bytes = config()->get_value<int>(section, "send_batch_max_bytes",
+                config()->get_value<int>("network", "send_batch_max_bytes", 64 * 1024));
+            if (_send_options.max_message_count < 1)
+                _send_options.max_message_count = 1;
+
+            char counter_name[64];
+            sprintf(counter_name, "network.%d.send.messages_per_write", port);
+            _send_options.messages_per_write = dsn::utils::perf_counters::instance().get_counter(
+                counter_name, COUNTER_TYPE_NUMBER_PERCENTILES, true);
+
             if (!client_only)
             {
                 auto v4_addr = boost::asio::ip::address_v4::any(); //(ntohl(_address.ip));
@@ -27,6 +27,7 @@
 
 # include <dsn/tool_api.h>
 # include <boost/asio.hpp>
+# include "net_io.h"
 
 namespace dsn {
     namespace tools {
@@ -40,6 +41,8 @@ namespace dsn {
             virtual const end_point& address() { return _address;  }
             virtual rpc_client_session_ptr create_client_session(const end_point& server_addr);
 
+            const net_io_send_options& send_options() const { return _send_options; }
+
         private:
             void do_accept();
 
@@ -51,6 +54,7 @@ namespace dsn {
             std::shared_ptr<boost::asio::ip::tcp::socket>   _socket;
             boost::asio::io_service        &_io_service;
             end_point                      _address;
+            net_io_send_options            _send_options;
         };
 
     }
@@ -44,7 +44,7 @@ namespace dsn {
             )
             : _net(net),
             rpc_server_session(net, remote_addr),
-            net_io(remote_addr, socket, parser)
+            net_io(remote_addr, socket, parser, net.send_options())
         {
             start_read();
         }
@@ -30,6 +30,7 @@
 # include "native_aio_provider.win.h"
 # include "native_aio_provider.posix.h"
 # include "native_aio_provider.linux.h"
+# include "native_aio_provider.uring.h"
 # include "simple_perf_counter.h"
 # include "simple_task_queue.h"
 # include "network.sim.h"
@@ -37,6 +38,8 @@
 # include "nfs_node_impl.h"
 # include "empty_aio_provider.h"
 # include "hpc_task_queue.h"
+# include "work_stealing_task_queue.h"
+# include "lockfree_task_queue.h"
 # include "hpc_tail_logger.h"
 
 namespace dsn {
@@ -57,13 +60,17 @@ namespace dsn {
             register_component_provider<sim_network_provider>("dsn::tools::sim_network_provider");
             register_component_provider<simple_task_queue>("dsn::tools::simple_task_queue");
             register_component_provider<hpc_task_queue>("dsn::tools::hpc_task_queue");
+            register_component_provider<work_stealing_task_queue>("dsn::tools::work_stealing_task_queue");
+            register_component_provider<lockfree_task_queue>("dsn::tools::lockfree_task_queue");
             
             register_message_header_parser<dsn_message_parser>(NET_HDR_DSN);
+            register_message_header_parser<compact_message_parser>(NET_HDR_COMPACT);
 #if defined(_WIN32)
             register_component_provider<native_win_aio_provider>("dsn::tools::native_aio_provider");
 #elif defined(__linux__)
             register_component_provider<native_linux_aio_provider>("dsn::tools::native_aio_provider");
             register_component_provider<native_posix_aio_provider>("dsn::tools::posix_aio_provider");
+            register_component_provider<native_uring_aio_provider>("dsn::tools::uring_aio_provider");
 #else
             register_component_provider<native_posix_aio_provider>("dsn::tools::native_aio_provider");
 #endif
@@ -0,0 +1,237 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+# include "work_stealing_task_queue.h"
+# include <map>
+# include <algorithm>
+# include <mutex>
+
+# ifdef __TITLE__
+# undef __TITLE__
+# endif
+# define __TITLE__ "task.queue.work_stealing"
+
+namespace dsn {
+    namespace tools {
+
+        static std::mutex s_lock;
+        static std::map<task_worker_pool*, work_stealing_task_queue::steal_group*> s_groups;
+
+        work_stealing_task_queue::work_stealing_task_queue(task_worker_pool* pool, int index, task_queue* inner_provider)
+            : task_queue(pool, index, inner_provider)
+        {
+            _count = 0;
+            _stealable_count = 0;
+            _is_idle = false;
+            _idle_probe_milliseconds = config()->get_value<int>("task.queue.work_stealing", "idle_probe_milliseconds", 5);
+
+            std::string pool_name = get_name().substr(0, get_name().rfind('.'));
+            {
+                std::lock_guard<std::mutex> l(s_lock);
+                auto it = s_groups.find(pool);
+                if (it == s_groups.end())
+                {
+                    auto g = new steal_group();
+                    g->imbalance = utils::perf_counters::instance().get_counter(
+                        ("task.queue." + pool_name + ".imbalance").c_str(), COUNTER_TYPE_NUMBER_PERCENTILES, true);
+                    it = s_groups.insert(std::map<task_worker_pool*, steal_group*>::value_type(pool, g)).first;
+                }
+                _group = it->second;
+                _group->queues.push_back(this);
+            }
+
+            _steals = utils::perf_counters::instance().get_counter(
+                ("task.queue." + get_name() + ".steals").c_str(), COUNTER_TYPE_RATE, true);
+        }
+
+        work_stealing_task_queue::~work_stealing_task_queue()
+        {
+            std::lock_guard<std::mutex> l(s_lock);
+            auto& queues = _group->queues;
+            queues.erase(std::find(queues.begin(), queues.end(), this));
+            if (queues.empty())
+            {
+                s_groups.erase(pool());
+                delete _group;
+            }
+        }
+
+        void work_stealing_task_queue::enqueue(task* task)
+        {
+            if (task->delay_milliseconds() != 0)
+            {
+                enqueue_delayed(task);
+                return;
+            }
+
+            bool stealable = (task->hash() == 0 && task->spec().allow_work_stealing);
+            {
+                utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
+                task->_task_queue_dl.insert_before(stealable ? &_stealable_tasks : &_pinned_tasks);
+            }
+
+            int c = _count.fetch_add(1, std::memory_order_release);
+            _sema.signal();
+
+            if (stealable)
+            {
+                _stealable_count.fetch_add(1, std::memory_order_release);
+
+                // the owner is already busy with other tasks
+                if (c > 0)
+                {
+                    wake_idle_sibling();
+                }
+            }
+        }
+
+        task* work_stealing_task_queue::dequeue()
+        {
+            // each queued task holds one permit of its queue's semaphore, which is
+            // taken back by whoever dequeues the task (see dequeue_local and steal),
+            // so that idle workers only wake up for tasks or wake_idle_sibling
+            task* t = dequeue_local();
+            if (t == nullptr)
+            {
+                t = steal();
+            }
+            if (t != nullptr)
+            {
+                return t;
+            }
+
+            _is_idle.store(true, std::memory_order_release);
+            bool signaled = _sema.wait(_idle_probe_milliseconds);
+            _is_idle.store(false, std::memory_order_release);
+
+            t = dequeue_local(signaled);
+            if (t == nullptr)
+            {
+                t = steal();
+            }
+
+            // the worker loop simply calls dequeue again on nullptr
+            return t;
+        }
+
+        task* work_stealing_task_queue::pop(dlink& tasks)
+        {
+            dlink* t = tasks.next();
+            if (t == &tasks)
+                return nullptr;
+
+            t->remove();
+            return CONTAINING_RECORD(t, task, _task_queue_dl);
+        }
+
+        task* work_stealing_task_queue::dequeue_local(bool has_permit)
+        {
+            task* t;
+            bool stealable = false;
+            {
+                utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
+                t = pop(_pinned_tasks);
+                if (t == nullptr)
+                {
+                    t = pop(_stealable_tasks);
+                    stealable = true;
+                }
+            }
+
+            if (t != nullptr)
+            {
+                _count.fetch_sub(1, std::memory_order_release);
+                if (stealable)
+                {
+                    _stealable_count.fetch_sub(1, std::memory_order_release);
+                }
+                if (!has_permit)
+                {
+                    _sema.try_wait();
+                }
+            }
+            return t;
+        }
+
+        task* work_stealing_task_queue::steal()
+        {
+            auto& queues = _group->queues;
+            if (queues.size() <= 1)
+                return nullptr;
+
+            // pick the sibling with the most stealable tasks
+            work_stealing_task_queue* victim = nullptr;
+            int max_stealable = 0, max_count = 0, min_count = _count.load();
+            for (auto& q : queues)
+            {
+                int c = q->_count.load(std::memory_order_acquire);
+                if (c > max_count) max_count = c;
+                if (c < min_count) min_count = c;
+
+                if (q == this)
+                    continue;
+
+                int s = q->_stealable_count.load(std::memory_order_acquire);
+                if (s > max_stealable)
+                {
+                    max_stealable = s;
+                    victim = q;
+                }
+            }
+
+            if (victim == nullptr)
+                return nullptr;
+
+            task* t;
+            {
+                utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(victim->_lock);
+                t = pop(victim->_stealable_tasks);
+            }
+
+            if (t != nullptr)
+            {
+                victim->_count.fetch_sub(1, std::memory_order_release);
+                victim->_stealable_count.fetch_sub(1, std::memory_order_release);
+                victim->_sema.try_wait();
+                _steals->increment();
+                _group->imbalance->set(max_count - min_count);
+            }
+            return t;
+        }
+
+        void work_stealing_task_queue::wake_idle_sibling()
+        {
+            for (auto& q : _group->queues)
+            {
+                bool idle = true;
+                if (q != this && q->_is_idle.compare_exchange_strong(idle, false))
+                {
+                    q->_sema.signal();
+                    return;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,80 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ * 
+ * -=- Robust Distributed System Nucleus (rDSN) -=- 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+# include <dsn/tool_api.h>
+# include <dsn/internal/perf_counters.h>
+# include <atomic>
+
+namespace dsn {
+    namespace tools {
+
+        //
+        // task queue for partitioned thread pools where idle workers steal
+        // tasks from the busy ones. Tasks with a non-zero hash must be executed
+        // in order by their own worker, so only tasks with hash == 0 whose
+        // spec sets allow_work_stealing are stealable. All queues of the same pool find each other through a
+        // steal group, which is filled when task_worker_pool::start creates
+        // the queues and before any worker runs.
+        //
+        class work_stealing_task_queue : public task_queue
+        {
+        public:
+            work_stealing_task_queue(task_worker_pool* pool, int index, task_queue* inner_provider);
+            ~work_stealing_task_queue(); // no worker of the pool may be running
+
+            virtual void     enqueue(task* task);
+            virtual task*    dequeue();
+            virtual int      count() const { return _count.load(); }
+
+            struct steal_group
+            {
+                std::vector<work_stealing_task_queue*> queues;
+                perf_counter_ptr                       imbalance;
+            };
+
+        private:
+            task*  pop(dlink& tasks);
+            task*  dequeue_local(bool has_permit = false); // has_permit: the caller already took one from _sema
+            task*  steal();
+            void   wake_idle_sibling();
+
+        private:
+            std::atomic<int>              _count;
+            std::atomic<int>              _stealable_count;
+            std::atomic<bool>             _is_idle;
+
+            ::dsn::utils::ex_lock_nr_spin _lock;
+            dlink                         _pinned_tasks;    // owner only
+            dlink                         _stealable_tasks; // hash == 0 and allow_work_stealing
+            ::dsn::utils::semaphore       _sema;
+
+            steal_group*                  _group;
+            int                           _idle_probe_milliseconds;
+            perf_counter_ptr              _steals;
+        };
+    }
+}